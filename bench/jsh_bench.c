@@ -0,0 +1,367 @@
+/*
+ * End-to-end benchmarks of jsh, run by `make bench` :
+ *
+ *   startup        start and exit of `jsh` on an empty input
+ *   launch         `/bin/true` run by `jsh`, per command
+ *   pipeline       `head -c SIZE /dev/zero | cat | ... | cat >> /dev/null`,
+ *                  throughput for 1 to 8 `cat` stages
+ *   parse          `jsh_parse()` on long synthetic lines, throughput
+ *   check_jobs     `check_jobs()` with 10, 1000 and 10000 background jobs,
+ *   jobs           and `jobs` listing them
+ *
+ * usage : jsh_bench [-q] [jsh]
+ * output : a JSON object on the standard output, one result per benchmark.
+ * `-q` runs smaller sizes. `$BENCH_COMMIT` is copied in the output to
+ * compare results between commits.
+ */
+#include "../head/jsh.h"
+#include "../head/libjsh.h"
+
+#include <spawn.h>
+#include <time.h>
+
+static char *jsh_path = "./jsh";
+static int quick = 0;
+static int first_result = 1;
+
+static double now_us(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (double)ts.tv_sec * 1e6 + (double)ts.tv_nsec / 1e3;
+}
+
+static int compare_doubles(const void *a, const void *b) {
+  double x = *(const double *)a, y = *(const double *)b;
+  return x < y ? -1 : x > y;
+}
+
+/**
+ * Returns the `p`-th percentile of the `n` samples, sorted here
+ */
+static double percentile(double *samples, size_t n, double p) {
+  qsort(samples, n, sizeof(double), compare_doubles);
+  size_t i = (size_t)(p / 100 * (double)(n - 1) + 0.5);
+  return samples[i];
+}
+
+/**
+ * Starts a result object : `"name": name` followed by `fields`
+ */
+static void begin_result(const char *name, const char *fields) {
+  printf("%s\n    {\"name\": \"%s\"%s%s", first_result ? "" : ",", name,
+         *fields != '\0' ? ", " : "", fields);
+  first_result = 0;
+}
+
+/**
+ * Prints a result made of the distribution of `n` samples
+ */
+static void print_distribution(const char *name, const char *fields,
+                               const char *unit, double *samples, size_t n) {
+  double sum = 0;
+  for (size_t i = 0; i < n; i++)
+    sum += samples[i];
+  double p50 = percentile(samples, n, 50);
+  double p99 = percentile(samples, n, 99);
+  begin_result(name, fields);
+  printf(", \"unit\": \"%s\", \"runs\": %zu, \"mean\": %.3f, \"p50\": %.3f, "
+         "\"p99\": %.3f, \"min\": %.3f, \"max\": %.3f}",
+         unit, n, sum / (double)n, p50, p99, samples[0], samples[n - 1]);
+  fflush(stdout);
+}
+
+/**
+ * Runs `jsh` on the script `script` (`NULL` for an empty input), its
+ * outputs discarded
+ *
+ * @return the time taken in microseconds, `-1` on error or if the last
+ * command failed
+ */
+static double run_jsh(const char *script) {
+  posix_spawn_file_actions_t actions;
+  posix_spawn_file_actions_init(&actions);
+  posix_spawn_file_actions_addopen(&actions, STDIN_FILENO,
+                                   script != NULL ? script : "/dev/null",
+                                   O_RDONLY, 0);
+  posix_spawn_file_actions_addopen(&actions, STDOUT_FILENO, "/dev/null",
+                                   O_WRONLY, 0);
+  posix_spawn_file_actions_addopen(&actions, STDERR_FILENO, "/dev/null",
+                                   O_WRONLY, 0);
+  char *args[] = {jsh_path, NULL};
+  pid_t pid;
+  int status;
+  double start = now_us();
+  int error = posix_spawn(&pid, jsh_path, &actions, NULL, args, environ);
+  posix_spawn_file_actions_destroy(&actions);
+  if (error != 0) {
+    fprintf(stderr, "jsh_bench: %s: %s\n", jsh_path, strerror(error));
+    return -1;
+  }
+  if (waitpid(pid, &status, 0) == -1 || !WIFEXITED(status) ||
+      WEXITSTATUS(status) != 0) {
+    fprintf(stderr, "jsh_bench: %s failed on %s\n", jsh_path,
+            script != NULL ? script : "an empty input");
+    return -1;
+  }
+  return now_us() - start;
+}
+
+/**
+ * Writes a script of `n` times the line `line`
+ *
+ * @return the path of the script, to unlink and free
+ */
+static char *write_script(const char *line, int n) {
+  char *path = strdup("/tmp/jsh_bench.XXXXXX");
+  int fd = path != NULL ? mkstemp(path) : -1;
+  FILE *file = fd != -1 ? fdopen(fd, "w") : NULL;
+  if (file == NULL) {
+    perror("jsh_bench: script");
+    exit(EXIT_FAILURE);
+  }
+  for (int i = 0; i < n; i++)
+    fprintf(file, "%s\n", line);
+  fclose(file);
+  return path;
+}
+
+/**
+ * Startup and exit of the shell
+ *
+ * @return the median startup time, subtracted from the other runs of `jsh`
+ */
+static double bench_startup(void) {
+  size_t runs = quick ? 10 : 50;
+  double samples[50];
+  for (size_t i = 0; i < runs; i++)
+    if ((samples[i] = run_jsh(NULL)) < 0)
+      exit(EXIT_FAILURE);
+  print_distribution("startup", "", "us", samples, runs);
+  return percentile(samples, runs, 50);
+}
+
+/**
+ * Launch of a trivial external command
+ */
+static void bench_launch(double startup) {
+  int n = quick ? 100 : 500;
+  size_t runs = quick ? 3 : 10;
+  double samples[10];
+  char *script = write_script("/bin/true", n);
+  for (size_t i = 0; i < runs; i++) {
+    double time = run_jsh(script);
+    if (time < 0)
+      exit(EXIT_FAILURE);
+    samples[i] = (time - startup) / n;
+  }
+  unlink(script);
+  free(script);
+  char fields[64];
+  snprintf(fields, sizeof(fields), "\"commands\": %d", n);
+  print_distribution("launch", fields, "us", samples, runs);
+}
+
+/**
+ * Throughput of pipelines of `cat`
+ */
+static void bench_pipeline(double startup) {
+  long long size = quick ? 128LL << 20 : 1LL << 30;
+  size_t runs = quick ? 2 : 5;
+  for (int stages = 1; stages <= 8; stages *= 2) {
+    char line[256];
+    int length = snprintf(line, sizeof(line), "head -c %lld /dev/zero", size);
+    for (int i = 0; i < stages; i++)
+      length += snprintf(line + length, sizeof(line) - (size_t)length,
+                         " | cat");
+    snprintf(line + length, sizeof(line) - (size_t)length, " >> /dev/null");
+    char *script = write_script(line, 1);
+    double samples[5];
+    for (size_t i = 0; i < runs; i++) {
+      double time = run_jsh(script);
+      if (time < 0)
+        exit(EXIT_FAILURE);
+      // bytes per microsecond, in GB/s
+      samples[i] = (double)size / (time - startup) / 1e3;
+    }
+    unlink(script);
+    free(script);
+    char fields[64];
+    snprintf(fields, sizeof(fields), "\"stages\": %d, \"bytes\": %lld", stages,
+             size);
+    print_distribution("pipeline", fields, "GB/s", samples, runs);
+  }
+}
+
+/**
+ * Builds a line of about `size` bytes repeating `prefix`, the number of the
+ * repetition and `suffix`
+ */
+static char *synthetic_line(const char *prefix, const char *suffix,
+                            size_t size) {
+  char *line = malloc(size + 256);
+  if (line == NULL) {
+    perror("jsh_bench: parse");
+    exit(EXIT_FAILURE);
+  }
+  size_t length = 0;
+  for (int i = 0; length < size; i++)
+    length += (size_t)snprintf(line + length, 256, "%s%d%s", prefix, i, suffix);
+  return line;
+}
+
+/**
+ * Parse throughput on long lines : many words, a long pipeline, a long list
+ * with redirections and variables
+ */
+static void bench_parse(void) {
+  static const struct {
+    const char *name;
+    const char *first; // start of the line
+    const char *prefix; // repeated, around a number
+    const char *suffix;
+  } lines[] = {
+      {"words", "echo", " word", ""},
+      {"pipeline", "cat", " | grep -v x", ""},
+      {"list", "true", " && echo $HOME/", " > /dev/null 2>&1 ; ls -l"},
+  };
+  // parsing grows faster than the length of the line (arguments appended
+  // to a list) : the lines stay short enough for the run to be quick
+  size_t size = quick ? 1 << 16 : 1 << 18;
+  size_t runs = quick ? 5 : 10;
+  jsh_ctx *ctx = jsh_new();
+  if (ctx == NULL) {
+    perror("jsh_bench: parse");
+    exit(EXIT_FAILURE);
+  }
+  for (size_t k = 0; k < sizeof(lines) / sizeof(lines[0]); k++) {
+    char *body = synthetic_line(lines[k].prefix, lines[k].suffix, size);
+    char *line = malloc(strlen(lines[k].first) + strlen(body) + 1);
+    if (line == NULL) {
+      perror("jsh_bench: parse");
+      exit(EXIT_FAILURE);
+    }
+    strcpy(stpcpy(line, lines[k].first), body);
+    free(body);
+    size_t length = strlen(line);
+    double samples[10];
+    for (size_t i = 0; i < runs; i++) {
+      jsh_script *script;
+      double start = now_us();
+      if (jsh_parse(ctx, line, &script) != JSH_OK) {
+        fprintf(stderr, "jsh_bench: cannot parse the %s line\n",
+                lines[k].name);
+        exit(EXIT_FAILURE);
+      }
+      double time = now_us() - start;
+      jsh_script_free(script);
+      // bytes per microsecond, in MB/s
+      samples[i] = (double)length / time;
+    }
+    free(line);
+    char fields[64];
+    snprintf(fields, sizeof(fields), "\"line\": \"%s\", \"bytes\": %zu",
+             lines[k].name, length);
+    print_distribution("parse", fields, "MB/s", samples, runs);
+  }
+  jsh_free(ctx);
+}
+
+/**
+ * Latency of `check_jobs()` (after each command) and of `jobs`, with `n`
+ * background jobs which never end
+ */
+static void bench_jobs(int n) {
+  int devnull = open("/dev/null", O_WRONLY | O_CLOEXEC);
+  pid_t *pids = malloc(sizeof(pid_t) * (size_t)n);
+  if (devnull == -1 || pids == NULL) {
+    perror("jsh_bench: jobs");
+    exit(EXIT_FAILURE);
+  }
+  int started = 0;
+  for (; started < n; started++) {
+    char *command = strdup("sleep infinity");
+    pid_t pid = fork();
+    if (pid == 0) {
+      setpgid(0, 0);
+      for (;;)
+        pause();
+    }
+    if (pid == -1 || command == NULL) {
+      perror("jsh_bench: jobs");
+      free(command);
+      break;
+    }
+    pids[started] = pid;
+    add_job(pid, RUNNING, command);
+  }
+
+  size_t runs = started > 1000 ? 20 : started > 10 ? 200 : 2000;
+  double *samples = malloc(sizeof(double) * runs);
+  if (samples == NULL) {
+    perror("jsh_bench: jobs");
+    exit(EXIT_FAILURE);
+  }
+  char fields[64];
+  snprintf(fields, sizeof(fields), "\"jobs\": %d", started);
+  for (size_t i = 0; i < runs; i++) {
+    double start = now_us();
+    check_jobs(0, devnull);
+    samples[i] = now_us() - start;
+  }
+  print_distribution("check_jobs", fields, "us", samples, runs);
+
+  char *args[] = {"jobs", NULL};
+  builtin_stdout = devnull;
+  for (size_t i = 0; i < runs; i++) {
+    double start = now_us();
+    jobs(args);
+    samples[i] = now_us() - start;
+  }
+  builtin_stdout = STDOUT_FILENO;
+  print_distribution("jobs", fields, "us", samples, runs);
+
+  for (int i = 0; i < started; i++)
+    kill(pids[i], SIGKILL);
+  // reaps and removes them
+  while (shell->job_list != NULL)
+    check_jobs(0, devnull);
+  free(samples);
+  free(pids);
+  close(devnull);
+}
+
+int main(int argc, char **argv) {
+  int arg = 1;
+  if (arg < argc && strcmp(argv[arg], "-q") == 0) {
+    quick = 1;
+    arg++;
+  }
+  if (arg < argc)
+    jsh_path = argv[arg++];
+  if (arg != argc) {
+    fprintf(stderr, "usage: jsh_bench [-q] [jsh]\n");
+    return 2;
+  }
+  // the runs of the shell must not touch the history of the user
+  setenv("JSH_HISTFILE", "", 1);
+  shell_pid = getpid();
+
+  const char *commit = getenv("BENCH_COMMIT");
+  printf("{\n  \"commit\": \"%s\",\n  \"time\": %lld,\n  \"quick\": %s,\n"
+         "  \"zygote\": %s,\n  \"results\": [",
+         commit != NULL ? commit : "", (long long)time(NULL),
+         quick ? "true" : "false",
+         getenv("JSH_ZYGOTE") != NULL && strcmp(getenv("JSH_ZYGOTE"), "1") == 0
+             ? "true"
+             : "false");
+  double startup = bench_startup();
+  bench_launch(startup);
+  bench_pipeline(startup);
+  bench_parse();
+  bench_jobs(10);
+  bench_jobs(1000);
+  if (!quick)
+    bench_jobs(10000);
+  printf("\n  ]\n}\n");
+  return EXIT_SUCCESS;
+}
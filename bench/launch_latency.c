@@ -0,0 +1,73 @@
+/*
+ * Launch latency of an external command as the resident memory of the shell
+ * grows : `fork()` + `execvp()` from the shell against a launch through the
+ * zygote (see src/zygote.c), which was forked while the process was small.
+ *
+ * usage : launch_latency [launches per size] [max size in MiB]
+ * output : one tab-separated line per size, latencies in microseconds
+ */
+#include "../head/jsh.h"
+
+#include <time.h>
+
+static double now_us(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (double)ts.tv_sec * 1e6 + (double)ts.tv_nsec / 1e3;
+}
+
+static double fork_launch(char **args, int n) {
+  double start = now_us();
+  for (int i = 0; i < n; i++) {
+    int status;
+    pid_t pid = fork();
+    if (pid == 0) {
+      setpgid(0, 0);
+      execute_program(args);
+    }
+    waitpid(pid, &status, 0);
+  }
+  return (now_us() - start) / n;
+}
+
+static double zygote_launch_time(char **args, int n) {
+  double start = now_us();
+  for (int i = 0; i < n; i++) {
+    int status;
+    pid_t pid = zygote_launch(args);
+    if (pid == -1) {
+      fprintf(stderr, "launch_latency: zygote launch failed\n");
+      exit(EXIT_FAILURE);
+    }
+    jsh_waitpid(pid, &status, 0);
+  }
+  return (now_us() - start) / n;
+}
+
+int main(int argc, char **argv) {
+  int n = argc > 1 ? atoi(argv[1]) : 200;
+  size_t max_mb = argc > 2 ? (size_t)atoi(argv[2]) : 1024;
+  char *args[] = {"true", NULL};
+  char *ballast = NULL;
+  size_t size_mb = 0;
+
+  if (start_zygote()) {
+    fprintf(stderr, "launch_latency: cannot start the zygote\n");
+    return EXIT_FAILURE;
+  }
+  printf("rss_mib\tfork_us\tzygote_us\n");
+  for (size_t mb = 0; mb <= max_mb; mb = mb ? mb * 4 : 16) {
+    // grow the heap like a long-lived shell and touch every page
+    char *tmp = realloc(ballast, mb << 20 | 1);
+    if (tmp == NULL)
+      break;
+    ballast = tmp;
+    memset(ballast + (size_mb << 20), 1, (mb - size_mb) << 20);
+    size_mb = mb;
+    printf("%zu\t%.1f\t%.1f\n", mb, fork_launch(args, n),
+           zygote_launch_time(args, n));
+    fflush(stdout);
+  }
+  free(ballast);
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,272 @@
+/*
+ * Latency of the interactive job control of jsh, driven through a
+ * pseudo-terminal as a user would :
+ *
+ *   prompt     Enter on an empty line, until the next prompt
+ *   command    `/bin/true`, until the next prompt
+ *   launch     `sleep`, until it owns the terminal
+ *   stop       Ctrl-Z, until the `Stopped` notice
+ *   fg         `fg %1`, until the job owns the terminal again
+ *   bg         `bg %1`, until the next prompt
+ *   kill       `kill %1`, until the next prompt
+ *
+ * Each round runs these steps on a new job, the results are distributions
+ * over the rounds. The shell runs on a terminal of its own : no terminal is
+ * needed.
+ *
+ * usage : pty_latency [-q] [jsh]
+ * output : a JSON object on the standard output, in microseconds, as the
+ * one of jsh_bench. `-q` runs fewer rounds.
+ */
+#define _GNU_SOURCE // memmem()
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pty.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#define PROMPT "<jsh-pty-latency> "
+// longest wait for an answer of the shell, in microseconds
+#define TIMEOUT 5000000
+
+enum { PROMPT_STEP, COMMAND, LAUNCH, STOP, FG, BG, KILL, NB_STEPS };
+
+static const char *step_names[NB_STEPS] = {"prompt", "command", "launch", "stop",
+                                           "fg",     "bg",      "kill"};
+
+static int master;
+static pid_t shell;
+// output of the shell, read up to `length`, searched from `seen`. The
+// `dropped` bytes before it were removed to make room
+static char output[1 << 16];
+static size_t length = 0;
+static size_t seen = 0;
+static size_t dropped = 0;
+
+static double now_us(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (double)ts.tv_sec * 1e6 + (double)ts.tv_nsec / 1e3;
+}
+
+static int compare_doubles(const void *a, const void *b) {
+  double x = *(const double *)a, y = *(const double *)b;
+  return x < y ? -1 : x > y;
+}
+
+/**
+ * Stops the benchmark, and the shell
+ */
+static void fail(const char *message) {
+  fprintf(stderr, "pty_latency: %s\n", message);
+  fprintf(stderr, "pty_latency: last output of the shell : %.*s\n",
+          (int)(length - seen), output + seen);
+  kill(shell, SIGKILL);
+  exit(EXIT_FAILURE);
+}
+
+/**
+ * Reads what the shell wrote, waiting for at most `timeout` microseconds
+ */
+static void read_output(int timeout) {
+  struct pollfd pfd = {master, POLLIN, 0};
+  if (poll(&pfd, 1, timeout / 1000) <= 0)
+    return;
+  // the searched part is kept, the rest makes room
+  if (length == sizeof(output)) {
+    memmove(output, output + seen, length - seen);
+    length -= seen;
+    dropped += seen;
+    seen = 0;
+  }
+  ssize_t n = read(master, output + length, sizeof(output) - length);
+  if (n == -1 && errno != EINTR && errno != EAGAIN)
+    fail("the shell is gone");
+  if (n > 0)
+    length += (size_t)n;
+}
+
+/**
+ * Waits for `text` in the output of the shell, then skips past it
+ */
+static void wait_for(const char *text) {
+  double start = now_us();
+  for (;;) {
+    char *found = length > seen ? memmem(output + seen, length - seen, text,
+                                         strlen(text))
+                                : NULL;
+    if (found != NULL) {
+      seen = (size_t)(found - output) + strlen(text);
+      return;
+    }
+    if (now_us() - start > TIMEOUT) {
+      char message[128];
+      snprintf(message, sizeof(message), "no \"%s\" from the shell", text);
+      fail(message);
+    }
+    read_output(100000);
+  }
+}
+
+/**
+ * Waits until the terminal belongs to the process group `pgid`, or to
+ * another group than `pgid` if `other`
+ *
+ * @return the process group owning the terminal
+ */
+static pid_t wait_terminal(pid_t pgid, int other) {
+  double start = now_us();
+  for (;;) {
+    pid_t owner = tcgetpgrp(master);
+    if (owner > 0 && (other ? owner != pgid : owner == pgid))
+      return owner;
+    if (now_us() - start > TIMEOUT)
+      fail("the terminal did not change hands");
+    // the output is drained for the shell not to block on it
+    read_output(0);
+  }
+}
+
+static void type(const char *keys) {
+  if (write(master, keys, strlen(keys)) != (ssize_t)strlen(keys))
+    fail("cannot write to the terminal");
+}
+
+/**
+ * Starts the shell on a new pseudo-terminal, and waits for its prompt
+ */
+static void start_shell(char *jsh) {
+  setenv("JSH_PS1", PROMPT, 1);
+  setenv("JSH_HISTFILE", "", 1);
+  setenv("TERM", "dumb", 1);
+  struct winsize size = {24, 80, 0, 0};
+  shell = forkpty(&master, NULL, NULL, &size);
+  if (shell == -1) {
+    perror("pty_latency: forkpty");
+    exit(EXIT_FAILURE);
+  }
+  if (shell == 0) {
+    char *args[] = {jsh, NULL};
+    execv(jsh, args);
+    perror("pty_latency: exec");
+    _exit(127);
+  }
+  wait_for(PROMPT);
+}
+
+/**
+ * Prints the distribution of the `n` samples of a step
+ */
+static void print_step(int step, double *samples, size_t n, int first) {
+  double sum = 0;
+  for (size_t i = 0; i < n; i++)
+    sum += samples[i];
+  qsort(samples, n, sizeof(double), compare_doubles);
+  printf("%s\n    {\"name\": \"%s\", \"unit\": \"us\", \"runs\": %zu, "
+         "\"mean\": %.3f, \"p50\": %.3f, \"p99\": %.3f, \"min\": %.3f, "
+         "\"max\": %.3f}",
+         first ? "" : ",", step_names[step], n, sum / (double)n,
+         samples[(size_t)(0.5 * (double)(n - 1) + 0.5)],
+         samples[(size_t)(0.99 * (double)(n - 1) + 0.5)], samples[0],
+         samples[n - 1]);
+}
+
+int main(int argc, char **argv) {
+  int arg = 1;
+  size_t rounds = 200;
+  if (arg < argc && strcmp(argv[arg], "-q") == 0) {
+    rounds = 20;
+    arg++;
+  }
+  char *jsh = arg < argc ? argv[arg++] : "./jsh";
+  if (arg != argc) {
+    fprintf(stderr, "usage: pty_latency [-q] [jsh]\n");
+    return 2;
+  }
+
+  double *samples[NB_STEPS];
+  for (int i = 0; i < NB_STEPS; i++) {
+    if ((samples[i] = malloc(sizeof(double) * rounds)) == NULL) {
+      perror("pty_latency");
+      return EXIT_FAILURE;
+    }
+  }
+  start_shell(jsh);
+  pid_t shell_pgid = tcgetpgrp(master);
+
+  for (size_t round = 0; round < rounds; round++) {
+    double start = now_us();
+    type("\n");
+    wait_for(PROMPT);
+    samples[PROMPT_STEP][round] = now_us() - start;
+
+    start = now_us();
+    type("/bin/true\n");
+    wait_for(PROMPT);
+    samples[COMMAND][round] = now_us() - start;
+
+    start = now_us();
+    type("sleep 1000\n");
+    pid_t job = wait_terminal(shell_pgid, 1);
+    samples[LAUNCH][round] = now_us() - start;
+
+    start = now_us();
+    type("\032");
+    wait_for("Stopped");
+    samples[STOP][round] = now_us() - start;
+    wait_for(PROMPT);
+
+    start = now_us();
+    type("fg %1\n");
+    wait_terminal(job, 0);
+    samples[FG][round] = now_us() - start;
+    type("\032");
+    wait_for("Stopped");
+    wait_for(PROMPT);
+
+    start = now_us();
+    type("bg %1\n");
+    wait_for(PROMPT);
+    samples[BG][round] = now_us() - start;
+
+    start = now_us();
+    type("kill %1\n");
+    wait_for(PROMPT);
+    samples[KILL][round] = now_us() - start;
+    // `%1` is free again once the end of the job is noticed : `jobs`
+    // then lists nothing
+    for (int listed = 1; listed;) {
+      size_t mark = dropped + seen;
+      type("jobs\n");
+      wait_for(PROMPT);
+      listed = memmem(output + (mark - dropped), seen - (mark - dropped),
+                      "sleep", 5) != NULL;
+    }
+  }
+
+  type("exit\n");
+  int status;
+  double start = now_us();
+  while (waitpid(shell, &status, WNOHANG) == 0) {
+    if (now_us() - start > TIMEOUT)
+      fail("the shell did not exit");
+    read_output(10000);
+  }
+
+  const char *zygote = getenv("JSH_ZYGOTE");
+  printf("{\n  \"commit\": \"%s\",\n  \"time\": %lld,\n  \"rounds\": %zu,\n"
+         "  \"zygote\": %s,\n  \"results\": [",
+         getenv("BENCH_COMMIT") != NULL ? getenv("BENCH_COMMIT") : "",
+         (long long)time(NULL), rounds,
+         zygote != NULL && strcmp(zygote, "1") == 0 ? "true" : "false");
+  for (int i = 0; i < NB_STEPS; i++)
+    print_step(i, samples[i], rounds, i == 0);
+  printf("\n  ]\n}\n");
+  return EXIT_SUCCESS;
+}
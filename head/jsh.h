@@ -1,27 +1,42 @@
 #ifndef JSH_H
 #define JSH_H
 
+#define _GNU_SOURCE
+
 #define MAX_PROMPT_LENGTH 30
 #define MAX_TOKENS 64
 #define DELIMITERS " \t\r\n\a"
 #define REDIRECT_ERROR 3
-#define REDIRECTIONS_SIZE 11
+#define REDIRECTIONS_SIZE 20
+#define PARSE_GROUP 2
+#define PARSE_COMPOUND 3
+// flags of the built-ins
+#define BUILTIN_THREADED 1 // can run on a thread as the first stage of a
+                           // pipeline : neither reads stdin nor changes the
+                           // shell
+#define BUILTIN_STAGE 2    // only run in-process as a stage of a pipeline
 
+#include <dirent.h>
 #include <errno.h>
 #include <fcntl.h>
 #include <libgen.h>
 #include <limits.h>
+#include <pthread.h>
 #include <readline/history.h>
 #include <readline/readline.h>
 #include <signal.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/resource.h>
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <sys/wait.h>
 #include <unistd.h>
 
+#include "jsh_builtin.h"
+
 typedef enum {
   REDIRECT_OUT,
   REDIRECT_IN,
@@ -33,7 +48,15 @@ typedef enum {
   PIPE,
   BACKGROUND,
   SUBSTITUTION,
-  SUBSTITUTION_OUT
+  SUBSTITUTION_OUT,
+  SEQUENCE,
+  AND,
+  OR,
+  GROUP,
+  GROUP_OUT,
+  DUP_OUT,
+  DUP_IN,
+  DUP_ERR
 } RedirectionType;
 
 typedef struct {
@@ -62,13 +85,77 @@ typedef struct Command {
   Argument *arguments;
   Redirection *redirection;
   struct Command **substitutions;
+  int *substitution_fds; // read ends of the substitutions pipes
   size_t nb_substitutions;
   size_t size_substitutions;
   int background;
   int *pipe;
+  RedirectionType connector; // `;`, `&&` or `||` after the command
+  struct Command *group;     // body of `{ ... }`, `if`, `while` and `for`
+  struct Command *condition; // condition of `if` and `while`
+  struct Command *alternative; // `else` branch of `if`
   struct Command *next;
 } Command;
 
+// built-in of the shell, returning its exit code
+typedef int (*CommandFunc)(char **args);
+
+typedef struct {
+  char *name;
+  CommandFunc func;
+  jsh_builtin_func loaded; // built-in of a library loaded by `enable -f`
+  int flags;
+} ExecutableCommand;
+
+/**
+ * Hash of the names of the built-ins, perfect for the seed found by
+ * `tools/gen_builtin_hash` : FNV-1a from `seed`, keeping the `bits` high bits
+ */
+static inline size_t builtin_hash(const char *name, uint64_t seed, int bits) {
+  uint64_t hash = 14695981039346656037ULL ^ seed;
+  for (; *name != '\0'; name++) {
+    hash ^= (unsigned char)*name;
+    hash *= 1099511628211ULL;
+  }
+  // the multiplication moves the entropy of the low bits to the high bits
+  return (size_t)((hash * 0x9E3779B97F4A7C15ULL) >> (64 - bits));
+}
+
+// events recorded with `JSH_TRACE` (see `trace.c`)
+typedef enum {
+  TRACE_PARSE_BEGIN,
+  TRACE_PARSE_END,
+  TRACE_FORK,     // subject : the child
+  TRACE_EXEC,     // name : the program
+  TRACE_EXIT,     // subject : the child reaped, arg : its exit code
+  TRACE_STOP,     // subject : the child stopped, arg : the signal
+  TRACE_JOB,      // subject : the job, arg : its new state, name : command
+  TRACE_TERMINAL  // arg : process group given the terminal
+} trace_type;
+
+typedef struct TraceRing TraceRing;
+
+// hardware counters of a job with `JSH_PERF` (see `perf.c`)
+#define PERF_COUNTERS 4
+typedef struct PerfCounters PerfCounters;
+
+// variables of a shell (see `variables.c`), switched by `libjsh.c`
+typedef struct {
+  struct Variable **table;
+  size_t table_size;
+  size_t nb_variables;
+  char **envp;
+  int envp_dirty;
+} Variables;
+
+// current directory of a shell (see `directory.c`), switched by `libjsh.c`
+typedef struct {
+  char *pwd;    // logical path, `NULL` if unknown
+  char **stack; // directories pushed by `pushd`, from the top
+  size_t nb_stack;
+  size_t stack_size;
+} Directories;
+
 typedef enum { RUNNING, STOPPED, DONE, KILLED, DETACHED } job_state;
 
 typedef struct job {
@@ -76,42 +163,78 @@ typedef struct job {
   pid_t pid;        // process ID
   job_state state;  // job state
   char *command;    // command line
+  PerfCounters *perf; // hardware counters, `NULL` if not counted
+  struct timespec start; // launch of the job, `CLOCK_REALTIME`
+  struct rusage usage; // resources used, as of the last stop or end
   struct job *next; // next job in the list
 } job_t;
 
-extern int last_exit_code;
-extern int run;
-extern job_t *job_list;
-extern int njob;
-extern int idjob;
+// jobs of a shell, kept in its libjsh context
+typedef struct {
+  job_t *job_list;
+  int njob;
+  int idjob; // number of the next job
+  int run;   // `0` once `exit` ran, `2` after its warning about the jobs
+} Shell;
+
+// each thread running a built-in has its own exit code and standard output
+extern _Thread_local int last_exit_code;
+extern _Thread_local int builtin_stdout;
+// shell of the context used by the thread
+extern _Thread_local Shell *shell;
+extern pid_t shell_pid;
+extern char *fd_audit;
+extern int pipe_size;
+extern TraceRing *trace_ring;
+extern int perf_enabled;
 
-// main.c
+// records an event when tracing is enabled, a single test otherwise
+#define TRACE(type, subject, arg, name)                                        \
+  do {                                                                         \
+    if (__builtin_expect(trace_ring != NULL, 0))                               \
+      trace_event(type, subject, arg, name);                                   \
+  } while (0)
+
+// libjsh.c
 void signals(int mode);
+int suspend_context(void);
+void resume_context(int suspended);
 
 // builtin.c
-void cd(char **args);
-void jexit(char **args);
-void pwd(void);
-void question_mark(void);
-void jobs(char **args);
-void fg(char **args);
-void bg(char **args);
-void send_signal(int sig, char *target);
-void kill_job(char **args);
+int jexit(char **args);
+int question_mark(char **args);
+int jobs(char **args);
+int fg(char **args);
+int bg(char **args);
+int send_signal(int sig, char *target);
+int kill_job(char **args);
 void check_state(pid_t pid, int sig);
 int is_Number(const char *str);
+int copy_fd(int in, int out);
+int jcat(char **args);
+int jtee(char **args);
 
 // prompt.c
-void current_folder(char *prompt);
-void build_prompt(char *prompt);
+const char *build_prompt(void);
+
+// complete.c
+void init_completion(void);
 
 // parser.c
-Command *parse_command(char *line , int substituting);
+Command *parse_command(char *line, int *incomplete);
+char **expand_arguments(Argument *arguments);
 char **get_full_command(Command *cmd);
+void free_full_command(char **args);
 char *get_command(Command *cmd);
 char *get_command2(char **args);
 
 // execute.c
+void execute_program(char **args);
+int start_foreground_job(void);
+void wait_leader(pid_t pid, int *status, struct rusage *usage, int release);
+void wait_foreground(pid_t pid, char **args, int interactive,
+                     PerfCounters *perf);
+int run_job(char **args, int (*func)(void *), void *data);
 void execute_external_command(char **args);
 void execute_command(char **args, int forking);
 int handle_command_redirections(Command *cmd, int forking);
@@ -119,7 +242,109 @@ int handle_piped_commands(Command *commands, int forking);
 int handle_substitution_commands(Command *commands, int forking, char *path);
 void execution(Command *commands , int substituting);
 
+// variables.c
+void init_variables(void);
+void switch_variables(Variables *save, const Variables *load);
+void clear_variables(void);
+int is_name(const char *word);
+int is_assignment(const char *word);
+char *get_variable(const char *name);
+int is_exported(const char *name);
+int set_variable(const char *name, const char *value, int export);
+int export_variable(const char *name);
+void unset_variable(const char *name);
+char **variables_environ(void);
+size_t environ_size(void);
+char *expand_word(const char *word);
+int export(char **args);
+int unset(char **args);
+void execute_assignments(char **args, int forking);
+
+// directory.c
+void init_directories(void);
+void switch_directories(Directories *save, const Directories *load);
+void clear_directories(void);
+const char *current_directory(void);
+unsigned long directory_version(void);
+int change_directory(const char *path, int physical);
+int cd(char **args);
+int pwd(char **args);
+int dirs(char **args);
+int pushd(char **args);
+int popd(char **args);
+
+// glob.c
+int has_glob(const char *word);
+int glob_word(const char *pattern, char ***words, size_t *position,
+              size_t *size);
+void clear_glob_cache(void);
+int check_arg_max(char **args);
+
+// batch.c
+int batch(char **args);
+
+// parallel.c
+int parallel(char **args);
+
+// utilities.c
+int jecho(char **args);
+int jprintf(char **args);
+int jtest(char **args);
+int jread(char **args);
+int jtrue(char **args);
+int jfalse(char **args);
+
+// dispatch.c
+const ExecutableCommand *find_builtin(const char *name, int forking);
+const char *next_builtin(size_t *position);
+void run_builtin(const ExecutableCommand *builtin, char **args);
+int enable(char **args);
+
+// coproc.c
+int coproc(char **args);
+
+// cache.c
+int jcache(char **args);
+
+// history.c
+void open_history(void);
+void history_add(const char *line);
+int history(char **args);
+
+// zygote.c
+int start_zygote(void);
+pid_t zygote_launch(char **args);
+pid_t jsh_waitpid(pid_t pid, int *status, int options);
+pid_t waitpid_usage(pid_t pid, int *status, int options, struct rusage *usage);
+pid_t wait_any(const pid_t *pids, size_t n, int *status);
+int write_all(int fd, const void *buffer, size_t size);
+int read_all(int fd, void *buffer, size_t size);
+
+// serve.c
+int serve(const char *path);
+
+// trace.c
+void trace_event(trace_type type, pid_t subject, int64_t arg,
+                 const char *name);
+int start_trace(const char *path);
+void write_json_string(FILE *file, const char *s);
+
+// board.c
+void publish_jobs(void);
+void board_ended(const job_t *job);
+int start_board(const char *path);
+int print_jobs_json(int fdout);
+
+// perf.c
+void perf_prepare(int sync[2]);
+void perf_child(int sync[2]);
+PerfCounters *perf_attach(pid_t pid, int sync[2]);
+void print_perf_counters(const PerfCounters *perf, int fdout);
+void perf_free(PerfCounters *perf);
+
 // job.c
+void lock_jobs(void);
+void unlock_jobs(void);
 job_t *add_job(pid_t pid, job_state state, char *command);
 void add_job_list(job_t *job);
 void remove_job(pid_t pid);
@@ -137,6 +362,8 @@ Argument *add_argument(Command *command, char *value);
 Redirection *create_redirection(RedirectionType type, char *value);
 Redirection *add_redirection(Command *command, RedirectionType type,
                              char *value);
+int add_substitution(Command *command, Command *substitution, int fd);
+int open_substitution(Command *command, size_t k);
 RedirectionType *find_redirection_type(char *token);
 void clear_command(Command *command);
 
@@ -147,5 +374,8 @@ int redirect_output(char *filename, int err, int mode, int create);
 int save_redirections(int *SAVE_STDOUT, int *SAVE_STDIN, int *SAVE_STDERR);
 int reset_redirections(int SAVE_STDOUT, int SAVE_STDIN, int SAVE_STDERR);
 int redirect_input(char *filename);
+int redirect_fd(const char *fd, int target);
+void inherit_substitutions(Command *cmd, int inherit);
+void audit_fds(char **args);
 
 #endif
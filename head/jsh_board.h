@@ -0,0 +1,85 @@
+#ifndef JSH_BOARD_H
+#define JSH_BOARD_H
+
+/*
+ * Job board of `JSH_BOARD=file` : the shell publishes its job table in
+ * `file`, which monitors map read-only and read without talking to the
+ * shell :
+ *
+ *   int fd = open(path, O_RDONLY);
+ *   const jsh_board *board = mmap(NULL, sizeof(jsh_board), PROT_READ,
+ *                                 MAP_SHARED, fd, 0);
+ *   jsh_board copy;
+ *   if (jsh_board_read(board, &copy) == 0)
+ *     for (uint32_t i = 0; i < copy.nb_jobs; i++)
+ *       printf("[%d] %s\n", copy.jobs[i].id, copy.jobs[i].command);
+ *
+ * The board is protected by a sequence lock : `seq` is odd while the shell
+ * writes it, and changes at each update. `jsh_board_read()` copies it until
+ * it gets a copy taken between two updates. The shell removes the file when
+ * it exits.
+ */
+
+#include <stdint.h>
+#include <string.h>
+
+#define JSH_BOARD_MAGIC 0x4248534a // "JSHB"
+#define JSH_BOARD_VERSION 1
+
+// entries of the board : the jobs of the shell, then the last ones ended
+#define JSH_BOARD_JOBS 64
+#define JSH_BOARD_COMMAND 256
+
+typedef struct {
+  int32_t id;         // job number, as `%id`
+  int32_t pgid;       // process group of the job
+  int32_t state;      // as `JSH_JOB_*` of libjsh.h : 0 running, 1 stopped,
+                      // 2 done, 3 killed, 4 detached
+  int32_t reserved;
+  int64_t start_us;   // launch of the job, since the epoch
+  int64_t end_us;     // end of the job, `0` while it runs
+  int64_t utime_us;   // user time of the job, as of its last stop or end
+  int64_t stime_us;   // system time
+  int64_t maxrss_kb;  // largest resident set size
+  char command[JSH_BOARD_COMMAND]; // command line, truncated
+} jsh_board_job;
+
+typedef struct {
+  uint32_t magic;    // `JSH_BOARD_MAGIC`, set once the board is ready
+  uint32_t version;  // `JSH_BOARD_VERSION`
+  uint32_t size;     // `sizeof(jsh_board)`
+  int32_t pid;       // the shell
+  uint64_t seq;      // odd while the board is written
+  int64_t update_us; // last update, since the epoch
+  uint32_t nb_jobs;  // entries in use
+  uint32_t nb_live;  // the first `nb_live` entries are the jobs of the shell
+  jsh_board_job jobs[JSH_BOARD_JOBS];
+} jsh_board;
+
+/**
+ * Copies a consistent snapshot of the board
+ *
+ * @param board : board mapped from the file of the shell
+ * @param copy : set to the snapshot
+ * @return `0` on success, `-1` if the file is not a board of this version,
+ * or if it stays locked (the shell died while writing it)
+ */
+static inline int jsh_board_read(const jsh_board *board, jsh_board *copy) {
+  if (__atomic_load_n(&board->magic, __ATOMIC_ACQUIRE) != JSH_BOARD_MAGIC ||
+      board->version != JSH_BOARD_VERSION || board->size != sizeof(jsh_board))
+    return -1;
+  for (long tries = 0; tries < 1000000; tries++) {
+    uint64_t seq = __atomic_load_n(&board->seq, __ATOMIC_ACQUIRE);
+    if (seq & 1)
+      continue;
+    memcpy(copy, board, sizeof(jsh_board));
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    if (__atomic_load_n(&board->seq, __ATOMIC_RELAXED) == seq) {
+      copy->seq = seq;
+      return 0;
+    }
+  }
+  return -1;
+}
+
+#endif
@@ -0,0 +1,61 @@
+#ifndef JSH_BUILTIN_H
+#define JSH_BUILTIN_H
+
+/*
+ * Interface of the built-ins loaded by `enable -f library.so`.
+ *
+ * The library exports `jsh_builtins_init()`, which calls `add` once for each
+ * of its built-ins. A built-in then runs in the shell process, without
+ * `fork()` nor `execvp()`, and returns its exit code :
+ *
+ *   static int hello(int argc, char **argv, const jsh_io *io) {
+ *     dprintf(io->out, "hello %s\n", argc > 1 ? argv[1] : "world");
+ *     return 0;
+ *   }
+ *
+ *   int jsh_builtins_init(int version, jsh_register_func add) {
+ *     static const jsh_builtin builtin = {"hello", hello, JSH_THREADED};
+ *     return version != JSH_BUILTIN_VERSION || add(&builtin);
+ *   }
+ *
+ * Build it with `gcc -shared -fPIC -I head hello.c -o hello.so`.
+ */
+
+#define JSH_BUILTIN_VERSION 1
+
+// the built-in neither reads its standard input nor changes the state of the
+// shell : it can run on a thread as the first stage of a pipeline
+#define JSH_THREADED 1
+
+// name of the function looked up in the libraries
+#define JSH_BUILTINS_INIT "jsh_builtins_init"
+
+// descriptors of the built-in, already redirected. Use them rather than
+// `STDOUT_FILENO` : on a thread, the output is a pipe
+typedef struct {
+  int in;
+  int out;
+  int err;
+} jsh_io;
+
+typedef int (*jsh_builtin_func)(int argc, char **argv, const jsh_io *io);
+
+typedef struct {
+  const char *name;      // copied by the shell
+  jsh_builtin_func func;
+  int flags;             // `JSH_THREADED` or `0`
+} jsh_builtin;
+
+// registers a built-in, returns `0` on success
+typedef int (*jsh_register_func)(const jsh_builtin *builtin);
+
+/**
+ * Registers the built-ins of the library
+ *
+ * @param version : `JSH_BUILTIN_VERSION` of the shell
+ * @param add : function registering a built-in
+ * @return `0` on success
+ */
+int jsh_builtins_init(int version, jsh_register_func add);
+
+#endif
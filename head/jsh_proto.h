@@ -0,0 +1,57 @@
+#ifndef JSH_PROTO_H
+#define JSH_PROTO_H
+
+/*
+ * Protocol of `jsh --serve socket`, spoken by `jshc`.
+ *
+ * The client connects to the Unix socket and sends one request : a
+ * `jsh_request` header, with its three standard descriptors attached by
+ * `SCM_RIGHTS`, followed by `length` bytes of payload :
+ *
+ *   cwd\0 word\0 ... word\0 env\0 ... env\0
+ *
+ * with `nb_words` words (the arguments of a program, or a single command
+ * line with `JSH_REQUEST_LINE`) and `nb_env` changes of the environment
+ * (`NAME=value` exports the variable, `NAME` unsets it).
+ *
+ * The server answers with a `jsh_reply` of type `JSH_REPLY_STARTED` once the
+ * command starts, then one of type `JSH_REPLY_DONE` with its exit code and
+ * resource usage.
+ */
+
+#include <stdint.h>
+
+#define JSH_PROTO_MAGIC 0x3148534a // "JSH1"
+#define JSH_PROTO_VERSION 1
+
+// longest payload accepted by the server
+#define JSH_PROTO_MAX_PAYLOAD (16 << 20)
+
+// the words are a command line, parsed and run as typed in the shell
+#define JSH_REQUEST_LINE 1
+
+typedef struct {
+  uint32_t magic;    // `JSH_PROTO_MAGIC`
+  uint32_t version;  // `JSH_PROTO_VERSION`
+  uint32_t flags;    // `JSH_REQUEST_LINE` or `0`
+  uint32_t nb_fds;   // descriptors attached : always 3, stdin, stdout and
+                     // stderr in this order
+  uint32_t nb_words;
+  uint32_t nb_env;
+  uint32_t length;   // bytes of payload following the header
+} jsh_request;
+
+enum { JSH_REPLY_STARTED = 1, JSH_REPLY_DONE = 2 };
+
+typedef struct {
+  uint32_t magic;     // `JSH_PROTO_MAGIC`
+  uint32_t type;      // `JSH_REPLY_STARTED` or `JSH_REPLY_DONE`
+  int32_t pid;        // process running the request
+  int32_t status;     // exit code, as `$?`
+  int64_t utime_us;   // user time of the request and its children
+  int64_t stime_us;   // system time
+  int64_t maxrss_kb;  // largest resident set size
+  int64_t real_us;    // elapsed time
+} jsh_reply;
+
+#endif
@@ -0,0 +1,156 @@
+#ifndef LIBJSH_H
+#define LIBJSH_H
+
+/*
+ * Interface of libjsh, the parser, executor and job table of jsh as a library
+ * (`make libjsh.a libjsh.so`) :
+ *
+ *   jsh_ctx *ctx = jsh_new();
+ *   jsh_script *script;
+ *   if (jsh_parse(ctx, "make -j8 2>&1 | tee build.log", &script) == JSH_OK) {
+ *     int status = jsh_run(ctx, script);
+ *     jsh_script_free(script);
+ *   }
+ *   jsh_free(ctx);
+ *
+ * A context holds the state of one shell : its variables, jobs, exit code and
+ * current directory. Each context may be used by one thread at a time.
+ *
+ * The contexts are serialized, not independent. The commands run in the
+ * process (its current directory is the one of the context running, its
+ * descriptors are redirected while a command runs), so a single process-wide
+ * lock is taken by `jsh_new()`, `jsh_run()`, `jsh_free()` and the calls on
+ * variables : one context runs at a time, and the lock is released only while
+ * a context waits for a foreground program. `jsh_parse()`, `jsh_wait()`,
+ * `jsh_job_next()`, `jsh_exited()` and `jsh_status()` do not take it.
+ *
+ * The contexts also share process-wide state : the cache of the globs, the
+ * tables of the built-ins (with those loaded by `enable -f`), the
+ * coprocesses, the zygote of `JSH_ZYGOTE=1` and the lock of the job tables.
+ *
+ * While `jsh_run()` runs, the process ignores the signals of job control
+ * (`SIGINT`, `SIGTSTP`, `SIGTTOU`...) like the interactive shell.
+ */
+
+#include <sys/types.h>
+
+#if defined(__GNUC__)
+#define JSH_API __attribute__((visibility("default")))
+#else
+#define JSH_API
+#endif
+
+typedef struct jsh_ctx jsh_ctx;
+
+// commands parsed by `jsh_parse()`, run by `jsh_run()`
+typedef struct jsh_script jsh_script;
+
+// results of `jsh_parse()`
+enum {
+  JSH_OK = 0,
+  JSH_INCOMPLETE = 1,   // an `if`, `while`, `for` or `{` is left open :
+                        // parse the line joined with the next one
+  JSH_SYNTAX_ERROR = 2, // reported on the standard error
+  JSH_NO_MEMORY = 3
+};
+
+// states of the jobs, as listed by `jobs`
+enum {
+  JSH_JOB_RUNNING,
+  JSH_JOB_STOPPED,
+  JSH_JOB_DONE,
+  JSH_JOB_KILLED,
+  JSH_JOB_DETACHED
+};
+
+typedef struct {
+  int id;              // job number, as `%id`
+  pid_t pid;           // leader of its process group
+  int state;           // `JSH_JOB_*`
+  const char *command; // valid until the next call with the context
+} jsh_job;
+
+/**
+ * Creates a shell, with the environment of the process as exported variables
+ * and its current directory
+ *
+ * @return the context, `NULL` on error
+ */
+JSH_API jsh_ctx *jsh_new(void);
+
+/**
+ * Frees a shell. Its jobs keep running, detached
+ */
+JSH_API void jsh_free(jsh_ctx *ctx);
+
+/**
+ * Parses a command line, which may span several lines
+ *
+ * @param script : set to the commands parsed on `JSH_OK`
+ * @return `JSH_OK`, `JSH_INCOMPLETE`, `JSH_SYNTAX_ERROR` or `JSH_NO_MEMORY`
+ */
+JSH_API int jsh_parse(jsh_ctx *ctx, const char *line, jsh_script **script);
+
+/**
+ * Runs the commands of a script, as typed in the shell : the pipelines ended
+ * by `&` become jobs of the context, a foreground command stopped by
+ * `Ctrl-Z` too. A script can run several times, in any context. Nothing runs
+ * once a script of the context called `exit`
+ *
+ * @return the exit code of the last command, as `$?`
+ */
+JSH_API int jsh_run(jsh_ctx *ctx, jsh_script *script);
+
+/**
+ * Frees a script
+ */
+JSH_API void jsh_script_free(jsh_script *script);
+
+/**
+ * Waits for the job `id` to end or stop. An ended job leaves the job table
+ *
+ * @param status : set to its exit code, `128 + signal` if it was killed or
+ * stopped
+ * @return `0` on success, `-1` if there is no such job
+ */
+JSH_API int jsh_wait(jsh_ctx *ctx, int id, int *status);
+
+/**
+ * Iterates over the jobs, by increasing number :
+ *
+ *   for (jsh_job job = {0}; jsh_job_next(ctx, job.id, &job);)
+ *
+ * The states are the ones known by the shell : `jsh_wait()` and the `jobs`
+ * built-in update them
+ *
+ * @param id : number of the previous job, `0` to start
+ * @return `1` if `job` is set to the next job, `0` after the last one
+ */
+JSH_API int jsh_job_next(jsh_ctx *ctx, int id, jsh_job *job);
+
+/**
+ * Returns `1` if the shell ran `exit`, `0` otherwise
+ */
+JSH_API int jsh_exited(jsh_ctx *ctx);
+
+/**
+ * Returns the exit code of the last command, as `$?`
+ */
+JSH_API int jsh_status(jsh_ctx *ctx);
+
+/**
+ * Returns a copy of the value of the variable `name`, to free, `NULL` if it
+ * does not exist
+ */
+JSH_API char *jsh_get_variable(jsh_ctx *ctx, const char *name);
+
+/**
+ * Sets the variable `name`
+ *
+ * @param export : `1` to export it to the programs
+ * @return `0` on success, `-1` on error
+ */
+JSH_API int jsh_set_variable(jsh_ctx *ctx, const char *name, const char *value,
+                             int export);
+
+#endif
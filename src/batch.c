@@ -0,0 +1,206 @@
+#include "../head/jsh.h"
+
+// room kept free in `ARG_MAX`, as `xargs` does, for what the kernel adds
+// to the arguments (program path, auxiliary vector...)
+#define BATCH_HEADROOM 2048
+
+// combined status of the batches, as for `xargs`
+#define BATCH_FAILED 123
+#define BATCH_KILLED 125
+
+typedef struct {
+  char **fixed;      // command and its fixed arguments
+  size_t nb_fixed;
+  char **items;      // items to split
+  size_t *ends;      // end of each batch in `items`
+  size_t nb_batches;
+  size_t jobs;       // maximum number of batches run at once
+} Batches;
+
+/**
+ * Splits `items` into the fewest invocations of `fixed` fitting in
+ * `ARG_MAX`, greedily filling each one
+ *
+ * @param fixed : command and its fixed arguments
+ * @param nb_fixed : number of fixed arguments, with the command
+ * @param items : items to split, `NULL`-terminated
+ * @param nb_batches : set to the number of batches
+ * @return the index in `items` of the end of each batch, `NULL` on error
+ * with a message
+ */
+static size_t *split_batches(char **fixed, size_t nb_fixed, char **items,
+                             size_t *nb_batches) {
+  long arg_max = sysconf(_SC_ARG_MAX);
+  // longest single argument accepted by Linux
+  size_t max_strlen = (size_t)sysconf(_SC_PAGESIZE) * 32;
+  size_t limit = arg_max > 0 ? (size_t)arg_max : 131072;
+  limit = limit > BATCH_HEADROOM ? limit - BATCH_HEADROOM : 0;
+
+  // room taken by every invocation : environment, fixed arguments and the
+  // final `NULL`
+  size_t base = environ_size() + sizeof(char *);
+  for (size_t i = 0; i < nb_fixed; i++)
+    base += strlen(fixed[i]) + 1 + sizeof(char *);
+  if (base >= limit) {
+    fprintf(stderr, "jsh: batch: %s: fixed arguments and environment too long "
+                    "(%zu bytes, limit %zu)\n", fixed[0], base, limit);
+    return NULL;
+  }
+
+  size_t nb_items = 0;
+  while (items[nb_items] != NULL)
+    nb_items++;
+  // a batch without items when there are none, to run the command once
+  size_t *ends = malloc((nb_items + 1) * sizeof(size_t));
+  if (ends == NULL) {
+    perror("jsh: batch");
+    return NULL;
+  }
+  *nb_batches = 0;
+  size_t size = base;
+  for (size_t i = 0; i < nb_items; i++) {
+    size_t len = strlen(items[i]) + 1;
+    if (len > max_strlen || base + len + sizeof(char *) > limit) {
+      fprintf(stderr, "jsh: batch: %s: argument too long (%zu bytes)\n",
+              fixed[0], len);
+      free(ends);
+      return NULL;
+    }
+    if (size + len + sizeof(char *) > limit) {
+      ends[(*nb_batches)++] = i;
+      size = base;
+    }
+    size += len + sizeof(char *);
+  }
+  ends[(*nb_batches)++] = nb_items;
+  return ends;
+}
+
+/**
+ * Runs the batches, at most `jobs` at a time, and waits for all of them
+ *
+ * @param data : the `Batches` to run
+ * @return the combined status : `0` if all the batches succeeded,
+ * `BATCH_KILLED` if one was killed by a signal, `BATCH_FAILED` if one failed
+ */
+static int run_batches(void *data) {
+  Batches *batches = data;
+  char **fixed = batches->fixed;
+  size_t nb_fixed = batches->nb_fixed;
+  char **items = batches->items;
+  size_t *ends = batches->ends;
+  size_t nb_batches = batches->nb_batches;
+  size_t jobs = batches->jobs;
+  size_t longest = 0;
+  for (size_t b = 0, start = 0; b < nb_batches; start = ends[b++])
+    if (ends[b] - start > longest)
+      longest = ends[b] - start;
+  char **argv = malloc((nb_fixed + longest + 1) * sizeof(char *));
+  if (argv == NULL) {
+    perror("jsh: batch");
+    return EXIT_FAILURE;
+  }
+  memcpy(argv, fixed, nb_fixed * sizeof(char *));
+  if (jobs > nb_batches)
+    jobs = nb_batches;
+  pid_t *pids = malloc(jobs * sizeof(pid_t));
+  if (pids == NULL) {
+    perror("jsh: batch");
+    free(argv);
+    return EXIT_FAILURE;
+  }
+
+  int result = EXIT_SUCCESS;
+  size_t running = 0;
+  size_t next = 0;
+  size_t start = 0;
+  while (next < nb_batches || running > 0) {
+    if (next < nb_batches && running < jobs) {
+      size_t count = ends[next] - start;
+      memcpy(argv + nb_fixed, items + start, count * sizeof(char *));
+      argv[nb_fixed + count] = NULL;
+      pid_t pid = fork();
+      if (pid == 0)
+        execute_program(argv);
+      if (pid > 0) {
+        pids[running++] = pid;
+        start = ends[next++];
+        continue;
+      }
+      perror("jsh: batch: fork error");
+      result = EXIT_FAILURE;
+      // the remaining batches are dropped, the running ones still awaited
+      nb_batches = next;
+      if (running == 0)
+        break;
+    }
+
+    // inside a job, the process may have other children than the workers :
+    // only the workers are waited for
+    int status;
+    pid_t pid = wait_any(pids, running, &status);
+    if (pid == -1) {
+      if (errno == EINTR)
+        continue;
+      break;
+    }
+    size_t k = 0;
+    while (k < running && pids[k] != pid)
+      k++;
+    pids[k] = pids[--running];
+    if (WIFSIGNALED(status))
+      result = BATCH_KILLED;
+    else if (WEXITSTATUS(status) != 0 && result == EXIT_SUCCESS)
+      result = BATCH_FAILED;
+  }
+  free(pids);
+  free(argv);
+  return result;
+}
+
+/**
+ * Runs a command on a list of items too long for a single `execvp()`, in
+ * the fewest invocations fitting in `ARG_MAX`. All the invocations form a
+ * single job, whose status combines theirs
+ *
+ * `batch [-j N] cmd [args...] [-- items...]` : without `--`, every argument
+ * after `cmd` is an item
+ *
+ * @param args : command arguments
+ */
+int batch(char **args) {
+  size_t jobs = 1;
+  size_t i = 1;
+  if (args[i] != NULL && strcmp(args[i], "-j") == 0) {
+    char *end = NULL;
+    long n = args[i + 1] == NULL ? 0 : strtol(args[i + 1], &end, 10);
+    if (n <= 0 || *end != '\0') {
+      fprintf(stderr, "jsh: batch: -j: positive number expected\n");
+      return 2;
+    }
+    jobs = (size_t)n;
+    i += 2;
+  }
+  if (args[i] == NULL) {
+    fprintf(stderr,
+            "jsh: batch: usage: batch [-j N] cmd [args...] [-- items...]\n");
+    return 2;
+  }
+
+  char **fixed = args + i;
+  size_t nb_fixed = 1;
+  while (fixed[nb_fixed] != NULL && strcmp(fixed[nb_fixed], "--") != 0)
+    nb_fixed++;
+  char **items = fixed + nb_fixed + 1;
+  if (fixed[nb_fixed] == NULL) {
+    items = fixed + 1;
+    nb_fixed = 1;
+  }
+  Batches batches = {fixed, nb_fixed, items, NULL, 0, jobs};
+  batches.ends = split_batches(fixed, nb_fixed, items, &batches.nb_batches);
+  if (batches.ends == NULL)
+    return EXIT_FAILURE;
+  int status = run_job(args, run_batches, &batches);
+  free(batches.ends);
+  return status;
+}
@@ -0,0 +1,183 @@
+#include "../head/jsh.h"
+
+#include "../head/jsh_board.h"
+#include "../head/libjsh.h"
+
+#include <sys/mman.h>
+#include <time.h>
+
+/*
+ * Job board of `JSH_BOARD=file` (see jsh_board.h) : after each change of the
+ * job table, the shell copies it into `file`, mapped shared, under a
+ * sequence lock. The jobs ended recently follow the jobs of the shell, so
+ * that a monitor polling the board still sees how they ended.
+ */
+
+#define ENDED_JOBS 16
+
+static jsh_board *board = NULL;
+static char *board_path = NULL;
+static pid_t board_owner;
+// last jobs ended, `ended[next_ended - 1]` being the last one
+static jsh_board_job ended[ENDED_JOBS];
+static size_t next_ended = 0;
+static size_t nb_ended = 0;
+
+_Static_assert(JSH_JOB_RUNNING == 0 && JSH_JOB_STOPPED == 1 &&
+                   JSH_JOB_DONE == 2 && JSH_JOB_KILLED == 3 &&
+                   JSH_JOB_DETACHED == 4,
+               "the states of jsh_board.h are the ones of libjsh.h");
+
+static int64_t microseconds(struct timeval time) {
+  return (int64_t)time.tv_sec * 1000000 + time.tv_usec;
+}
+
+static int64_t now_us(void) {
+  struct timespec now;
+  clock_gettime(CLOCK_REALTIME, &now);
+  return (int64_t)now.tv_sec * 1000000 + now.tv_nsec / 1000;
+}
+
+/**
+ * Sets the entry of the board describing `job`
+ */
+static void fill_entry(const job_t *job, jsh_board_job *entry) {
+  memset(entry, 0, sizeof(*entry));
+  entry->id = job->age;
+  entry->pgid = job->pid;
+  entry->state = (int32_t)job->state;
+  entry->start_us =
+      (int64_t)job->start.tv_sec * 1000000 + job->start.tv_nsec / 1000;
+  entry->utime_us = microseconds(job->usage.ru_utime);
+  entry->stime_us = microseconds(job->usage.ru_stime);
+  entry->maxrss_kb = job->usage.ru_maxrss;
+  strncpy(entry->command, job->command, JSH_BOARD_COMMAND - 1);
+}
+
+/**
+ * Copies the job table to the board, if any. The caller holds the lock of
+ * the jobs
+ */
+void publish_jobs(void) {
+  if (board == NULL || getpid() != board_owner)
+    return;
+  uint64_t seq = __atomic_load_n(&board->seq, __ATOMIC_RELAXED);
+  __atomic_store_n(&board->seq, seq + 1, __ATOMIC_RELAXED);
+  __atomic_thread_fence(__ATOMIC_RELEASE);
+
+  uint32_t n = 0;
+  for (job_t *job = shell->job_list; job != NULL && n < JSH_BOARD_JOBS;
+       job = job->next)
+    fill_entry(job, &board->jobs[n++]);
+  board->nb_live = n;
+  for (size_t i = 1; i <= nb_ended && n < JSH_BOARD_JOBS; i++)
+    board->jobs[n++] = ended[(next_ended + ENDED_JOBS - i) % ENDED_JOBS];
+  board->nb_jobs = n;
+  board->update_us = now_us();
+
+  __atomic_store_n(&board->seq, seq + 2, __ATOMIC_RELEASE);
+}
+
+/**
+ * Keeps the final state of a job leaving the job table for the board. The
+ * caller holds the lock of the jobs
+ */
+void board_ended(const job_t *job) {
+  if (board == NULL || getpid() != board_owner)
+    return;
+  jsh_board_job *entry = &ended[next_ended];
+  fill_entry(job, entry);
+  entry->end_us = now_us();
+  next_ended = (next_ended + 1) % ENDED_JOBS;
+  if (nb_ended < ENDED_JOBS)
+    nb_ended++;
+}
+
+/**
+ * Removes the board when the shell exits
+ */
+static void remove_board(void) {
+  if (board != NULL && getpid() == board_owner)
+    unlink(board_path);
+}
+
+/**
+ * Publishes the job table in the file `path`, created or replaced
+ *
+ * @return `0` on success, `-1` on error
+ */
+int start_board(const char *path) {
+  if (board != NULL)
+    return 0;
+  board_path = strdup(path);
+  if (board_path == NULL)
+    return -1;
+  int fd = open(path, O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+  if (fd == -1 || ftruncate(fd, sizeof(jsh_board)) == -1) {
+    int error = errno;
+    if (fd != -1)
+      close(fd);
+    free(board_path);
+    board_path = NULL;
+    errno = error;
+    return -1;
+  }
+  jsh_board *mapped = mmap(NULL, sizeof(jsh_board), PROT_READ | PROT_WRITE,
+                           MAP_SHARED, fd, 0);
+  close(fd);
+  if (mapped == MAP_FAILED) {
+    free(board_path);
+    board_path = NULL;
+    return -1;
+  }
+  board_owner = getpid();
+  mapped->version = JSH_BOARD_VERSION;
+  mapped->size = sizeof(jsh_board);
+  mapped->pid = board_owner;
+  mapped->update_us = now_us();
+  // readers check the magic number first
+  __atomic_store_n(&mapped->magic, JSH_BOARD_MAGIC, __ATOMIC_RELEASE);
+  board = mapped;
+  atexit(remove_board);
+  return 0;
+}
+
+/**
+ * Prints the jobs as a JSON array, one object per job with the fields of the
+ * entries of the board. The array is built in memory, then written at once
+ *
+ * @param fdout : file descriptor to print to
+ * @return `0` on success, `-1` on allocation error
+ */
+int print_jobs_json(int fdout) {
+  static const char *states[] = {"running", "stopped", "done", "killed",
+                                 "detached"};
+  char *text;
+  size_t size;
+  FILE *out = open_memstream(&text, &size);
+  if (out == NULL)
+    return -1;
+  lock_jobs();
+  fputc('[', out);
+  for (job_t *job = shell->job_list; job != NULL; job = job->next) {
+    jsh_board_job entry;
+    fill_entry(job, &entry);
+    fprintf(out, "%s\n  {\"id\": %d, \"pgid\": %d, \"state\": \"%s\", "
+                 "\"command\": ",
+            job == shell->job_list ? "" : ",", entry.id, entry.pgid,
+            states[entry.state]);
+    write_json_string(out, job->command);
+    fprintf(out,
+            ", \"start_us\": %lld, \"utime_us\": %lld, \"stime_us\": %lld, "
+            "\"maxrss_kb\": %lld}",
+            (long long)entry.start_us, (long long)entry.utime_us,
+            (long long)entry.stime_us, (long long)entry.maxrss_kb);
+  }
+  fprintf(out, "%s]\n", shell->job_list == NULL ? "" : "\n");
+  unlock_jobs();
+  if (fclose(out) == EOF)
+    return -1;
+  dprintf(fdout, "%s", text);
+  free(text);
+  return 0;
+}
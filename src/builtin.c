@@ -1,164 +1,90 @@
 #include "../head/jsh.h"
 
-// Fonction pour changer le répertoire de travail
+#include <sys/sendfile.h>
 
-void cd(char **args) {
-
-  char buffer[PATH_MAX];
-
-  // Vérifie le nombre d'arguments
-  if (args[1] != NULL && args[2] != NULL) {
-    usleep(1000);
-    fprintf(stderr, "cd : trop d'arguments\n");
-    last_exit_code = EXIT_FAILURE;
-    return;
-  }
-
-  // Variables pour le nouveau répertoire et le chemin résolu
-  char *new_directory;
-  char resolved_path[PATH_MAX];
-
-  // Cas où aucun argument n'est fourni
-  if (args[1] == NULL) {
-    char *home_directory = getenv("HOME");
-    if (home_directory == NULL) {
-      fprintf(stderr,
-              "cd : la variable d'environnement $HOME n'est pas définie\n");
-      last_exit_code = EXIT_FAILURE;
-      return;
-    }
-    new_directory = home_directory;
-  }
-  // Cas où l'argument est "-"
-  else if (strcmp(args[1], "-") == 0) {
-    char *old_directory = getenv("OLDPWD");
-    if (old_directory == NULL) {
-      fprintf(stderr,
-              "cd : la variable d'environnement $OLDPWD n'est pas définie\n");
-      last_exit_code = EXIT_FAILURE;
-      return;
-    }
-    new_directory = old_directory;
-  }
-  // Cas où un chemin est spécifié
-  else {
-    // Résout le chemin absolu
-    if (realpath(args[1], resolved_path) == NULL) {
-      usleep(1000);
-      perror("cd");
-      last_exit_code = EXIT_FAILURE;
-      return;
-    }
-
-    new_directory = resolved_path;
-
-    // Vérifie si le chemin existe
-    if (access(new_directory, F_OK) != 0) {
-      usleep(1000);
-      fprintf(stderr, "cd : chemin non existant\n ");
-      last_exit_code = EXIT_FAILURE;
-      return;
-    }
-  }
-
-  // Enregistre l'ancien répertoire de travail
-  char *old_directory = getcwd(buffer, sizeof(buffer));
-
-  // Change le répertoire de travail
-  if (chdir(new_directory) != 0) {
-    usleep(1000);
-    perror("cd");
-    last_exit_code = EXIT_FAILURE;
-
-  } else {
-    // Met à jour les variables d'environnement $PWD et $OLDPWD
-    setenv("OLDPWD", old_directory, 1);
-    char *actual_directory = getcwd(buffer, sizeof(buffer));
-    setenv("PWD", actual_directory, 1);
-    last_exit_code = EXIT_SUCCESS;
-  }
-}
-
-void jexit(char **args) {
-  if (job_list != NULL && run != 2) {
+int jexit(char **args) {
+  if (shell->job_list != NULL && shell->run != 2) {
     // If there are jobs in progress, display a warning message
     fprintf(
         stderr,
         "jsh: There are jobs in progress. Use 'exit' again to terminate.\n");
-    last_exit_code = EXIT_FAILURE;
-    run = 2;
-  } else {
-    // No jobs in progress, proceed with exit
-    if (args[1] != NULL) {
-      last_exit_code = atoi(args[1]);
-    }
-    run = 0;
+    shell->run = 2;
+    return EXIT_FAILURE;
   }
+  // No jobs in progress, proceed with exit
+  shell->run = 0;
+  return args[1] != NULL ? atoi(args[1]) : last_exit_code;
 }
 
-void pwd() {
-  char *cwd = malloc(sizeof(char) * 256);
-  if (!cwd) {
-    fprintf(stderr, "jsh: allocation error\n");
-    last_exit_code = EXIT_FAILURE;
-  }
-  if (getcwd(cwd, sizeof(char) * 256) != NULL) {
-    fprintf(stdout, "%s\n", cwd);
-  } else {
-    perror("pwd failed");
-    last_exit_code = EXIT_FAILURE;
-  }
-  free(cwd);
-  last_exit_code = EXIT_SUCCESS;
+int question_mark(char **args) {
+  (void)args;
+  dprintf(builtin_stdout, "%d\n", last_exit_code);
+  return EXIT_SUCCESS;
 }
 
-void question_mark() {
-  printf("%d\n", last_exit_code);
-  last_exit_code = EXIT_SUCCESS;
-}
-
-void jobs(char **args) {
+int jobs(char **args) {
   // If no arguments are provided, list all jobs
   if (args[1] == NULL) {
-    check_jobs(1, STDOUT_FILENO);
-    last_exit_code = EXIT_SUCCESS;
-    return;
+    check_jobs(1, builtin_stdout);
+    return EXIT_SUCCESS;
   }
 
   // If the -t option is provided
   if (strcmp(args[1], "-t") == 0) {
-    for (job_t *job = job_list; job != NULL; job = job->next) {
-      print_job_details(job, STDOUT_FILENO);
-      print_process_tree(job->pid, STDOUT_FILENO, 1);
+    lock_jobs();
+    for (job_t *job = shell->job_list; job != NULL; job = job->next) {
+      print_job_details(job, builtin_stdout);
+      print_process_tree(job->pid, builtin_stdout, 1);
+    }
+    unlock_jobs();
+    return EXIT_SUCCESS;
+  }
+  // If the --json option is provided, for scripts
+  if (strcmp(args[1], "--json") == 0 && args[2] == NULL) {
+    // the changes are reported on the standard error, out of the JSON
+    check_jobs(0, STDERR_FILENO);
+    if (print_jobs_json(builtin_stdout)) {
+      fprintf(stderr, "jsh: allocation error\n");
+      return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+  }
+
+  // If the -l option is provided, with the hardware counters of the jobs
+  if (strcmp(args[1], "-l") == 0 && args[2] == NULL) {
+    check_jobs(0, builtin_stdout);
+    lock_jobs();
+    for (job_t *job = shell->job_list; job != NULL; job = job->next) {
+      print_job_details(job, builtin_stdout);
+      print_perf_counters(job->perf, builtin_stdout);
     }
-    last_exit_code = EXIT_SUCCESS;
-    return;
+    unlock_jobs();
+    return EXIT_SUCCESS;
   }
   // If there are too many arguments
   fprintf(stderr, "jobs: too many arguments\n");
-  last_exit_code = EXIT_FAILURE;
-  return;
+  return EXIT_FAILURE;
 }
 
 
-void fg(char **args) {
+int fg(char **args) {
   // If no arguments are provided
   errno = 0;
   int age;
   if (args[1] == NULL || args[2] != NULL ||
       (age = is_Number((*args[1] == '%') ? args[1] + 1 : args[1])) <= 0 ||
-      errno != 0 || age >= idjob) {
+      errno != 0 || age >= shell->idjob) {
     fprintf(stderr, "fg: invalid arguments\n");
-    last_exit_code = EXIT_FAILURE;
-    return;
+    return EXIT_FAILURE;
   }
 
   // Find the job with the given job number
   job_t *job;
-  for (job = job_list; job->age != age; job = job->next)
+  for (job = shell->job_list; job->age != age; job = job->next)
     ;
 
   // Send the SIGCONT signal to the job
+  TRACE(TRACE_TERMINAL, job->pid, job->pid, NULL);
   tcsetpgrp(STDIN_FILENO, job->pid);
   tcsetpgrp(STDOUT_FILENO, job->pid);
   tcsetpgrp(STDERR_FILENO, job->pid);
@@ -166,70 +92,65 @@ void fg(char **args) {
 
   // Wait for the job to finish
   int status;
-  do {
-    waitpid(job->pid, &status, WUNTRACED);
-  } while (!WIFEXITED(status) && !WIFSIGNALED(status) && !WIFSTOPPED(status));
+  wait_leader(job->pid, &status, &job->usage, 1);
 
+  TRACE(TRACE_TERMINAL, getpid(), getpid(), NULL);
   tcsetpgrp(STDIN_FILENO, getpid());
   tcsetpgrp(STDOUT_FILENO, getpid());
   tcsetpgrp(STDERR_FILENO, getpid());
   if (WIFSTOPPED(status)) {
     // Update the job state
-    job->state = STOPPED;
+    update_job(job->pid, STOPPED);
     print_job_details(job, STDERR_FILENO);
-    last_exit_code = 128 + WSTOPSIG(status);
-    return;
+    return 128 + WSTOPSIG(status);
   }
 
-  if (WIFSIGNALED(status))
-    last_exit_code = 128 + WTERMSIG(status);
-  else
-    last_exit_code = WEXITSTATUS(status);
-
   // Update the job list
+  job->state = WIFSIGNALED(status) ? KILLED : DONE;
   remove_job(job->pid);
+  return WIFSIGNALED(status) ? 128 + WTERMSIG(status) : WEXITSTATUS(status);
 }
 
-void bg(char **args) {
+int bg(char **args) {
   errno = 0;
   int age;
   if (args[1] == NULL || args[2] != NULL ||
       (age = is_Number((*args[1] == '%') ? args[1] + 1 : args[1])) <= 0 ||
-      errno != 0 || age >= idjob) {
+      errno != 0 || age >= shell->idjob) {
     fprintf(stderr, "bg: invalid arguments\n");
-    last_exit_code = EXIT_FAILURE;
-    return;
+    return EXIT_FAILURE;
   }
   // Find the job with the given job number
   job_t *job;
-  for (job = job_list; job->age != age; job = job->next)
+  for (job = shell->job_list; job->age != age; job = job->next)
     ;
 
   // Send the SIGCONT signal to the job
   kill(job->pid, SIGCONT);
 
   // Update the job state
-  job->state = RUNNING;
-  last_exit_code = EXIT_SUCCESS;
+  update_job(job->pid, RUNNING);
+  return EXIT_SUCCESS;
 }
 
 /**
  * Sends a signal to a process or a job
  * @param sig : signal number
  * @param target : process ID or job number
+ * @return the exit code of `kill`
  */
-void send_signal(int sig, char *target) {
+int send_signal(int sig, char *target) {
   pid_t pid;
   // case of job id
   if (*target == '%') {
     int age = is_Number(target + 1);
-    if (age <= 0 || age >= idjob) {
+    if (age <= 0 || age >= shell->idjob) {
       fprintf(stderr, "kill: %s : no such job\n", target);
-      goto exit;
+      return EXIT_FAILURE;
     }
     // find the job with the given job number
     job_t *job_target;
-    for (job_target = job_list; job_target->age != age;
+    for (job_target = shell->job_list; job_target->age != age;
          job_target = job_target->next)
       ;
     pid = job_target->pid;
@@ -242,27 +163,24 @@ void send_signal(int sig, char *target) {
           stderr,
           "kill: %s : argument must be an identifier of task or processus\n",
           target);
-      goto exit;
+      return EXIT_FAILURE;
     }
   }
   if (!killpg(pid, sig)) {
     check_state(pid, sig);
-    last_exit_code = EXIT_SUCCESS;
-    return;
+    return EXIT_SUCCESS;
   }
   switch (errno) {
   case EPERM:
     fprintf(stderr, "kill: (%s) - operation not permitted\n", target);
-    goto exit;
+    break;
   case ESRCH:
     fprintf(stderr, "kill: (%s) - no such process\n", target);
-    goto exit;
+    break;
   default:
     fprintf(stderr, "kill: an error occured\n");
-    goto exit;
   }
-exit:
-  last_exit_code = EXIT_FAILURE;
+  return EXIT_FAILURE;
 }
 
 /**
@@ -272,7 +190,7 @@ exit:
  */
 void check_state(pid_t pid, int sig) {
   int state;
-  waitpid(pid, &state, WNOHANG | WUNTRACED | WCONTINUED);
+  jsh_waitpid(pid, &state, WNOHANG | WUNTRACED | WCONTINUED);
   if (WIFSTOPPED(state) && sig != SIGSTOP && sig != SIGTTIN && sig != SIGTTOU &&
       sig != SIGTSTP)
     kill(pid, SIGCONT);
@@ -282,7 +200,7 @@ void check_state(pid_t pid, int sig) {
  * Kills a job
  * @param args : arguments of the command
  */
-void kill_job(char **args) {
+int kill_job(char **args) {
   if (args[1] == NULL || args[2] != NULL && args[3] != NULL)
     goto error_args;
   int sig = 15;
@@ -293,20 +211,17 @@ void kill_job(char **args) {
     sig = is_Number(args[1] + 1);
     if (sig < 0 || sig > 64) {
       fprintf(stderr, "kill: %s : invalid signal specification\n", args[1] + 1);
-      goto exit;
+      return EXIT_FAILURE;
     }
-    send_signal(sig, args[2]);
-    return;
+    return send_signal(sig, args[2]);
   }
   if (args[2] != NULL)
     goto error_args;
-  send_signal(sig, args[1]);
-  return;
+  return send_signal(sig, args[1]);
 error_args:
   fprintf(stderr, "kill: incorrect arguments , try 'kill [-sig] pid' or 'kill "
                   "[-sig] %%job'\n");
-exit:
-  last_exit_code = EXIT_FAILURE;
+  return EXIT_FAILURE;
 }
 
 /**
@@ -326,4 +241,208 @@ int is_Number(const char *str) {
     }
   }
   return atoi(str);
-}
\ No newline at end of file
+}
+
+#define COPY_CHUNK (1 << 30)
+#define COPY_BUFFER_SIZE (128 * 1024)
+
+/**
+ * Copies everything readable from `in` to `out` without going through user
+ * space when the kernel allows it: `copy_file_range()` between two regular
+ * files, `splice()` when one of them is a pipe, `sendfile()` from a regular
+ * file to anything else, and `read()`/`write()` otherwise
+ * @param in : file descriptor to read from
+ * @param out : file descriptor to write to
+ * @return `0` on success, `-1` on error and errno is set appropriately
+ */
+int copy_fd(int in, int out) {
+  struct stat st_in, st_out;
+  ssize_t n;
+  if (fstat(in, &st_in) == -1 || fstat(out, &st_out) == -1)
+    return -1;
+
+  if (S_ISREG(st_in.st_mode) && S_ISREG(st_out.st_mode)) {
+    while ((n = copy_file_range(in, NULL, out, NULL, COPY_CHUNK, 0)) > 0)
+      ;
+    if (n == 0)
+      return 0;
+    if (errno != EXDEV && errno != EINVAL && errno != ENOSYS &&
+        errno != EOPNOTSUPP)
+      return -1;
+  } else if (S_ISFIFO(st_in.st_mode) || S_ISFIFO(st_out.st_mode)) {
+    while ((n = splice(in, NULL, out, NULL, COPY_CHUNK, SPLICE_F_MOVE)) > 0)
+      ;
+    if (n == 0)
+      return 0;
+    if (errno != EINVAL)
+      return -1;
+  } else if (S_ISREG(st_in.st_mode)) {
+    while ((n = sendfile(out, in, NULL, COPY_CHUNK)) > 0)
+      ;
+    if (n == 0)
+      return 0;
+    if (errno != EINVAL && errno != ENOSYS)
+      return -1;
+  }
+
+  // fallback when the descriptors do not support zero-copy transfers
+  char buffer[COPY_BUFFER_SIZE];
+  while ((n = read(in, buffer, sizeof(buffer))) > 0) {
+    for (ssize_t written = 0, w; written < n; written += w) {
+      if ((w = write(out, buffer + written, (size_t)(n - written))) == -1)
+        return -1;
+    }
+  }
+  return (int)n;
+}
+
+/**
+ * `cat [-u] [file...]` used as a stage of a pipeline or of a background job.
+ * Unsupported options are delegated to the external `cat`
+ * @param args : arguments of the command
+ */
+int jcat(char **args) {
+  for (size_t i = 1; args[i] != NULL; i++) {
+    if (*args[i] == '-' && strcmp(args[i], "-") && strcmp(args[i], "-u"))
+      execute_program(args);
+  }
+
+  int status = EXIT_SUCCESS;
+  int files = 0;
+  for (size_t i = 1; args[i] != NULL; i++) {
+    if (strcmp(args[i], "-u") == 0)
+      continue;
+    files++;
+    int fd = STDIN_FILENO;
+    if (strcmp(args[i], "-") && (fd = open(args[i], O_RDONLY | O_CLOEXEC)) == -1) {
+      fprintf(stderr, "cat: %s: %s\n", args[i], strerror(errno));
+      status = EXIT_FAILURE;
+      continue;
+    }
+    if (copy_fd(fd, STDOUT_FILENO) == -1) {
+      fprintf(stderr, "cat: %s: %s\n", args[i], strerror(errno));
+      status = EXIT_FAILURE;
+    }
+    if (fd != STDIN_FILENO)
+      close(fd);
+  }
+  if (!files && copy_fd(STDIN_FILENO, STDOUT_FILENO) == -1) {
+    fprintf(stderr, "cat: %s\n", strerror(errno));
+    status = EXIT_FAILURE;
+  }
+  return status;
+}
+
+/**
+ * Duplicates stdin into stdout and `fd` when the three are suitable for
+ * `tee()` and `splice()` : stdin and stdout are pipes and `fd` is a regular
+ * file not opened in append mode
+ * @param fd : file descriptor of the only file given to `tee`
+ * @return `0` on success, `1` if the generic copy has to be used, `-1` on
+ * error
+ */
+static int tee_splice(int fd) {
+  ssize_t n, moved;
+  while ((n = tee(STDIN_FILENO, STDOUT_FILENO, COPY_CHUNK, 0)) > 0) {
+    for (; n > 0; n -= moved) {
+      moved = splice(STDIN_FILENO, NULL, fd, NULL, (size_t)n, SPLICE_F_MOVE);
+      if (moved <= 0)
+        return -1;
+    }
+  }
+  if (n == -1 && errno == EINVAL)
+    return 1;
+  return (int)n;
+}
+
+/**
+ * `tee [-a] [-i] [file...]` used as a stage of a pipeline or of a background
+ * job. Unsupported options are delegated to the external `tee`
+ * @param args : arguments of the command
+ */
+int jtee(char **args) {
+  int status = EXIT_SUCCESS;
+  int append = 0;
+  size_t first = 1;
+  for (; args[first] != NULL && *args[first] == '-' && args[first][1]; first++) {
+    if (strcmp(args[first], "-a") == 0)
+      append = 1;
+    else if (strcmp(args[first], "-i") == 0)
+      signal(SIGINT, SIG_IGN);
+    else
+      execute_program(args);
+  }
+
+  size_t nb_fds = 1;
+  int *fds = malloc(sizeof(int) * (nb_fds + 1));
+  for (size_t i = first; fds != NULL && args[i] != NULL; i++) {
+    int *tmp = realloc(fds, sizeof(int) * (nb_fds + 2));
+    if (tmp == NULL) {
+      free(fds);
+      fds = NULL;
+      break;
+    }
+    fds = tmp;
+    int fd = open(args[i], O_WRONLY | O_CREAT | O_CLOEXEC |
+                               (append ? O_APPEND : O_TRUNC), 0666);
+    if (fd == -1) {
+      fprintf(stderr, "tee: %s: %s\n", args[i], strerror(errno));
+      status = EXIT_FAILURE;
+      continue;
+    }
+    fds[nb_fds++] = fd;
+  }
+  if (fds == NULL) {
+    fprintf(stderr, "jsh: allocation error\n");
+    return EXIT_FAILURE;
+  }
+  fds[0] = STDOUT_FILENO;
+
+  int res = 1;
+  struct stat st_in, st_out, st_file;
+  if (nb_fds == 1)
+    res = copy_fd(STDIN_FILENO, STDOUT_FILENO);
+  else if (nb_fds == 2 && !append && fstat(STDIN_FILENO, &st_in) == 0 &&
+           fstat(STDOUT_FILENO, &st_out) == 0 && fstat(fds[1], &st_file) == 0 &&
+           S_ISFIFO(st_in.st_mode) && S_ISFIFO(st_out.st_mode) &&
+           S_ISREG(st_file.st_mode))
+    res = tee_splice(fds[1]);
+
+  if (res == 1) {
+    char buffer[COPY_BUFFER_SIZE];
+    ssize_t n;
+    int error = 0;
+    // a file whose write failed is left out of the next blocks, the copy
+    // stops when it is the standard output
+    while (fds[0] != -1 &&
+           (n = read(STDIN_FILENO, buffer, sizeof(buffer))) > 0) {
+      for (size_t i = 0; i < nb_fds && fds[0] != -1; i++) {
+        for (ssize_t written = 0, w; fds[i] != -1 && written < n;
+             written += w) {
+          if ((w = write(fds[i], buffer + written, (size_t)(n - written))) ==
+              -1) {
+            error = errno;
+            if (i > 0)
+              close(fds[i]);
+            fds[i] = -1;
+          }
+        }
+      }
+    }
+    if (fds[0] != -1 && n == -1)
+      error = errno;
+    res = error != 0 ? -1 : 0;
+    errno = error;
+  }
+  if (res == -1) {
+    fprintf(stderr, "tee: %s\n", strerror(errno));
+    status = EXIT_FAILURE;
+  }
+
+  for (size_t i = 1; i < nb_fds; i++) {
+    if (fds[i] != -1)
+      close(fds[i]);
+  }
+  free(fds);
+  return status;
+}
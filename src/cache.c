@@ -0,0 +1,679 @@
+#include "../head/jsh.h"
+
+#include <poll.h>
+#include <time.h>
+
+// bound of the size of the outputs kept, without `JSH_CACHE_SIZE`
+#define CACHE_DEFAULT_SIZE (256L << 20)
+
+#define CACHE_VERSION 1
+
+// the temporary files of the misses start with this prefix
+#define CACHE_TMP "tmp."
+
+// temporary files older than this are left by an interrupted miss
+#define CACHE_TMP_AGE 3600
+
+typedef struct {
+  uint32_t state[8];
+  uint64_t length;
+  unsigned char block[64];
+  size_t used;
+} Sha256;
+
+typedef struct {
+  char **command;
+  char **inputs;
+  size_t nb_inputs;
+  char **env;
+  size_t nb_env;
+  long ttl; // `-1` without `--ttl`
+} Cache;
+
+// output of a command, stored as it is printed
+typedef struct {
+  int pipe;    // read end of the pipe of the command, `-1` once ended
+  int out;     // descriptor of the shell receiving the output
+  int tmp;     // temporary file of the store
+  char name[32];
+  Sha256 sha;
+} Output;
+
+// state of a miss, run by `run_job()`
+typedef struct {
+  Cache *cache;
+  int store;
+  char key[65];
+  int out; // standard output of the built-in
+} Miss;
+
+typedef struct {
+  char name[65];
+  long long used; // last hit, or creation, in nanoseconds
+  char objects[2][65];
+} Entry;
+
+typedef struct {
+  char name[65];
+  off_t size;
+  int kept;
+} Object;
+
+static const uint32_t sha256_k[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1,
+    0x923f82a4, 0xab1c5ed5, 0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3,
+    0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174, 0xe49b69c1, 0xefbe4786,
+    0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147,
+    0x06ca6351, 0x14292967, 0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13,
+    0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85, 0xa2bfe8a1, 0xa81a664b,
+    0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a,
+    0x5b9cca4f, 0x682e6ff3, 0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208,
+    0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2};
+
+static uint32_t rotate(uint32_t x, int n) { return x >> n | x << (32 - n); }
+
+static void sha256_init(Sha256 *sha) {
+  static const uint32_t initial[8] = {0x6a09e667, 0xbb67ae85, 0x3c6ef372,
+                                      0xa54ff53a, 0x510e527f, 0x9b05688c,
+                                      0x1f83d9ab, 0x5be0cd19};
+  memcpy(sha->state, initial, sizeof(initial));
+  sha->length = 0;
+  sha->used = 0;
+}
+
+/**
+ * Compresses the full block of `sha`
+ */
+static void sha256_block(Sha256 *sha) {
+  uint32_t w[64];
+  for (int i = 0; i < 16; i++)
+    w[i] = (uint32_t)sha->block[4 * i] << 24 |
+           (uint32_t)sha->block[4 * i + 1] << 16 |
+           (uint32_t)sha->block[4 * i + 2] << 8 | sha->block[4 * i + 3];
+  for (int i = 16; i < 64; i++) {
+    uint32_t s0 = rotate(w[i - 15], 7) ^ rotate(w[i - 15], 18) ^ w[i - 15] >> 3;
+    uint32_t s1 = rotate(w[i - 2], 17) ^ rotate(w[i - 2], 19) ^ w[i - 2] >> 10;
+    w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+  }
+  uint32_t v[8];
+  memcpy(v, sha->state, sizeof(v));
+  for (int i = 0; i < 64; i++) {
+    uint32_t s1 = rotate(v[4], 6) ^ rotate(v[4], 11) ^ rotate(v[4], 25);
+    uint32_t ch = (v[4] & v[5]) ^ (~v[4] & v[6]);
+    uint32_t t1 = v[7] + s1 + ch + sha256_k[i] + w[i];
+    uint32_t s0 = rotate(v[0], 2) ^ rotate(v[0], 13) ^ rotate(v[0], 22);
+    uint32_t maj = (v[0] & v[1]) ^ (v[0] & v[2]) ^ (v[1] & v[2]);
+    memmove(v + 1, v, 7 * sizeof(uint32_t));
+    v[4] += t1;
+    v[0] = t1 + s0 + maj;
+  }
+  for (int i = 0; i < 8; i++)
+    sha->state[i] += v[i];
+}
+
+static void sha256_update(Sha256 *sha, const void *data, size_t size) {
+  const unsigned char *bytes = data;
+  sha->length += size;
+  while (size > 0) {
+    size_t n = 64 - sha->used < size ? 64 - sha->used : size;
+    memcpy(sha->block + sha->used, bytes, n);
+    sha->used += n;
+    bytes += n;
+    size -= n;
+    if (sha->used == 64) {
+      sha256_block(sha);
+      sha->used = 0;
+    }
+  }
+}
+
+/**
+ * Ends the hash and writes it in hexadecimal to `hex`
+ */
+static void sha256_final(Sha256 *sha, char hex[65]) {
+  uint64_t bits = sha->length * 8;
+  unsigned char pad = 0x80;
+  sha256_update(sha, &pad, 1);
+  pad = 0;
+  while (sha->used != 56)
+    sha256_update(sha, &pad, 1);
+  unsigned char length[8];
+  for (int i = 0; i < 8; i++)
+    length[i] = (unsigned char)(bits >> (56 - 8 * i));
+  sha256_update(sha, length, 8);
+  for (int i = 0; i < 8; i++)
+    sprintf(hex + 8 * i, "%08x", sha->state[i]);
+}
+
+/**
+ * Adds the string `s` and its `\0` to the hash
+ */
+static void sha256_string(Sha256 *sha, const char *s) {
+  sha256_update(sha, s, strlen(s) + 1);
+}
+
+/**
+ * Returns `1` if `name` is a hash written by `sha256_final()`
+ */
+static int is_hash(const char *name) {
+  size_t i = 0;
+  while (i < 64 && (isdigit(name[i]) || (name[i] >= 'a' && name[i] <= 'f')))
+    i++;
+  return i == 64 && name[i] == '\0';
+}
+
+/**
+ * Opens the store, `$JSH_CACHE_DIR` or `~/.cache/jsh`, creating it if needed
+ *
+ * @return a descriptor of its directory, `-1` on error with a message
+ */
+static int open_store(void) {
+  char path[PATH_MAX];
+  const char *dir = get_variable("JSH_CACHE_DIR");
+  const char *xdg = get_variable("XDG_CACHE_HOME");
+  const char *home = get_variable("HOME");
+  if (dir != NULL && *dir != '\0')
+    snprintf(path, sizeof(path), "%s", dir);
+  else if (xdg != NULL && *xdg != '\0')
+    snprintf(path, sizeof(path), "%s/jsh", xdg);
+  else if (home != NULL)
+    snprintf(path, sizeof(path), "%s/.cache/jsh", home);
+  else {
+    fprintf(stderr, "jsh: cache: no store : set JSH_CACHE_DIR\n");
+    return -1;
+  }
+  int store = open(path, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+  if (store == -1 && errno == ENOENT) {
+    // creates the missing parents
+    for (char *slash = strchr(path + 1, '/'); slash != NULL;
+         slash = strchr(slash + 1, '/')) {
+      *slash = '\0';
+      mkdir(path, 0700);
+      *slash = '/';
+    }
+    mkdir(path, 0700);
+    store = open(path, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+  }
+  if (store == -1)
+    fprintf(stderr, "jsh: cache: %s: %s\n", path, strerror(errno));
+  return store;
+}
+
+/**
+ * Computes the key of a command : its words, the current directory, the
+ * variables selected by `--env` and the size and modification time of the
+ * files of `--inputs`
+ */
+static void compute_key(Cache *cache, char key[65]) {
+  Sha256 sha;
+  char buffer[PATH_MAX + 64];
+  sha256_init(&sha);
+  snprintf(buffer, sizeof(buffer), "jsh-cache %d", CACHE_VERSION);
+  sha256_string(&sha, buffer);
+  if (getcwd(buffer, sizeof(buffer)) == NULL)
+    buffer[0] = '\0';
+  sha256_string(&sha, buffer);
+  for (size_t i = 0; cache->command[i] != NULL; i++)
+    sha256_string(&sha, cache->command[i]);
+  sha256_string(&sha, "--env");
+  for (size_t i = 0; i < cache->nb_env; i++) {
+    const char *value = get_variable(cache->env[i]);
+    sha256_string(&sha, cache->env[i]);
+    // an unset variable differs from an empty one
+    sha256_string(&sha, value != NULL ? value : "\1unset");
+  }
+  sha256_string(&sha, "--inputs");
+  for (size_t i = 0; i < cache->nb_inputs; i++) {
+    struct stat st;
+    sha256_string(&sha, cache->inputs[i]);
+    if (stat(cache->inputs[i], &st) == -1)
+      snprintf(buffer, sizeof(buffer), "missing");
+    else
+      snprintf(buffer, sizeof(buffer), "%lld %lld.%09ld %llu",
+               (long long)st.st_size, (long long)st.st_mtim.tv_sec,
+               st.st_mtim.tv_nsec, (unsigned long long)st.st_ino);
+    sha256_string(&sha, buffer);
+  }
+  sha256_final(&sha, key);
+}
+
+/**
+ * Reads the entry `entries/<name>` : its exit code, creation time and the
+ * names of its outputs
+ *
+ * @return `0` on success, `-1` if the entry is missing or invalid
+ */
+static int read_entry(int store, const char *name, int *status,
+                      long long *created, char objects[2][65]) {
+  char path[80];
+  snprintf(path, sizeof(path), "entries/%.64s", name);
+  int fd = openat(store, path, O_RDONLY | O_CLOEXEC);
+  if (fd == -1)
+    return -1;
+  char buffer[512];
+  ssize_t n = read(fd, buffer, sizeof(buffer) - 1);
+  close(fd);
+  if (n <= 0)
+    return -1;
+  buffer[n] = '\0';
+  int version;
+  if (sscanf(buffer, "jsh-cache %d\nstatus %d\ncreated %lld\nstdout %64s\n"
+                     "stderr %64s\n",
+             &version, status, created, objects[0], objects[1]) != 5 ||
+      version != CACHE_VERSION || !is_hash(objects[0]) || !is_hash(objects[1]))
+    return -1;
+  return 0;
+}
+
+/**
+ * Replays a stored result : its outputs, without copying them in user space
+ * when the descriptors allow it, and its exit code
+ *
+ * @return the stored exit code, `-1` if the entry is missing, expired or
+ * incomplete
+ */
+static int replay(Cache *cache, int store, const char *key) {
+  int status;
+  long long created;
+  char objects[2][65];
+  if (read_entry(store, key, &status, &created, objects) ||
+      (cache->ttl >= 0 && time(NULL) - created >= cache->ttl))
+    return -1;
+  int fds[2];
+  char path[80];
+  for (int i = 0; i < 2; i++) {
+    snprintf(path, sizeof(path), "objects/%.64s", objects[i]);
+    fds[i] = openat(store, path, O_RDONLY | O_CLOEXEC);
+  }
+  if (fds[0] == -1 || fds[1] == -1) {
+    for (int i = 0; i < 2; i++) {
+      if (fds[i] != -1)
+        close(fds[i]);
+    }
+    return -1;
+  }
+  if (copy_fd(fds[0], builtin_stdout) == -1 ||
+      copy_fd(fds[1], STDERR_FILENO) == -1)
+    perror("jsh: cache");
+  close(fds[0]);
+  close(fds[1]);
+  // the modification time of the entry is its last use, for the eviction
+  snprintf(path, sizeof(path), "entries/%.64s", key);
+  utimensat(store, path, NULL, 0);
+  return status;
+}
+
+/**
+ * Writes `size` bytes, retrying after the partial writes
+ *
+ * @return `0` on success, `-1` on error
+ */
+static int write_full(int fd, const char *buffer, size_t size) {
+  while (size > 0) {
+    ssize_t n = write(fd, buffer, size);
+    if (n == -1) {
+      if (errno == EINTR)
+        continue;
+      return -1;
+    }
+    buffer += n;
+    size -= (size_t)n;
+  }
+  return 0;
+}
+
+/**
+ * Moves the data available in the pipe of `output` to the shell and to the
+ * store
+ */
+static void tee_output(Output *output) {
+  char buffer[65536];
+  ssize_t n = read(output->pipe, buffer, sizeof(buffer));
+  if (n == -1 && errno == EINTR)
+    return;
+  if (n <= 0) {
+    close(output->pipe);
+    output->pipe = -1;
+    return;
+  }
+  sha256_update(&output->sha, buffer, (size_t)n);
+  // a closed output doesn't stop the command nor the store
+  write_full(output->out, buffer, (size_t)n);
+  if (output->tmp != -1 && write_full(output->tmp, buffer, (size_t)n)) {
+    close(output->tmp);
+    output->tmp = -1;
+  }
+}
+
+static int compare_entries(const void *a, const void *b) {
+  long long used_a = ((const Entry *)a)->used;
+  long long used_b = ((const Entry *)b)->used;
+  return (used_a < used_b) - (used_a > used_b);
+}
+
+// also compares a name to an object, for `bsearch()`
+static int compare_objects(const void *a, const void *b) {
+  return strcmp(a, ((const Object *)b)->name);
+}
+
+/**
+ * Makes room in the store for its latest entries : the entries used last are
+ * kept while their outputs fit in `limit` bytes, the others are removed with
+ * the outputs no longer referenced
+ */
+static void evict(int store, off_t limit) {
+  Entry *entries = NULL;
+  Object *objects = NULL;
+  size_t nb_entries = 0, nb_objects = 0, size_entries = 0, size_objects = 0;
+  off_t total = 0;
+  time_t now = time(NULL);
+  struct stat st;
+  struct dirent *ent;
+  char path[80];
+
+  DIR *dir = fdopendir(openat(store, "objects", O_RDONLY | O_DIRECTORY |
+                                                    O_CLOEXEC));
+  if (dir == NULL)
+    return;
+  while ((ent = readdir(dir)) != NULL) {
+    snprintf(path, sizeof(path), "objects/%.64s", ent->d_name);
+    if (fstatat(store, path, &st, AT_SYMLINK_NOFOLLOW) == -1)
+      continue;
+    if (strncmp(ent->d_name, CACHE_TMP, strlen(CACHE_TMP)) == 0) {
+      if (now - st.st_mtime > CACHE_TMP_AGE)
+        unlinkat(store, path, 0);
+      continue;
+    }
+    if (!is_hash(ent->d_name))
+      continue;
+    if (nb_objects == size_objects) {
+      size_objects = size_objects ? size_objects * 2 : 64;
+      Object *tmp = realloc(objects, size_objects * sizeof(Object));
+      if (tmp == NULL)
+        goto end;
+      objects = tmp;
+    }
+    strcpy(objects[nb_objects].name, ent->d_name);
+    objects[nb_objects].size = st.st_size;
+    objects[nb_objects++].kept = 0;
+    total += st.st_size;
+  }
+  if (total <= limit)
+    goto end;
+  closedir(dir);
+
+  dir = fdopendir(openat(store, "entries", O_RDONLY | O_DIRECTORY | O_CLOEXEC));
+  if (dir == NULL)
+    goto end;
+  while ((ent = readdir(dir)) != NULL) {
+    int status;
+    long long created;
+    snprintf(path, sizeof(path), "entries/%.64s", ent->d_name);
+    if (!is_hash(ent->d_name) ||
+        fstatat(store, path, &st, AT_SYMLINK_NOFOLLOW) == -1)
+      continue;
+    if (nb_entries == size_entries) {
+      size_entries = size_entries ? size_entries * 2 : 64;
+      Entry *tmp = realloc(entries, size_entries * sizeof(Entry));
+      if (tmp == NULL)
+        goto end;
+      entries = tmp;
+    }
+    Entry *entry = &entries[nb_entries];
+    strcpy(entry->name, ent->d_name);
+    entry->used = st.st_mtim.tv_sec * 1000000000LL + st.st_mtim.tv_nsec;
+    if (read_entry(store, entry->name, &status, &created, entry->objects))
+      unlinkat(store, path, 0);
+    else
+      nb_entries++;
+  }
+
+  // the most recently used first
+  qsort(entries, nb_entries, sizeof(Entry), compare_entries);
+  qsort(objects, nb_objects, sizeof(Object), compare_objects);
+  off_t kept = 0;
+  for (size_t i = 0; i < nb_entries; i++) {
+    off_t size = 0;
+    Object *used[2];
+    for (size_t k = 0; k < 2; k++) {
+      used[k] = bsearch(entries[i].objects[k], objects, nb_objects,
+                        sizeof(Object), compare_objects);
+      if (used[k] != NULL && !used[k]->kept && (k == 0 || used[1] != used[0]))
+        size += used[k]->size;
+    }
+    snprintf(path, sizeof(path), "entries/%.64s", entries[i].name);
+    if (used[0] == NULL || used[1] == NULL || kept + size > limit) {
+      unlinkat(store, path, 0);
+      continue;
+    }
+    kept += size;
+    used[0]->kept = used[1]->kept = 1;
+  }
+  for (size_t o = 0; o < nb_objects; o++) {
+    if (!objects[o].kept) {
+      snprintf(path, sizeof(path), "objects/%.64s", objects[o].name);
+      unlinkat(store, path, 0);
+    }
+  }
+
+end:
+  if (dir != NULL)
+    closedir(dir);
+  free(entries);
+  free(objects);
+}
+
+/**
+ * Returns the bound of the size of the store, `$JSH_CACHE_SIZE` in bytes
+ */
+static off_t store_limit(void) {
+  const char *size = get_variable("JSH_CACHE_SIZE");
+  char *end = NULL;
+  long long limit = size != NULL ? strtoll(size, &end, 10) : -1;
+  if (limit < 0 || end == size || *end != '\0')
+    return CACHE_DEFAULT_SIZE;
+  return (off_t)limit;
+}
+
+/**
+ * Stores the outputs and the exit code of a command under `key`
+ *
+ * @return `0` on success, `-1` on error
+ */
+static int store_result(int store, const char *key, Output outputs[2],
+                        int status) {
+  char hashes[2][65];
+  char path[80];
+  for (int i = 0; i < 2; i++) {
+    if (outputs[i].tmp == -1)
+      return -1;
+    sha256_final(&outputs[i].sha, hashes[i]);
+    // identical outputs share their object
+    snprintf(path, sizeof(path), "objects/%.64s", hashes[i]);
+    if (renameat(store, outputs[i].name, store, path) == -1)
+      return -1;
+  }
+  char entry[512];
+  int len = snprintf(entry, sizeof(entry),
+                     "jsh-cache %d\nstatus %d\ncreated %lld\nstdout %s\n"
+                     "stderr %s\n",
+                     CACHE_VERSION, status, (long long)time(NULL), hashes[0],
+                     hashes[1]);
+  char tmp[80];
+  snprintf(tmp, sizeof(tmp), "entries/" CACHE_TMP "%d", getpid());
+  int fd = openat(store, tmp, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+  if (fd == -1)
+    return -1;
+  int error = write_full(fd, entry, (size_t)len);
+  close(fd);
+  snprintf(path, sizeof(path), "entries/%.64s", key);
+  if (error || renameat(store, tmp, store, path) == -1) {
+    unlinkat(store, tmp, 0);
+    return -1;
+  }
+  return 0;
+}
+
+/**
+ * Runs the command of a miss, copying its outputs to the shell and to the
+ * store. A command killed by a signal is not stored
+ *
+ * @return the exit code of the command
+ */
+static int run_miss(void *data) {
+  Miss *miss = data;
+  Output outputs[2];
+  int pipes[2][2];
+  for (int i = 0; i < 2; i++) {
+    outputs[i].out = i == 0 ? miss->out : STDERR_FILENO;
+    sha256_init(&outputs[i].sha);
+    snprintf(outputs[i].name, sizeof(outputs[i].name),
+             "objects/" CACHE_TMP "%d.%d", getpid(), i);
+    outputs[i].tmp = openat(miss->store, outputs[i].name,
+                            O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+    if (pipe2(pipes[i], O_CLOEXEC) == -1) {
+      perror("jsh: cache: pipe error");
+      return EXIT_FAILURE;
+    }
+    outputs[i].pipe = pipes[i][0];
+  }
+
+  pid_t pid = fork();
+  if (pid == 0) {
+    if (dup2(pipes[0][1], STDOUT_FILENO) == -1 ||
+        dup2(pipes[1][1], STDERR_FILENO) == -1) {
+      perror("jsh: cache: dup2 error");
+      exit(EXIT_FAILURE);
+    }
+    signals(1);
+    execute_command(miss->cache->command, 0);
+    exit(last_exit_code);
+  }
+  close(pipes[0][1]);
+  close(pipes[1][1]);
+  if (pid == -1) {
+    perror("jsh: cache: fork error");
+    return EXIT_FAILURE;
+  }
+
+  while (outputs[0].pipe != -1 || outputs[1].pipe != -1) {
+    struct pollfd fds[2];
+    for (int i = 0; i < 2; i++) {
+      fds[i].fd = outputs[i].pipe;
+      fds[i].events = POLLIN;
+    }
+    if (poll(fds, 2, -1) == -1) {
+      if (errno == EINTR)
+        continue;
+      perror("jsh: cache: poll error");
+      break;
+    }
+    for (int i = 0; i < 2; i++) {
+      if (fds[i].revents != 0)
+        tee_output(&outputs[i]);
+    }
+  }
+
+  int status;
+  while (jsh_waitpid(pid, &status, 0) == -1) {
+    if (errno != EINTR)
+      return EXIT_FAILURE;
+  }
+  int code = WIFSIGNALED(status) ? 128 + WTERMSIG(status) : WEXITSTATUS(status);
+  if (!WIFSIGNALED(status) &&
+      store_result(miss->store, miss->key, outputs, code) == 0)
+    evict(miss->store, store_limit());
+  for (int i = 0; i < 2; i++) {
+    if (outputs[i].pipe != -1)
+      close(outputs[i].pipe);
+    if (outputs[i].tmp != -1) {
+      close(outputs[i].tmp);
+      unlinkat(miss->store, outputs[i].name, 0);
+    }
+  }
+  return code;
+}
+
+/**
+ * Collects the words following an option up to `--`
+ *
+ * @return the index of the word following `--`, `0` if `--` is missing
+ */
+static size_t collect_words(char **args, size_t i, char ***words, size_t *nb) {
+  *words = args + i;
+  *nb = 0;
+  while (args[i] != NULL && strcmp(args[i], "--") != 0) {
+    i++;
+    (*nb)++;
+  }
+  return args[i] == NULL ? 0 : i + 1;
+}
+
+/**
+ * `cache [--inputs files... --] [--env NAME] [--ttl seconds] cmd [args...]` :
+ * runs a deterministic command once and replays its standard output, error
+ * and exit code afterwards. The result is keyed on the words of the command,
+ * the current directory, the variables of `--env` and the size and
+ * modification time of the files of `--inputs`. It expires after `--ttl`
+ * seconds. The store, `$JSH_CACHE_DIR` (`~/.cache/jsh` by default), keeps the
+ * outputs by content and evicts the least recently used results beyond
+ * `$JSH_CACHE_SIZE` bytes (256 MiB)
+ *
+ * @param args : command arguments
+ */
+int jcache(char **args) {
+  Cache cache = {NULL, NULL, 0, NULL, 0, -1};
+  char *env[64];
+  size_t i = 1;
+  while (args[i] != NULL && strncmp(args[i], "--", 2) == 0) {
+    if (strcmp(args[i], "--inputs") == 0) {
+      i = collect_words(args, i + 1, &cache.inputs, &cache.nb_inputs);
+      if (i == 0)
+        goto usage;
+    } else if (strcmp(args[i], "--env") == 0 && args[i + 1] != NULL &&
+               cache.nb_env < sizeof(env) / sizeof(env[0])) {
+      env[cache.nb_env++] = args[i + 1];
+      i += 2;
+    } else if (strcmp(args[i], "--ttl") == 0 && args[i + 1] != NULL) {
+      char *end = NULL;
+      cache.ttl = strtol(args[i + 1], &end, 10);
+      if (cache.ttl < 0 || *end != '\0')
+        goto usage;
+      i += 2;
+    } else if (strcmp(args[i], "--") == 0) {
+      i++;
+      break;
+    } else {
+      goto usage;
+    }
+  }
+  if (args[i] == NULL)
+    goto usage;
+  cache.command = args + i;
+  cache.env = env;
+
+  int store = open_store();
+  if (store == -1) {
+    // still runs the command, uncached
+    execute_command(cache.command, 1);
+    return last_exit_code;
+  }
+  Miss miss = {&cache, store, "", builtin_stdout};
+  compute_key(&cache, miss.key);
+  int status = replay(&cache, store, miss.key);
+  if (status == -1) {
+    // the directories of the store are only missing on the first miss
+    mkdirat(store, "objects", 0700);
+    mkdirat(store, "entries", 0700);
+    status = run_job(args, run_miss, &miss);
+  }
+  close(store);
+  return status;
+
+usage:
+  fprintf(stderr, "jsh: cache: usage: cache [--inputs files... --] "
+                  "[--env NAME] [--ttl seconds] cmd [args...]\n");
+  return 2;
+}
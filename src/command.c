@@ -7,11 +7,16 @@ Command *create_command(char *name, Argument *arguments,
   cmd->arguments = arguments;
   cmd->redirection = redirection;
   cmd->substitutions = malloc(sizeof(Command *)*5);
+  cmd->substitution_fds = malloc(sizeof(int)*5);
   cmd->nb_substitutions = 0;
   cmd->size_substitutions = 5;
   cmd->background = background;
   cmd->next = NULL;
   cmd->pipe = NULL;
+  cmd->connector = SEQUENCE;
+  cmd->group = NULL;
+  cmd->condition = NULL;
+  cmd->alternative = NULL;
   return cmd;
 }
 
@@ -58,6 +63,76 @@ Redirection *add_redirection(Command *command, RedirectionType type,
   }
   return redir;
 }
+/**
+ * @brief Registers a substitution on a command
+ * @param command the command reading the substitution output
+ * @param substitution the command to substitute
+ * @param fd read end of the pipe fed by `substitution`, closed by
+ * `clear_command()`
+ * @return 1 on allocation failure, 0 on success
+ */
+int add_substitution(Command *command, Command *substitution, int fd) {
+  if (command->nb_substitutions + 1 >= command->size_substitutions) {
+    size_t size = command->size_substitutions + 10;
+    Command **substitutions =
+        realloc(command->substitutions, sizeof(Command *) * size);
+    if (substitutions == NULL)
+      return 1;
+    command->substitutions = substitutions;
+    int *fds = realloc(command->substitution_fds, sizeof(int) * size);
+    if (fds == NULL)
+      return 1;
+    command->substitution_fds = fds;
+    command->size_substitutions = size;
+  }
+  command->substitution_fds[command->nb_substitutions] = fd;
+  command->substitutions[command->nb_substitutions++] = substitution;
+  return 0;
+}
+
+/**
+ * @brief Creates the pipe of the substitution `k` of a command right before
+ * running it, so that a command parsed once can be executed several times.
+ * The read end replaces `substitution_fds[k]`, whose number is the one of the
+ * `/dev/fd/N` argument, the write end becomes the `SUBSTITUTION_OUT`
+ * redirection of the substitution
+ * @param command the command reading the substitution
+ * @param k index of the substitution
+ * @return 1 on failure, 0 on success
+ */
+int open_substitution(Command *command, size_t k) {
+  int fds[2];
+  if (pipe2(fds, O_CLOEXEC)) {
+    perror("jsh: pipe error");
+    return 1;
+  }
+  if (dup3(fds[0], command->substitution_fds[k], O_CLOEXEC) == -1) {
+    perror("jsh: dup3 error");
+    close(fds[0]);
+    close(fds[1]);
+    return 1;
+  }
+  close(fds[0]);
+
+  Command *last_cmd;
+  for (last_cmd = command->substitutions[k]; last_cmd->next != NULL;
+       last_cmd = last_cmd->next)
+    ;
+  for (Redirection *r = last_cmd->redirection; r != NULL; r = r->next) {
+    if (r->type == SUBSTITUTION_OUT) {
+      // large enough for any descriptor
+      char *value = realloc(r->value, 20);
+      if (value == NULL)
+        break;
+      sprintf(value, "%d", fds[1]);
+      r->value = value;
+      return 0;
+    }
+  }
+  close(fds[1]);
+  return 1;
+}
+
 /**
  * @brief check if the token is a redirection
  * @param token 
@@ -91,10 +166,15 @@ void clear_command(Command *command) {
     free(redir);
     redir = nextRedir;
   }
+  clear_command(command->group);
+  clear_command(command->condition);
+  clear_command(command->alternative);
   clear_command(command->next);
   for (size_t i = 0 ; i < command->nb_substitutions ; i++) {
     clear_command(command->substitutions[i]);
+    close(command->substitution_fds[i]);
   }
   free(command->substitutions);
+  free(command->substitution_fds);
   free(command);
 }
\ No newline at end of file
@@ -0,0 +1,402 @@
+#include "../head/jsh.h"
+
+/*
+ * Completion of the command names, from a trie of the programs of `$PATH`,
+ * and of the jobs (`%N`) after `fg`, `bg` and `kill`.
+ *
+ * Each directory of `$PATH` keeps the names it added to the trie and its
+ * modification time : a Tab only calls `stat()` on the directories, and
+ * reads again the ones which changed, removing their previous names from the
+ * trie before adding the new ones. The nodes keep the number of names below
+ * them, so that a subtree whose names all left is skipped.
+ */
+
+typedef struct {
+  uint32_t child;   // first child, `0` if none
+  uint32_t sibling; // next child of the parent, by increasing `c`
+  uint32_t count;   // names in the subtree, with their multiplicity
+  uint32_t names;   // directories providing the name ending here
+  char c;
+} TrieNode;
+
+typedef struct {
+  char *path;
+  struct timespec mtime; // `{0, 0}` until read
+  char *names;           // names added to the trie, separated by `\0`
+  size_t names_length;
+} PathDir;
+
+// the root is the node 0
+static TrieNode *nodes = NULL;
+static uint32_t nb_nodes = 0;
+static uint32_t nodes_size = 0;
+
+static char *path_value = NULL; // `$PATH` split into `path_dirs`
+static PathDir *path_dirs = NULL;
+static size_t nb_path_dirs = 0;
+
+/**
+ * Returns a new node, `0` on allocation error
+ */
+static uint32_t new_node(char c) {
+  if (nb_nodes == nodes_size) {
+    uint32_t size = nodes_size ? 2 * nodes_size : 4096;
+    TrieNode *new_nodes = realloc(nodes, size * sizeof(TrieNode));
+    if (new_nodes == NULL)
+      return 0;
+    nodes = new_nodes;
+    nodes_size = size;
+  }
+  nodes[nb_nodes] = (TrieNode){0, 0, 0, 0, c};
+  return nb_nodes++;
+}
+
+/**
+ * Returns the child `c` of `node`, created if `create`, `0` if there is none
+ */
+static uint32_t find_child(uint32_t node, char c, int create) {
+  uint32_t *link = &nodes[node].child;
+  while (*link != 0 && nodes[*link].c < c)
+    link = &nodes[*link].sibling;
+  if (*link != 0 && nodes[*link].c == c)
+    return *link;
+  if (!create)
+    return 0;
+  uint32_t child = new_node(c);
+  if (child == 0)
+    return 0;
+  // `nodes` may have moved
+  link = &nodes[node].child;
+  while (*link != 0 && nodes[*link].c < c)
+    link = &nodes[*link].sibling;
+  nodes[child].sibling = *link;
+  *link = child;
+  return child;
+}
+
+/**
+ * Adds (`delta` `1`) or removes (`-1`) a name provided by a directory
+ */
+static void trie_update(const char *name, int delta) {
+  if (nb_nodes == 0) {
+    new_node('\0');
+    if (nb_nodes == 0)
+      return;
+  }
+  // a name is only removed once added : its nodes exist
+  uint32_t node = 0;
+  for (const char *c = name; *c != '\0'; c++) {
+    node = find_child(node, *c, delta > 0);
+    if (node == 0)
+      return;
+  }
+  node = 0;
+  for (const char *c = name;; c++) {
+    nodes[node].count += (uint32_t)delta;
+    if (*c == '\0')
+      break;
+    node = find_child(node, *c, 0);
+  }
+  nodes[node].names += (uint32_t)delta;
+}
+
+/**
+ * Removes the names of a directory from the trie
+ */
+static void forget_dir(PathDir *dir) {
+  for (size_t i = 0; i < dir->names_length; i += strlen(dir->names + i) + 1)
+    trie_update(dir->names + i, -1);
+  free(dir->names);
+  dir->names = NULL;
+  dir->names_length = 0;
+}
+
+/**
+ * Reads the programs of a directory into the trie
+ */
+static void scan_dir(PathDir *dir) {
+  DIR *stream = opendir(dir->path);
+  if (stream == NULL)
+    return;
+  size_t size = 0;
+  struct dirent *entry;
+  while ((entry = readdir(stream)) != NULL) {
+    if (entry->d_name[0] == '.' || entry->d_type == DT_DIR)
+      continue;
+    struct stat st;
+    if (entry->d_type != DT_REG &&
+        (fstatat(dirfd(stream), entry->d_name, &st, 0) == -1 ||
+         !S_ISREG(st.st_mode)))
+      continue;
+    if (faccessat(dirfd(stream), entry->d_name, X_OK, AT_EACCESS) == -1)
+      continue;
+    size_t length = strlen(entry->d_name) + 1;
+    if (dir->names_length + length > size) {
+      size_t new_size = size ? 2 * size : 4096;
+      while (new_size < dir->names_length + length)
+        new_size *= 2;
+      char *names = realloc(dir->names, new_size);
+      if (names == NULL)
+        break;
+      dir->names = names;
+      size = new_size;
+    }
+    memcpy(dir->names + dir->names_length, entry->d_name, length);
+    dir->names_length += length;
+    trie_update(entry->d_name, 1);
+  }
+  closedir(stream);
+}
+
+/**
+ * Splits `$PATH` again when it changed : the directories still in it keep
+ * their names, the others are removed from the trie
+ */
+static void update_path_dirs(void) {
+  const char *path = get_variable("PATH");
+  if (path == NULL)
+    path = "";
+  if (path_value != NULL && strcmp(path_value, path) == 0)
+    return;
+  char *value = strdup(path);
+  size_t count = 1;
+  for (const char *c = path; *c != '\0'; c++)
+    count += *c == ':';
+  PathDir *new_dirs = calloc(count, sizeof(PathDir));
+  if (value == NULL || new_dirs == NULL) {
+    free(value);
+    free(new_dirs);
+    return;
+  }
+  size_t nb_new = 0;
+  char *rest;
+  for (char *entry = strtok_r(value, ":", &rest); entry != NULL;
+       entry = strtok_r(NULL, ":", &rest)) {
+    // the relative directories depend on the current one
+    if (entry[0] != '/')
+      continue;
+    int duplicate = 0;
+    for (size_t i = 0; i < nb_new && !duplicate; i++)
+      duplicate = strcmp(new_dirs[i].path, entry) == 0;
+    if (duplicate)
+      continue;
+    size_t old = 0;
+    while (old < nb_path_dirs && (path_dirs[old].path == NULL ||
+                                  strcmp(path_dirs[old].path, entry) != 0))
+      old++;
+    if (old < nb_path_dirs) {
+      new_dirs[nb_new++] = path_dirs[old];
+      path_dirs[old].path = NULL;
+    } else {
+      new_dirs[nb_new].path = strdup(entry);
+      if (new_dirs[nb_new].path != NULL)
+        nb_new++;
+    }
+  }
+  for (size_t i = 0; i < nb_path_dirs; i++) {
+    if (path_dirs[i].path != NULL) {
+      forget_dir(&path_dirs[i]);
+      free(path_dirs[i].path);
+    }
+  }
+  free(path_dirs);
+  free(path_value);
+  free(value);
+  path_value = strdup(path);
+  path_dirs = new_dirs;
+  nb_path_dirs = nb_new;
+}
+
+/**
+ * Brings the trie up to date with `$PATH` and its directories
+ */
+static void update_trie(void) {
+  update_path_dirs();
+  for (size_t i = 0; i < nb_path_dirs; i++) {
+    PathDir *dir = &path_dirs[i];
+    struct stat st;
+    struct timespec mtime = {0, 0};
+    if (stat(dir->path, &st) == 0)
+      mtime = st.st_mtim;
+    if (mtime.tv_sec == dir->mtime.tv_sec &&
+        mtime.tv_nsec == dir->mtime.tv_nsec)
+      continue;
+    forget_dir(dir);
+    dir->mtime = mtime;
+    if (mtime.tv_sec != 0 || mtime.tv_nsec != 0)
+      scan_dir(dir);
+  }
+}
+
+// matches of the current completion, returned one by one to readline
+static char **matches = NULL;
+static size_t nb_matches = 0;
+static size_t matches_size = 0;
+
+static void add_match(const char *name) {
+  if (nb_matches == matches_size) {
+    size_t size = matches_size ? 2 * matches_size : 64;
+    char **new_matches = realloc(matches, size * sizeof(char *));
+    if (new_matches == NULL)
+      return;
+    matches = new_matches;
+    matches_size = size;
+  }
+  char *copy = strdup(name);
+  if (copy != NULL)
+    matches[nb_matches++] = copy;
+}
+
+/**
+ * Adds the names below `node`, whose first `length` characters are in
+ * `name`
+ */
+static void collect(uint32_t node, char *name, size_t length, size_t size) {
+  if (nodes[node].names > 0) {
+    name[length] = '\0';
+    add_match(name);
+  }
+  if (length + 1 >= size)
+    return;
+  for (uint32_t child = nodes[node].child; child != 0;
+       child = nodes[child].sibling) {
+    if (nodes[child].count == 0)
+      continue;
+    name[length] = nodes[child].c;
+    collect(child, name, length + 1, size);
+  }
+}
+
+/**
+ * Returns the matches one by one to readline, which frees them
+ */
+static char *next_match(const char *text, int state) {
+  (void)text;
+  static size_t next;
+  if (state == 0)
+    next = 0;
+  return next < nb_matches ? matches[next++] : NULL;
+}
+
+/**
+ * Computes the commands starting with `text` : the built-ins and the
+ * programs of the trie
+ */
+static void complete_command(const char *text) {
+  nb_matches = 0;
+  size_t position = 0;
+  size_t length = strlen(text);
+  for (const char *name; (name = next_builtin(&position)) != NULL;) {
+    if (strncmp(name, text, length) == 0)
+      add_match(name);
+  }
+  update_trie();
+  uint32_t node = 0;
+  for (const char *c = text; *c != '\0' && nb_nodes > 0; c++) {
+    node = find_child(node, *c, 0);
+    if (node == 0)
+      return;
+  }
+  if (nb_nodes == 0 || nodes[node].count == 0)
+    return;
+  char name[NAME_MAX + 1];
+  if (length > NAME_MAX)
+    return;
+  memcpy(name, text, length);
+  collect(node, name, length, sizeof(name));
+}
+
+/**
+ * Computes the jobs `%N` starting with `text`
+ */
+static void complete_job(const char *text) {
+  nb_matches = 0;
+  size_t length = strlen(text);
+  lock_jobs();
+  for (job_t *job = shell->job_list; job != NULL; job = job->next) {
+    char name[16];
+    snprintf(name, sizeof(name), "%%%d", job->age);
+    if (strncmp(name, text, length) == 0)
+      add_match(name);
+  }
+  unlock_jobs();
+}
+
+/**
+ * Copies the word before the position `end` of the line, `""` if it is
+ * preceded by a separator of commands
+ */
+static void previous_word(int end, char *word, size_t size) {
+  int i = end;
+  while (i > 0 && strchr(" \t", rl_line_buffer[i - 1]) != NULL)
+    i--;
+  int start = i;
+  while (start > 0 && strchr(" \t|;&{", rl_line_buffer[start - 1]) == NULL)
+    start--;
+  size_t length = (size_t)(i - start);
+  if (length >= size)
+    length = size - 1;
+  memcpy(word, rl_line_buffer + start, length);
+  word[length] = '\0';
+}
+
+/**
+ * Returns `1` if the word starting at `start` is the name of a command : at
+ * the start of the line, after a separator or a keyword
+ */
+static int command_position(int start) {
+  int i = start;
+  while (i > 0 && strchr(" \t", rl_line_buffer[i - 1]) != NULL)
+    i--;
+  if (i == 0 || strchr("|;&{", rl_line_buffer[i - 1]) != NULL)
+    return 1;
+  char word[8];
+  previous_word(start, word, sizeof(word));
+  static const char *keywords[] = {"then", "do", "else", "if", "elif",
+                                   "while", "!"};
+  for (size_t k = 0; k < sizeof(keywords) / sizeof(keywords[0]); k++) {
+    if (strcmp(word, keywords[k]) == 0)
+      return 1;
+  }
+  return 0;
+}
+
+/**
+ * Returns `1` if the word starting at `start` is an argument of `fg`, `bg`
+ * or `kill`
+ */
+static int job_position(int start) {
+  int i = start;
+  // the first word of the command
+  while (i > 0 && strchr("|;&{", rl_line_buffer[i - 1]) == NULL)
+    i--;
+  while (rl_line_buffer[i] == ' ' || rl_line_buffer[i] == '\t')
+    i++;
+  size_t length = strcspn(rl_line_buffer + i, " \t");
+  return (length == 2 && (strncmp(rl_line_buffer + i, "fg", 2) == 0 ||
+                          strncmp(rl_line_buffer + i, "bg", 2) == 0)) ||
+         (length == 4 && strncmp(rl_line_buffer + i, "kill", 4) == 0);
+}
+
+static char **completion(const char *text, int start, int end) {
+  (void)end;
+  if (text[0] == '%' && job_position(start)) {
+    complete_job(text);
+    rl_attempted_completion_over = 1;
+  } else if (strchr(text, '/') == NULL && command_position(start)) {
+    complete_command(text);
+    // nothing found : the names of files, as `./script`
+    if (nb_matches == 0)
+      return NULL;
+  } else {
+    return NULL;
+  }
+  return rl_completion_matches(text, next_match);
+}
+
+/**
+ * Installs the completion of the commands and jobs in readline
+ */
+void init_completion(void) {
+  rl_attempted_completion_function = completion;
+}
@@ -0,0 +1,177 @@
+#include "../head/jsh.h"
+
+typedef struct Coproc {
+  char *name;
+  pid_t pid;
+  int in;  // write end of the pipe of the standard input of the coprocess
+  int out; // read end of the pipe of its standard output
+  struct Coproc *next;
+} Coproc;
+
+// coprocesses whose pipes are still open in the shell
+static Coproc *coprocs = NULL;
+
+/**
+ * Sets the variable `<name><suffix>` to the number `value`
+ */
+static void set_number_variable(const char *name, const char *suffix,
+                                long value) {
+  char variable[256];
+  char number[24];
+  snprintf(variable, sizeof(variable), "%s%s", name, suffix);
+  snprintf(number, sizeof(number), "%ld", value);
+  if (set_variable(variable, number, 0))
+    fprintf(stderr, "jsh: allocation error\n");
+}
+
+/**
+ * Closes the pipes of the coprocess `name` in the shell, which ends its input,
+ * and removes its variables
+ *
+ * @return `0` on success, `1` if there is no such coprocess
+ */
+static int close_coproc(const char *name) {
+  for (Coproc **prev = &coprocs; *prev != NULL; prev = &(*prev)->next) {
+    Coproc *coproc = *prev;
+    if (strcmp(coproc->name, name) != 0)
+      continue;
+    close(coproc->in);
+    close(coproc->out);
+    char variable[256];
+    const char *suffixes[] = {"_PID", "_IN", "_OUT"};
+    for (size_t i = 0; i < 3; i++) {
+      snprintf(variable, sizeof(variable), "%s%s", name, suffixes[i]);
+      unset_variable(variable);
+    }
+    *prev = coproc->next;
+    free(coproc->name);
+    free(coproc);
+    return 0;
+  }
+  return 1;
+}
+
+/**
+ * Moves the descriptor `fd` above the ones a command usually expects, close
+ * on exec : only the commands redirected to it inherit it
+ *
+ * @return the new descriptor, `-1` on error (`fd` is closed anyway)
+ */
+static int move_fd(int fd) {
+  int moved = fcntl(fd, F_DUPFD_CLOEXEC, 10);
+  close(fd);
+  return moved;
+}
+
+/**
+ * `coproc [NAME --] cmd [args...]` : starts `cmd` as a background job whose
+ * standard input and output are pipes kept open by the shell. `NAME_IN` is
+ * the descriptor writing to its input, `NAME_OUT` the one reading its output
+ * and `NAME_PID` its pid, for the redirections `>& $NAME_IN` and
+ * `<& $NAME_OUT`. Without `--` after it, the first word is the command and
+ * `NAME` is `COPROC`.
+ * `coproc -c NAME` closes the pipes, `coproc` lists the coprocesses
+ *
+ * @param args : command arguments
+ */
+int coproc(char **args) {
+  if (args[1] == NULL) {
+    for (Coproc *coproc = coprocs; coproc != NULL; coproc = coproc->next)
+      dprintf(builtin_stdout, "%s pid %d in %d out %d\n", coproc->name,
+              coproc->pid, coproc->in, coproc->out);
+    return EXIT_SUCCESS;
+  }
+  if (strcmp(args[1], "-c") == 0) {
+    int status = EXIT_SUCCESS;
+    for (size_t i = 2; args[i] != NULL; i++) {
+      if (close_coproc(args[i])) {
+        fprintf(stderr, "jsh: coproc: %s: no such coprocess\n", args[i]);
+        status = EXIT_FAILURE;
+      }
+    }
+    return status;
+  }
+
+  int named = args[2] != NULL && strcmp(args[2], "--") == 0;
+  const char *name = named ? args[1] : "COPROC";
+  char **command = named ? args + 3 : args + 1;
+  if (command[0] == NULL) {
+    fprintf(stderr, "jsh: coproc: %s: command expected after --\n", name);
+    return 2;
+  }
+  if (!is_name(name) || strlen(name) > 200) {
+    fprintf(stderr, "jsh: coproc: `%s': not a valid identifier\n", name);
+    return EXIT_FAILURE;
+  }
+  for (Coproc *coproc = coprocs; coproc != NULL; coproc = coproc->next) {
+    if (strcmp(coproc->name, name) == 0 && kill(coproc->pid, 0) == 0) {
+      fprintf(stderr, "jsh: coproc: %s: still running (coproc -c %s)\n",
+              name, name);
+      return EXIT_FAILURE;
+    }
+  }
+  close_coproc(name);
+
+  Coproc *coproc = malloc(sizeof(Coproc));
+  int in[2] = {-1, -1};
+  int out[2] = {-1, -1};
+  if (coproc == NULL || (coproc->name = strdup(name)) == NULL) {
+    fprintf(stderr, "jsh: allocation error\n");
+    free(coproc);
+    return EXIT_FAILURE;
+  }
+  if (pipe2(in, O_CLOEXEC) == -1 || pipe2(out, O_CLOEXEC) == -1) {
+    perror("jsh: pipe error");
+    goto error;
+  }
+
+  pid_t pid = fork();
+  if (pid == 0) {
+    // like a background job, the coprocess has its own process group
+    if (setpgid(getpid(), getpid())) {
+      perror("jsh: setgid error");
+      exit(EXIT_FAILURE);
+    }
+    if (dup2(in[0], STDIN_FILENO) == -1 || dup2(out[1], STDOUT_FILENO) == -1) {
+      perror("jsh: dup2 error");
+      exit(EXIT_FAILURE);
+    }
+    signals(1);
+    execute_program(command);
+  }
+  if (pid == -1) {
+    perror("jsh: fork error");
+    goto error;
+  }
+  setpgid(pid, pid);
+  close(in[0]);
+  close(out[1]);
+  coproc->pid = pid;
+  coproc->in = move_fd(in[1]);
+  coproc->out = move_fd(out[0]);
+  if (coproc->in == -1 || coproc->out == -1)
+    perror("jsh: coproc: dup error");
+  coproc->next = coprocs;
+  coprocs = coproc;
+  set_number_variable(name, "_PID", pid);
+  set_number_variable(name, "_IN", coproc->in);
+  set_number_variable(name, "_OUT", coproc->out);
+
+  char *cmd = get_command2(args);
+  if (cmd == NULL)
+    return EXIT_FAILURE;
+  job_t *new_job = add_job(pid, RUNNING, cmd);
+  print_job_details(new_job, STDERR_FILENO);
+  return EXIT_SUCCESS;
+
+error:
+  for (size_t i = 0; i < 2; i++) {
+    if (in[i] != -1)
+      close(in[i]);
+    if (out[i] != -1)
+      close(out[i]);
+  }
+  free(coproc->name);
+  free(coproc);
+  return EXIT_FAILURE;
+}
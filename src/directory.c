@@ -0,0 +1,492 @@
+#include "../head/jsh.h"
+
+// logical current directory and directory stack of the active context
+static Directories directories = {NULL, NULL, 0, 0};
+
+// incremented at each change of `directories.pwd`, for the prompt
+static unsigned long version = 0;
+
+// entries of `$CDPATH`, split again only when its value changes
+static char *cdpath_value = NULL;
+static char **cdpath = NULL;
+static size_t nb_cdpath = 0;
+
+/**
+ * Resolves `path` against the directory `base` without following the
+ * symbolic links : `.` and empty components are dropped, `..` removes the
+ * previous component
+ *
+ * @return the absolute path, to free, `NULL` on allocation error
+ */
+static char *normalize(const char *base, const char *path) {
+  size_t size = (path[0] == '/' ? 0 : strlen(base)) + strlen(path) + 2;
+  char *result = malloc(size);
+  if (result == NULL)
+    return NULL;
+  size_t length = 0;
+  if (path[0] != '/') {
+    length = strlen(base);
+    memcpy(result, base, length);
+    // `base` is already normalized : it only ends with `/` when it is `/`
+    if (length == 1)
+      length = 0;
+  }
+  const char *component = path;
+  while (*component != '\0') {
+    const char *end = strchrnul(component, '/');
+    size_t component_length = (size_t)(end - component);
+    if (component_length == 2 && component[0] == '.' && component[1] == '.') {
+      while (length > 0 && result[length - 1] != '/')
+        length--;
+      if (length > 0)
+        length--;
+    } else if (component_length > 0 &&
+               !(component_length == 1 && component[0] == '.')) {
+      result[length++] = '/';
+      memcpy(result + length, component, component_length);
+      length += component_length;
+    }
+    component = *end == '/' ? end + 1 : end;
+  }
+  if (length == 0)
+    result[length++] = '/';
+  result[length] = '\0';
+  return result;
+}
+
+/**
+ * Sets the logical current directory to `path`, which it takes, and updates
+ * `$PWD` and `$OLDPWD`
+ */
+static void set_directory(char *path) {
+  if (directories.pwd != NULL &&
+      set_variable("OLDPWD", directories.pwd, 1))
+    fprintf(stderr, "jsh: allocation error\n");
+  free(directories.pwd);
+  directories.pwd = path;
+  version++;
+  if (path != NULL && set_variable("PWD", path, 1))
+    fprintf(stderr, "jsh: allocation error\n");
+}
+
+/**
+ * Imports the current directory : `$PWD` is kept when it is an absolute path
+ * to the current directory, so that the symbolic links followed to reach it
+ * stay visible, the physical path is used otherwise
+ */
+void init_directories(void) {
+  char *pwd = get_variable("PWD");
+  char *path = NULL;
+  struct stat logical, physical;
+  if (pwd != NULL && pwd[0] == '/' && stat(pwd, &logical) == 0 &&
+      stat(".", &physical) == 0 && logical.st_dev == physical.st_dev &&
+      logical.st_ino == physical.st_ino) {
+    path = normalize("/", pwd);
+  }
+  if (path == NULL)
+    path = getcwd(NULL, 0);
+  free(directories.pwd);
+  directories.pwd = path;
+  version++;
+  if (path != NULL && set_variable("PWD", path, 1))
+    fprintf(stderr, "jsh: allocation error\n");
+}
+
+/**
+ * Saves the directories of the shell in `*save`, if not `NULL`, and replaces
+ * them with `*load`, for the contexts of `libjsh.c`
+ */
+void switch_directories(Directories *save, const Directories *load) {
+  if (save != NULL)
+    *save = directories;
+  directories = *load;
+  version++;
+}
+
+/**
+ * Forgets the current directory and empties the directory stack
+ */
+void clear_directories(void) {
+  free(directories.pwd);
+  for (size_t i = 0; i < directories.nb_stack; i++)
+    free(directories.stack[i]);
+  free(directories.stack);
+  directories = (Directories){NULL, NULL, 0, 0};
+  version++;
+}
+
+/**
+ * Returns the logical current directory, as `$PWD` but without a system call
+ *
+ * @return the path, only valid until the directory changes, `NULL` if it is
+ * unknown
+ */
+const char *current_directory(void) { return directories.pwd; }
+
+/**
+ * Returns a number which changes with the current directory, so that what
+ * is derived from it is only computed again after a change
+ */
+unsigned long directory_version(void) { return version; }
+
+/**
+ * Changes the current directory to `path`. The logical path, resolved
+ * against the current one, is tried first ; the physical one is used with
+ * `physical`, when the logical path does not lead to a directory, or when
+ * the current directory is unknown
+ *
+ * @return `0` on success, `-1` with `errno` set on error
+ */
+int change_directory(const char *path, int physical) {
+  if (!physical && directories.pwd != NULL) {
+    char *logical = normalize(directories.pwd, path);
+    if (logical == NULL)
+      return -1;
+    if (chdir(logical) == 0) {
+      set_directory(logical);
+      return 0;
+    }
+    free(logical);
+  }
+  if (chdir(path) == -1)
+    return -1;
+  set_directory(getcwd(NULL, 0));
+  return 0;
+}
+
+/**
+ * Splits `$CDPATH` in its entries, unless its value is the one already split
+ *
+ * @return `0` on success, `-1` on allocation error
+ */
+static int update_cdpath(void) {
+  const char *value = get_variable("CDPATH");
+  if (value == NULL)
+    value = "";
+  if (cdpath_value != NULL && strcmp(cdpath_value, value) == 0)
+    return 0;
+  free(cdpath_value);
+  free(cdpath);
+  nb_cdpath = 0;
+  cdpath = NULL;
+  cdpath_value = strdup(value);
+  if (cdpath_value == NULL)
+    return -1;
+  if (*cdpath_value == '\0')
+    return 0;
+  size_t count = 1;
+  for (const char *c = cdpath_value; *c != '\0'; c++)
+    count += *c == ':';
+  cdpath = malloc(count * sizeof(char *));
+  if (cdpath == NULL) {
+    free(cdpath_value);
+    cdpath_value = NULL;
+    return -1;
+  }
+  for (char *entry = cdpath_value; entry != NULL; nb_cdpath++) {
+    cdpath[nb_cdpath] = entry;
+    entry = strchr(entry, ':');
+    if (entry != NULL)
+      *entry++ = '\0';
+  }
+  return 0;
+}
+
+/**
+ * Returns `1` if `path` is searched in `$CDPATH` : it is relative and does
+ * not start with `.` or `..`
+ */
+static int uses_cdpath(const char *path) {
+  if (path[0] == '/')
+    return 0;
+  if (path[0] == '.' && (path[1] == '\0' || path[1] == '/'))
+    return 0;
+  return !(path[0] == '.' && path[1] == '.' &&
+           (path[2] == '\0' || path[2] == '/'));
+}
+
+/**
+ * Changes the current directory to `path`, searched in `$CDPATH`. Reaching a
+ * directory through a non-empty entry prints it
+ *
+ * @return `0` on success, `-1` with `errno` set by the last attempt on error
+ */
+static int cd_path(const char *path, int physical) {
+  if (uses_cdpath(path) && update_cdpath() == 0) {
+    for (size_t i = 0; i < nb_cdpath; i++) {
+      if (*cdpath[i] == '\0')
+        continue;
+      size_t size = strlen(cdpath[i]) + strlen(path) + 2;
+      char *candidate = malloc(size);
+      if (candidate == NULL)
+        return -1;
+      snprintf(candidate, size, "%s/%s", cdpath[i], path);
+      int error = change_directory(candidate, physical);
+      free(candidate);
+      if (!error) {
+        dprintf(builtin_stdout, "%s\n", directories.pwd);
+        return 0;
+      }
+    }
+  }
+  return change_directory(path, physical);
+}
+
+int cd(char **args) {
+  int physical = 0;
+  size_t i = 1;
+  for (; args[i] != NULL && (strcmp(args[i], "-P") == 0 ||
+                             strcmp(args[i], "-L") == 0);
+       i++)
+    physical = args[i][1] == 'P';
+
+  // Vérifie le nombre d'arguments
+  if (args[i] != NULL && args[i + 1] != NULL) {
+    fprintf(stderr, "cd : trop d'arguments\n");
+    return EXIT_FAILURE;
+  }
+
+  const char *target = args[i];
+  int error;
+  // Cas où aucun argument n'est fourni
+  if (target == NULL) {
+    target = get_variable("HOME");
+    if (target == NULL) {
+      fprintf(stderr,
+              "cd : la variable d'environnement $HOME n'est pas définie\n");
+      return EXIT_FAILURE;
+    }
+    error = change_directory(target, physical);
+  }
+  // Cas où l'argument est "-"
+  else if (strcmp(target, "-") == 0) {
+    target = get_variable("OLDPWD");
+    if (target == NULL) {
+      fprintf(stderr,
+              "cd : la variable d'environnement $OLDPWD n'est pas définie\n");
+      return EXIT_FAILURE;
+    }
+    error = change_directory(target, physical);
+    if (!error)
+      dprintf(builtin_stdout, "%s\n", directories.pwd);
+  } else {
+    error = cd_path(target, physical);
+  }
+
+  if (error) {
+    fprintf(stderr, "jsh: cd: %s: %s\n", target, strerror(errno));
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
+
+int pwd(char **args) {
+  int physical = args[1] != NULL && strcmp(args[1], "-P") == 0;
+  if (!physical && directories.pwd != NULL) {
+    dprintf(builtin_stdout, "%s\n", directories.pwd);
+    return EXIT_SUCCESS;
+  }
+  char *cwd = getcwd(NULL, 0);
+  if (cwd == NULL) {
+    perror("jsh: pwd");
+    return EXIT_FAILURE;
+  }
+  dprintf(builtin_stdout, "%s\n", cwd);
+  free(cwd);
+  return EXIT_SUCCESS;
+}
+
+/**
+ * Returns the entry `index` of the list printed by `dirs` : the current
+ * directory, then the stack from its top
+ */
+static const char *dirs_entry(size_t index) {
+  return index == 0 ? directories.pwd : directories.stack[index - 1];
+}
+
+/**
+ * Parses the `+N` or `-N` argument of `pushd` and `popd`, counted from the
+ * left or the right of the list printed by `dirs`
+ *
+ * @return the index in this list, `-1` if the argument is not such a number
+ * or out of range
+ */
+static long dirs_index(const char *arg) {
+  if ((arg[0] != '+' && arg[0] != '-') || arg[1] == '\0' ||
+      arg[1 + strspn(arg + 1, "0123456789")] != '\0')
+    return -1;
+  long n = atol(arg + 1);
+  long count = (long)directories.nb_stack + 1;
+  if (n >= count)
+    return -1;
+  return arg[0] == '+' ? n : count - 1 - n;
+}
+
+/**
+ * Prints the list of `dirs`, with `$HOME` written `~`
+ *
+ * @param verbose : `1` to print one entry per line, with its index
+ */
+static void print_dirs(int verbose) {
+  const char *home = get_variable("HOME");
+  size_t home_length = home != NULL && home[0] == '/' && home[1] != '\0'
+                           ? strlen(home)
+                           : 0;
+  for (size_t i = 0; i <= directories.nb_stack; i++) {
+    const char *entry = dirs_entry(i);
+    if (entry == NULL)
+      entry = ".";
+    const char *tilde = "";
+    if (home_length > 0 && strncmp(entry, home, home_length) == 0 &&
+        (entry[home_length] == '/' || entry[home_length] == '\0')) {
+      tilde = "~";
+      entry += home_length;
+    }
+    if (verbose)
+      dprintf(builtin_stdout, "%2zu  %s%s\n", i, tilde, entry);
+    else
+      dprintf(builtin_stdout, "%s%s%s", i > 0 ? " " : "", tilde, entry);
+  }
+  if (!verbose)
+    dprintf(builtin_stdout, "\n");
+}
+
+/**
+ * Inserts `path`, which it takes, at the position `index` of the stack
+ *
+ * @return `0` on success, `-1` on allocation error
+ */
+static int stack_insert(size_t index, char *path) {
+  if (directories.nb_stack == directories.stack_size) {
+    size_t size = directories.stack_size ? 2 * directories.stack_size : 8;
+    char **stack = realloc(directories.stack, size * sizeof(char *));
+    if (stack == NULL)
+      return -1;
+    directories.stack = stack;
+    directories.stack_size = size;
+  }
+  memmove(directories.stack + index + 1, directories.stack + index,
+          (directories.nb_stack - index) * sizeof(char *));
+  directories.stack[index] = path;
+  directories.nb_stack++;
+  return 0;
+}
+
+/**
+ * Removes the entry `index` of the stack
+ *
+ * @return the path removed, to free
+ */
+static char *stack_remove(size_t index) {
+  char *path = directories.stack[index];
+  directories.nb_stack--;
+  memmove(directories.stack + index, directories.stack + index + 1,
+          (directories.nb_stack - index) * sizeof(char *));
+  return path;
+}
+
+int dirs(char **args) {
+  int verbose = 0;
+  for (size_t i = 1; args[i] != NULL; i++) {
+    if (strcmp(args[i], "-c") == 0) {
+      while (directories.nb_stack > 0)
+        free(stack_remove(directories.nb_stack - 1));
+      return EXIT_SUCCESS;
+    } else if (strcmp(args[i], "-v") == 0) {
+      verbose = 1;
+    } else {
+      fprintf(stderr, "jsh: dirs: usage: dirs [-c | -v]\n");
+      return 2;
+    }
+  }
+  print_dirs(verbose);
+  return EXIT_SUCCESS;
+}
+
+int pushd(char **args) {
+  if (args[1] != NULL && args[2] != NULL) {
+    fprintf(stderr, "jsh: pushd: too many arguments\n");
+    return EXIT_FAILURE;
+  }
+  char *old = directories.pwd != NULL ? strdup(directories.pwd)
+                                      : getcwd(NULL, 0);
+  if (old == NULL) {
+    perror("jsh: pushd");
+    return EXIT_FAILURE;
+  }
+
+  // `pushd` swaps the two top directories, `pushd +N` rotates the list to
+  // bring its entry `N` on top. The stack keeps its size : no allocation
+  if (args[1] == NULL || (args[1][0] == '+' || args[1][0] == '-')) {
+    long index = args[1] == NULL ? 1 : dirs_index(args[1]);
+    if (index == -1 || (size_t)index > directories.nb_stack ||
+        directories.nb_stack == 0) {
+      fprintf(stderr, "jsh: pushd: %s\n",
+              directories.nb_stack == 0 ? "no other directory"
+                                        : "directory stack index out of range");
+      free(old);
+      return EXIT_FAILURE;
+    }
+    if (index == 0) {
+      free(old);
+      print_dirs(0);
+      return EXIT_SUCCESS;
+    }
+    const char *target = directories.stack[index - 1];
+    if (change_directory(target, 0)) {
+      fprintf(stderr, "jsh: pushd: %s: %s\n", target, strerror(errno));
+      free(old);
+      return EXIT_FAILURE;
+    }
+    free(stack_remove((size_t)index - 1));
+    if (args[1] == NULL) {
+      stack_insert(0, old);
+    } else {
+      // the entries above `target` go below the previous current directory
+      stack_insert(directories.nb_stack, old);
+      for (long i = 1; i < index; i++)
+        stack_insert(directories.nb_stack, stack_remove(0));
+    }
+  } else {
+    if (cd_path(args[1], 0)) {
+      fprintf(stderr, "jsh: pushd: %s: %s\n", args[1], strerror(errno));
+      free(old);
+      return EXIT_FAILURE;
+    }
+    if (stack_insert(0, old)) {
+      fprintf(stderr, "jsh: allocation error\n");
+      free(old);
+      return EXIT_FAILURE;
+    }
+  }
+  print_dirs(0);
+  return EXIT_SUCCESS;
+}
+
+int popd(char **args) {
+  if (args[1] != NULL && args[2] != NULL) {
+    fprintf(stderr, "jsh: popd: too many arguments\n");
+    return EXIT_FAILURE;
+  }
+  if (directories.nb_stack == 0) {
+    fprintf(stderr, "jsh: popd: directory stack empty\n");
+    return EXIT_FAILURE;
+  }
+  long index = args[1] == NULL ? 0 : dirs_index(args[1]);
+  if (index == -1) {
+    fprintf(stderr, "jsh: popd: %s: invalid argument\n", args[1]);
+    return EXIT_FAILURE;
+  }
+  if (index == 0) {
+    // `popd` leaves the current directory for the top of the stack
+    if (change_directory(directories.stack[0], 0)) {
+      fprintf(stderr, "jsh: popd: %s: %s\n", directories.stack[0],
+              strerror(errno));
+      return EXIT_FAILURE;
+    }
+    index = 1;
+  }
+  free(stack_remove((size_t)index - 1));
+  print_dirs(0);
+  return EXIT_SUCCESS;
+}
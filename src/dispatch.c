@@ -0,0 +1,225 @@
+#include "../head/jsh.h"
+
+#include <dlfcn.h>
+
+#include "../head/builtin_hash.h"
+
+#define BUILTIN(name, func, flags) {name, func, NULL, flags},
+static const ExecutableCommand builtins[] = {
+#include "builtins.def"
+};
+#undef BUILTIN
+
+#define NB_BUILTINS (sizeof(builtins) / sizeof(builtins[0]))
+
+// `1` for the built-ins disabled by `enable -n`, run as external programs
+static int disabled[NB_BUILTINS];
+
+// built-ins of the libraries loaded by `enable -f`, looked up before the
+// others. They are allocated one by one : a running built-in stage keeps a
+// pointer to its entry
+static ExecutableCommand **loaded = NULL;
+static size_t nb_loaded = 0;
+
+// with `enable -f library name...`, the only built-ins to register
+static char **load_names = NULL;
+
+/**
+ * Looks for a built-in command
+ *
+ * @param name : name of the command
+ * @param forking : `0` to also look for the plumbing commands
+ * @return the built-in command or `NULL`
+ */
+const ExecutableCommand *find_builtin(const char *name, int forking) {
+  for (size_t i = 0; i < nb_loaded; i++) {
+    if (strcmp(name, loaded[i]->name) == 0)
+      return loaded[i];
+  }
+  int i = builtin_slots[builtin_hash(name, BUILTIN_HASH_SEED,
+                                     BUILTIN_HASH_BITS)];
+  if (i == -1 || disabled[i] || strcmp(name, builtins[i].name) != 0)
+    return NULL;
+  if (forking && (builtins[i].flags & BUILTIN_STAGE))
+    return NULL;
+  return &builtins[i];
+}
+
+/**
+ * Iterates over the names of the enabled built-ins, for the completion. The
+ * plumbing commands are left out : they are programs of `$PATH` too
+ *
+ * @param position : `0` to start, advanced by each call
+ * @return the next name, `NULL` after the last one
+ */
+const char *next_builtin(size_t *position) {
+  while (*position < nb_loaded + NB_BUILTINS) {
+    size_t i = (*position)++;
+    if (i < nb_loaded)
+      return loaded[i]->name;
+    i -= nb_loaded;
+    if (!disabled[i] && !(builtins[i].flags & BUILTIN_STAGE))
+      return builtins[i].name;
+  }
+  return NULL;
+}
+
+/**
+ * Runs a built-in found by `find_builtin()`, and sets `last_exit_code`
+ *
+ * @param builtin : built-in to run
+ * @param args : command arguments
+ */
+void run_builtin(const ExecutableCommand *builtin, char **args) {
+  if (builtin->loaded == NULL) {
+    last_exit_code = builtin->func(args);
+    return;
+  }
+  int argc = 0;
+  while (args[argc] != NULL)
+    argc++;
+  jsh_io io = {STDIN_FILENO, builtin_stdout, STDERR_FILENO};
+  last_exit_code = builtin->loaded(argc, args, &io);
+}
+
+/**
+ * Removes the loaded built-in `name`
+ *
+ * @return `0` on success, `1` if there is no such built-in
+ */
+static int unload_builtin(const char *name) {
+  for (size_t i = 0; i < nb_loaded; i++) {
+    if (strcmp(name, loaded[i]->name) == 0) {
+      // the library stays loaded : its other built-ins may still be used
+      free(loaded[i]->name);
+      free(loaded[i]);
+      loaded[i] = loaded[--nb_loaded];
+      return 0;
+    }
+  }
+  return 1;
+}
+
+/**
+ * Registers a built-in of a library, on behalf of its `jsh_builtins_init()`.
+ * A built-in of the same name is replaced
+ *
+ * @return `0` on success, `1` on error
+ */
+static int register_builtin(const jsh_builtin *builtin) {
+  if (builtin == NULL || builtin->name == NULL || builtin->func == NULL)
+    return 1;
+  if (load_names != NULL) {
+    size_t i = 0;
+    while (load_names[i] != NULL && strcmp(load_names[i], builtin->name) != 0)
+      i++;
+    if (load_names[i] == NULL)
+      return 0;
+  }
+  ExecutableCommand **tmp =
+      realloc(loaded, (nb_loaded + 1) * sizeof(ExecutableCommand *));
+  if (tmp == NULL)
+    return 1;
+  loaded = tmp;
+  ExecutableCommand *entry = malloc(sizeof(ExecutableCommand));
+  if (entry == NULL || (entry->name = strdup(builtin->name)) == NULL) {
+    free(entry);
+    return 1;
+  }
+  entry->func = NULL;
+  entry->loaded = builtin->func;
+  entry->flags = builtin->flags & JSH_THREADED ? BUILTIN_THREADED : 0;
+  unload_builtin(builtin->name);
+  loaded[nb_loaded++] = entry;
+  return 0;
+}
+
+/**
+ * Loads the built-ins of the library `path`
+ *
+ * @param names : built-ins to register, `NULL`-terminated, all of them if
+ * empty
+ * @return `0` on success, `1` on error with a message
+ */
+static int load_builtins(const char *path, char **names) {
+  void *library = dlopen(path, RTLD_NOW | RTLD_LOCAL);
+  if (library == NULL) {
+    fprintf(stderr, "jsh: enable: %s\n", dlerror());
+    return 1;
+  }
+  int (*init)(int, jsh_register_func);
+  *(void **)&init = dlsym(library, JSH_BUILTINS_INIT);
+  if (init == NULL) {
+    fprintf(stderr, "jsh: enable: %s: no %s function\n", path,
+            JSH_BUILTINS_INIT);
+    dlclose(library);
+    return 1;
+  }
+  size_t before = nb_loaded;
+  load_names = names[0] != NULL ? names : NULL;
+  int error = init(JSH_BUILTIN_VERSION, register_builtin);
+  load_names = NULL;
+  if (error) {
+    fprintf(stderr, "jsh: enable: %s: initialization failed\n", path);
+    return 1;
+  }
+  if (nb_loaded == before && names[0] != NULL) {
+    fprintf(stderr, "jsh: enable: %s: no such built-in in %s\n", names[0],
+            path);
+    return 1;
+  }
+  return 0;
+}
+
+/**
+ * `enable [-n] [name...]` : enables the built-ins `name`, or disables them
+ * with `-n` so that the programs of the same name run instead. Without
+ * names, lists the enabled (or disabled with `-n`) built-ins.
+ * `enable -f library [name...]` loads the built-ins of a library (see
+ * `jsh_builtin.h`), `enable -d name...` removes loaded built-ins
+ *
+ * @param args : command arguments
+ */
+int enable(char **args) {
+  int status = EXIT_SUCCESS;
+  if (args[1] != NULL && strcmp(args[1], "-f") == 0) {
+    if (args[2] == NULL) {
+      fprintf(stderr, "jsh: enable: -f: library expected\n");
+      return 2;
+    }
+    return load_builtins(args[2], args + 3);
+  }
+  if (args[1] != NULL && strcmp(args[1], "-d") == 0) {
+    for (size_t k = 2; args[k] != NULL; k++) {
+      if (unload_builtin(args[k])) {
+        fprintf(stderr, "jsh: enable: %s: not a loaded builtin\n", args[k]);
+        status = EXIT_FAILURE;
+      }
+    }
+    return status;
+  }
+
+  int disable = args[1] != NULL && strcmp(args[1], "-n") == 0;
+  if (args[1 + disable] == NULL) {
+    for (size_t i = 0; !disable && i < nb_loaded; i++)
+      dprintf(builtin_stdout, "enable %s\n", loaded[i]->name);
+    for (size_t i = 0; i < NB_BUILTINS; i++) {
+      if (disabled[i] == disable)
+        dprintf(builtin_stdout, "enable %s%s\n", disable ? "-n " : "",
+                builtins[i].name);
+    }
+    return EXIT_SUCCESS;
+  }
+  for (size_t k = 1 + (size_t)disable; args[k] != NULL; k++) {
+    size_t i = 0;
+    while (i < NB_BUILTINS && strcmp(args[k], builtins[i].name) != 0)
+      i++;
+    if (i == NB_BUILTINS) {
+      fprintf(stderr, "jsh: enable: %s: not a shell builtin\n", args[k]);
+      status = EXIT_FAILURE;
+      continue;
+    }
+    disabled[i] = disable;
+  }
+  return status;
+}
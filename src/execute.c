@@ -1,67 +1,192 @@
 #include "../head/jsh.h"
 
-typedef void (*CommandFunc)();
+#include <time.h>
 
 typedef struct {
-  char *name;
-  CommandFunc func;
-} ExecutableCommand;
+  const ExecutableCommand *builtin;
+  char **args;
+  int fds[2];
+  int status;
+  Shell *shell; // shell of the context running the pipeline
+} BuiltinStage;
 
 /**
- * Executes a command with arguments if not built-in
+ * Replaces the current process by the program `args[0]`
  *
  * @param args command arguments
  */
-void execute_external_command(char **args) {
+void execute_program(char **args) {
+  if (fd_audit != NULL)
+    audit_fds(args);
+  // the environment of the program is the one of the exported variables
+  char **env = variables_environ();
+  if (env != NULL)
+    environ = env;
+  TRACE(TRACE_EXEC, getpid(), 0, args[0]);
+  execvp(args[0], args);
+  perror("jsh: execution error");
+  exit(EXIT_FAILURE);
+}
+
+/**
+ * Puts the calling process in its own process group, in the foreground of
+ * the terminal, as the leader of a new job
+ *
+ * @return 1 on error, 0 otherwise
+ */
+int start_foreground_job(void) {
+  if (setpgid(getpid(), getpid())) {
+    perror("jsh: setgid error");
+    return 1;
+  }
+  TRACE(TRACE_TERMINAL, getpid(), getpid(), NULL);
+  tcsetpgrp(STDIN_FILENO, getpid());
+  tcsetpgrp(STDOUT_FILENO, getpid());
+  tcsetpgrp(STDERR_FILENO, getpid());
+  return 0;
+}
+
+/**
+ * Waits for the leader `pid` of a foreground job to end or stop
+ *
+ * @param status : set to the status of `pid`
+ * @param usage : resources used by `pid`, may be `NULL`
+ * @param release : `1` to let the other contexts of libjsh run meanwhile,
+ * `0` while a thread of the shell still uses the state of the context
+ */
+void wait_leader(pid_t pid, int *status, struct rusage *usage, int release) {
+  int suspended = release ? suspend_context() : 0;
+  do {
+    waitpid_usage(pid, status, WUNTRACED, usage);
+  } while (!WIFEXITED(*status) && !WIFSIGNALED(*status) &&
+           !WIFSTOPPED(*status));
+  resume_context(suspended);
+}
+
+/**
+ * Waits for the foreground process `pid` to end or stop, then gives the
+ * terminal back to the shell. A stopped process becomes a job
+ *
+ * @param pid process to wait for
+ * @param args command line of the job
+ * @param interactive `1` if `pid` leads a job of the shell process
+ * @param perf counters of `pid`, given to its job or closed
+ */
+void wait_foreground(pid_t pid, char **args, int interactive,
+                     PerfCounters *perf) {
+  // called right after the fork : the launch of the job if it stops
+  struct timespec start;
+  clock_gettime(CLOCK_REALTIME, &start);
+  struct rusage usage;
+  memset(&usage, 0, sizeof(usage));
   int status;
-  pid_t pid = fork();
-  if (pid == 0) {
-    // Processus enfant
-    if (setpgid(getpid(), getpid())) {
-      perror("jsh: setgid error");
-      exit(EXIT_FAILURE);
-    }
+  wait_leader(pid, &status, &usage, 1);
+  if (interactive) {
+    TRACE(TRACE_TERMINAL, getpid(), getpid(), NULL);
     tcsetpgrp(STDIN_FILENO, getpid());
     tcsetpgrp(STDOUT_FILENO, getpid());
     tcsetpgrp(STDERR_FILENO, getpid());
+  }
+
+  if (WIFSTOPPED(status)) {
+    // Mise à jour de la liste des jobs
+    char *cmd = get_command2(args);
+    if (cmd == NULL) {
+      perf_free(perf);
+      last_exit_code = EXIT_FAILURE;
+      return;
+    }
+    job_t *new_job = add_job(pid, STOPPED, cmd);
+    new_job->perf = perf;
+    lock_jobs();
+    new_job->start = start;
+    new_job->usage = usage;
+    publish_jobs();
+    unlock_jobs();
+    print_job_details(new_job, STDERR_FILENO);
+    last_exit_code = 128 + WSTOPSIG(status);
+    return;
+  }
+
+  perf_free(perf);
+  if (WIFSIGNALED(status))
+    last_exit_code = 128 + WTERMSIG(status);
+  else
+    last_exit_code = WEXITSTATUS(status);
+}
+
+/**
+ * Runs `func(data)` as a single job, for the built-ins launching several
+ * programs. From the shell, a supervisor process leads the job, so that its
+ * programs are stopped, resumed and killed together. Inside a job (pipeline,
+ * group...), `func()` runs in the current process, in the job's group
+ *
+ * @param args : command line of the job
+ * @param func : function launching and waiting for the programs, returning
+ * the exit code of the job
+ * @param data : argument of `func()`
+ * @return the exit code of the job
+ */
+int run_job(char **args, int (*func)(void *), void *data) {
+  if (getpid() != shell_pid)
+    return func(data);
+  int sync[2];
+  perf_prepare(sync);
+  pid_t pid = fork();
+  if (pid == 0) {
+    perf_child(sync);
+    if (start_foreground_job())
+      exit(EXIT_FAILURE);
     signals(1);
-    if (execvp(args[0], args) == -1) {
-      perror("jsh: execution error");
+    exit(func(data));
+  }
+  PerfCounters *perf = perf_attach(pid, sync);
+  if (pid < 0) {
+    perror("jsh: fork error");
+    return EXIT_FAILURE;
+  }
+  TRACE(TRACE_FORK, pid, 0, args[0]);
+  wait_foreground(pid, args, 1, perf);
+  return last_exit_code;
+}
+
+/**
+ * Executes a command with arguments if not built-in
+ *
+ * @param args command arguments
+ */
+void execute_external_command(char **args) {
+  // inside a job (group, substitution of a background command...), the
+  // command stays in the process group of the job
+  int interactive = getpid() == shell_pid;
+  int sync[2];
+  // the counters are attached before the child runs, so it is forked rather
+  // than launched by the zygote. Inside a job, it is counted with the job
+  if (interactive)
+    perf_prepare(sync);
+  else
+    sync[0] = sync[1] = -1;
+  pid_t pid = sync[0] == -1 ? zygote_launch(args) : -1;
+  if (pid == -1)
+    pid = fork();
+  if (pid == 0) {
+    // Processus enfant
+    perf_child(sync);
+    if (interactive && start_foreground_job())
       exit(EXIT_FAILURE);
-    }
+    signals(1);
+    execute_program(args);
   }
+  PerfCounters *perf = perf_attach(pid, sync);
   if (pid < 0) {
     // Erreur de fork
     perror("jsh: fork error");
     last_exit_code = EXIT_FAILURE;
     return;
-  } else {
-    // Processus parent
-    do {
-      waitpid(pid, &status, WUNTRACED);
-    } while (!WIFEXITED(status) && !WIFSIGNALED(status) && !WIFSTOPPED(status));
-    tcsetpgrp(STDIN_FILENO, getpid());
-    tcsetpgrp(STDOUT_FILENO, getpid());
-    tcsetpgrp(STDERR_FILENO, getpid());
-
-    if (WIFSTOPPED(status)) {
-      // Mise à jour de la liste des jobs
-      char *cmd = get_command2(args);
-      if (cmd == NULL) {
-        last_exit_code = EXIT_FAILURE;
-        return;
-      }
-      job_t *new_job = add_job(pid, STOPPED, cmd);
-      print_job_details(new_job, STDERR_FILENO);
-      last_exit_code = 128 + WSTOPSIG(status);
-      return;
-    }
-
-    if (WIFSIGNALED(status))
-      last_exit_code = 128 + WTERMSIG(status);
-    else
-      last_exit_code = WEXITSTATUS(status);
   }
+  // Processus parent
+  TRACE(TRACE_FORK, pid, 0, args[0]);
+  wait_foreground(pid, args, interactive, perf);
 }
 
 /**
@@ -72,25 +197,93 @@ void execute_external_command(char **args) {
  * command, `0` otherwise
  */
 void execute_command(char **args, int forking) {
-  ExecutableCommand commands[] = {
-      {"exit", jexit},      {"cd", cd},     {"pwd", pwd},
-      {"?", question_mark}, {"jobs", jobs}, {"kill", kill_job},
-      {"fg", fg},           {"bg", bg},     {NULL, NULL} // end marker
-  };
-
-  for (int i = 0; commands[i].name != NULL; i++) {
-    if (strcmp(args[0], commands[i].name) == 0) {
-      commands[i].func(args);
-      return;
-    }
+  // every word expanded to nothing
+  if (args[0] == NULL) {
+    last_exit_code = EXIT_SUCCESS;
+    return;
+  }
+  if (is_assignment(args[0])) {
+    execute_assignments(args, forking);
+    return;
+  }
+  const ExecutableCommand *builtin = find_builtin(args[0], forking);
+  if (builtin != NULL) {
+    run_builtin(builtin, args);
+    return;
+  }
+  // a clear error rather than `E2BIG` from `execvp()`
+  if (check_arg_max(args)) {
+    last_exit_code = 126;
+    return;
   }
   if (forking)
     execute_external_command(args);
-  else {
-    if (execvp(args[0], args) == -1) {
-      perror("jsh: execution error");
-      exit(EXIT_FAILURE);
+  else
+    execute_program(args);
+}
+
+/**
+ * Returns `1` if a command ended with `status` was interrupted from the
+ * terminal (`Ctrl-C`, `Ctrl-\` or `Ctrl-Z`), which also ends the loops
+ */
+static int interrupted(int status) {
+  return status == 128 + SIGINT || status == 128 + SIGQUIT ||
+         status == 128 + SIGTSTP;
+}
+
+/**
+ * Executes the group, conditional or loop `cmd`. Its lists were parsed once
+ * and are executed again at each iteration, without forking for built-ins
+ *
+ * @param cmd : command named `{`, `if`, `while` or `for`
+ * @param substituting : as for `execution()`
+ */
+static void execute_compound(Command *cmd, int substituting) {
+  int status = EXIT_SUCCESS;
+
+  if (strcmp(cmd->name, "if") == 0) {
+    execution(cmd->condition, substituting);
+    if (last_exit_code == 0)
+      execution(cmd->group, substituting);
+    else if (cmd->alternative != NULL && !interrupted(last_exit_code))
+      execution(cmd->alternative, substituting);
+    else if (!interrupted(last_exit_code))
+      last_exit_code = EXIT_SUCCESS;
+  } else if (strcmp(cmd->name, "while") == 0) {
+    while (shell->run) {
+      execution(cmd->condition, substituting);
+      if (last_exit_code != 0) {
+        if (interrupted(last_exit_code))
+          status = last_exit_code;
+        break;
+      }
+      execution(cmd->group, substituting);
+      status = last_exit_code;
+      if (interrupted(status))
+        break;
     }
+    last_exit_code = status;
+  } else if (strcmp(cmd->name, "for") == 0) {
+    // the words are expanded once, then the variable is bound for each one
+    Argument *var = cmd->arguments;
+    char **words = expand_arguments(var->next);
+    if (words == NULL)
+      status = EXIT_FAILURE;
+    for (size_t i = 0; words != NULL && words[i] != NULL && shell->run; i++) {
+      if (set_variable(var->value, words[i], 0)) {
+        fprintf(stderr, "jsh: allocation error\n");
+        status = EXIT_FAILURE;
+        break;
+      }
+      execution(cmd->group, substituting);
+      status = last_exit_code;
+      if (interrupted(status))
+        break;
+    }
+    free_full_command(words);
+    last_exit_code = status;
+  } else {
+    execution(cmd->group, substituting);
   }
 }
 
@@ -124,11 +317,17 @@ int handle_command_redirections(Command *cmd, int forking) {
         close(STDOUT_FILENO);
         exit(REDIRECT_ERROR);
       }
+      // group, conditional or loop execution
+      if (cmd->group != NULL) {
+        execute_compound(cmd, 1);
+        exit(last_exit_code);
+      }
       // command execution
       char **args = get_full_command(cmd);
       if (args == NULL) {
         exit(EXIT_FAILURE);
       }
+      inherit_substitutions(cmd, 1);
       execute_command(args, forking);
       exit(last_exit_code);
     }
@@ -143,6 +342,7 @@ int handle_command_redirections(Command *cmd, int forking) {
     }
 
     // parent process
+    TRACE(TRACE_FORK, pid, 0, cmd->name);
     close(cmd->pipe[1]);
     if (dup2(cmd->pipe[0], STDIN_FILENO) == -1) {
       perror("jsh: dup2 error");
@@ -150,8 +350,8 @@ int handle_command_redirections(Command *cmd, int forking) {
       last_exit_code = EXIT_FAILURE;
       return 1;
     }
-    int status;
-    waitpid(pid, &status, WUNTRACED | WNOHANG);
+    int status = 0;
+    jsh_waitpid(pid, &status, WUNTRACED | WNOHANG);
     if (WIFEXITED(status) && WEXITSTATUS(status) == REDIRECT_ERROR) {
       close(STDIN_FILENO);
       close(cmd->pipe[0]);
@@ -162,6 +362,17 @@ int handle_command_redirections(Command *cmd, int forking) {
     return 0;
   }
 
+  // we are in the case `{ cmd1 ; ... }`, `if ...`, `while ...` or `for ...`
+  if (cmd->group != NULL) {
+    if (apply_redirections(cmd->redirection)) {
+      last_exit_code = EXIT_FAILURE;
+      return 1;
+    }
+    // the shell itself forks the pipelines of the construct as jobs
+    execute_compound(cmd, !forking);
+    return 0;
+  }
+
   // we are in the case `cmd`
   char **args = get_full_command(cmd);
   if (args == NULL) {
@@ -171,12 +382,15 @@ int handle_command_redirections(Command *cmd, int forking) {
   // redirections settings
   if (apply_redirections(cmd->redirection)) {
     close(STDIN_FILENO);
+    free_full_command(args);
     last_exit_code = EXIT_FAILURE;
     return 1;
   }
   // command execution
+  inherit_substitutions(cmd, 1);
   execute_command(args, forking);
-  free(args);
+  inherit_substitutions(cmd, 0);
+  free_full_command(args);
   return 0;
 }
 
@@ -191,11 +405,13 @@ int handle_command_redirections(Command *cmd, int forking) {
  */
 int handle_piped_commands(Command *commands, int forking) {
   Command *i = NULL;
-  for (i = commands; i->next != NULL; i = i->next) {
-    if (pipe(i->pipe) == -1) {
+  for (i = commands; i->pipe != NULL; i = i->next) {
+    if (pipe2(i->pipe, O_CLOEXEC) == -1) {
       perror("jsh: pipe error");
       return 1;
     }
+    if (pipe_size > 0)
+      fcntl(i->pipe[1], F_SETPIPE_SZ, pipe_size);
     if (handle_command_redirections(i, 0))
       return 1;
   }
@@ -205,129 +421,269 @@ int handle_piped_commands(Command *commands, int forking) {
 }
 
 /**
- * Executes a list of commands
+ * Body of the thread running a built-in stage : the built-in writes in the
+ * pipe instead of the standard output of the shell
  *
- * @param commands : list of commands
+ * @param arg : the `BuiltinStage` to run, freed at the end
  */
-void execution(Command *commands , int substituting) {
-  // we save the beginning of the command we want to execute each time in
-  // `start`
-  Command *i = commands;
-  Command *start = commands;
-  int status ; 
-  int has_pipe = 0 ; 
-
-  while (i != NULL) {
-    // we are in the case : `cmdi & ...` OR `cmd1 | ... | cmdi &`
-    if (i->background) {
-      pid_t pid = fork();
-
-      // child process executes the command `start`
-      if (!pid) {
-        i->next = NULL;
-        if (setpgid(getpid(), getpid())) {
-          perror("jsh: setgid error");
-          exit(EXIT_FAILURE);
-        }
-        signals(1);
-        for (Command * j = start ; j != NULL ; j = j->next) {
-          for (size_t k = 0 ; k < j->nb_substitutions ; k++) {
-            execution(j->substitutions[k] , 1);
-          }
-        }
-        if (handle_piped_commands(start, 0))
-          exit(last_exit_code);
-        exit(last_exit_code);
-      }
+static void *run_builtin_stage(void *arg) {
+  BuiltinStage *stage = arg;
+  sigset_t set;
+
+  // a closed pipe is reported to the built-in by `EPIPE`, the shell must not
+  // receive `SIGPIPE`
+  sigemptyset(&set);
+  sigaddset(&set, SIGPIPE);
+  pthread_sigmask(SIG_BLOCK, &set, NULL);
 
-      // fork error
-      if (pid == -1) {
-        perror("jsh: error fork");
-        last_exit_code = 1;
-        return;
+  shell = stage->shell;
+  last_exit_code = stage->status;
+  builtin_stdout = stage->fds[1];
+  run_builtin(stage->builtin, stage->args);
+  close(stage->fds[1]);
+
+  for (size_t i = 0; stage->args[i] != NULL; i++)
+    free(stage->args[i]);
+  free(stage->args);
+  free(stage);
+  return NULL;
+}
+
+/**
+ * Checks if the first stage of a pipeline is a built-in which can run on a
+ * thread of the shell rather than in a forked copy of it, and prepares its
+ * pipe
+ *
+ * @param cmd : first command of the pipeline
+ * @return the stage to start with `start_builtin_stage()` once the rest of the
+ * pipeline is forked, `NULL` if `cmd` has to be forked
+ */
+static BuiltinStage *prepare_builtin_stage(Command *cmd) {
+  const ExecutableCommand *builtin = find_builtin(cmd->name, 1);
+  if (builtin == NULL || !(builtin->flags & BUILTIN_THREADED) || cmd->redirection != NULL ||
+      cmd->nb_substitutions != 0)
+    return NULL;
+
+  BuiltinStage *stage = malloc(sizeof(BuiltinStage));
+  // the expanded words are copies : the command may be cleared while the
+  // thread still runs
+  char **args = get_full_command(cmd);
+  if (stage == NULL || args == NULL || args[0] == NULL ||
+      pipe2(stage->fds, O_CLOEXEC) == -1) {
+    free(stage);
+    free_full_command(args);
+    return NULL;
+  }
+  stage->args = args;
+  stage->builtin = builtin;
+  stage->status = last_exit_code;
+  stage->shell = shell;
+  return stage;
+}
+
+/**
+ * Starts the thread of a built-in stage, or runs the built-in directly if the
+ * thread cannot be created
+ *
+ * @param stage : stage prepared by `prepare_builtin_stage()`
+ * @param thread : set to the thread running the stage
+ * @return `1` if the stage runs on `thread`, `0` if it is already over
+ */
+static int start_builtin_stage(BuiltinStage *stage, pthread_t *thread) {
+  close(stage->fds[0]);
+  if (pthread_create(thread, NULL, run_builtin_stage, stage) == 0)
+    return 1;
+  int status = last_exit_code;
+  run_builtin_stage(stage);
+  last_exit_code = status;
+  return 0;
+}
+
+/**
+ * Executes the substitutions of the commands of a pipeline
+ *
+ * @param start : first command of the pipeline
+ */
+static void execute_substitutions(Command *start) {
+  for (Command *j = start; j != NULL; j = j->pipe != NULL ? j->next : NULL) {
+    for (size_t k = 0; k < j->nb_substitutions; k++) {
+      if (open_substitution(j, k) == 0)
+        execution(j->substitutions[k], 1);
+    }
+  }
+}
+
+/**
+ * Executes a pipeline `cmd1 | ... | cmdn` in the foreground, or in the
+ * background if `cmdn` is followed by `&`
+ *
+ * @param start : first command of the pipeline
+ * @param end : last command of the pipeline
+ * @param substituting : `1` if the pipeline runs in a job (substitution,
+ * group in a pipe...) rather than in the interactive shell, `0` otherwise
+ */
+static void execute_pipeline(Command *start, Command *end, int substituting) {
+  int status;
+
+  // we are in the case : `cmd &` OR `cmd1 | ... | cmdn &`
+  if (end->background) {
+    int sync[2];
+    perf_prepare(sync);
+    pid_t pid = fork();
+
+    // child process executes the command `start`
+    if (!pid) {
+      perf_child(sync);
+      if (setpgid(getpid(), getpid())) {
+        perror("jsh: setgid error");
+        exit(EXIT_FAILURE);
       }
+      signals(1);
+      execute_substitutions(start);
+      handle_piped_commands(start, 0);
+      exit(last_exit_code);
+    }
+
+    PerfCounters *perf = perf_attach(pid, sync);
+    // fork error
+    if (pid == -1) {
+      perror("jsh: error fork");
+      last_exit_code = 1;
+      return;
+    }
+
+    // parent process
+    TRACE(TRACE_FORK, pid, 0, start->name);
+    char *cmd = get_command(start);
+    // malloc error
+    if (cmd == NULL) {
+      perf_free(perf);
+      last_exit_code = EXIT_FAILURE;
+      return;
+    }
+    job_t *new_job = add_job(pid, RUNNING, cmd);
+    new_job->perf = perf;
+    print_job_details(new_job, STDERR_FILENO);
+    last_exit_code = EXIT_SUCCESS;
+    return;
+  }
+
+  // we are in the case : `cmd` OR `cmd1 | ... | cmdn`
+  execute_substitutions(start);
+  if (start == end || substituting) {
+    int SAVE_STDOUT, SAVE_STDIN, SAVE_STDERR;
+    if (save_redirections(&SAVE_STDOUT, &SAVE_STDIN, &SAVE_STDERR))
+      goto error_redirection;
+    handle_piped_commands(start, 1);
+    if (reset_redirections(SAVE_STDOUT, SAVE_STDIN, SAVE_STDERR))
+      goto error_redirection;
+    return;
+  }
 
-      // parent process
-      Command *tmp = i->next;
-      // end marker for `get_command()`
-      i->next = NULL;
-      char *cmd = get_command(start);
-      i->next = tmp;
-      // malloc error
-      if (cmd == NULL) {
-        last_exit_code = EXIT_FAILURE;
-        return;
+  // a leading built-in such as `jobs` runs on a thread of the shell and sees
+  // its real state, the rest of the pipeline reads its pipe
+  BuiltinStage *stage = prepare_builtin_stage(start);
+  pthread_t thread;
+  int threaded = 0;
+  int sync[2];
+  perf_prepare(sync);
+  struct timespec launch;
+  clock_gettime(CLOCK_REALTIME, &launch);
+  struct rusage usage;
+  memset(&usage, 0, sizeof(usage));
+  pid_t pid = fork();
+  PerfCounters *perf = pid != 0 ? perf_attach(pid, sync) : NULL;
+  switch (pid) {
+  case 0:
+    perf_child(sync);
+    setpgid(getpid(), getpid());
+    TRACE(TRACE_TERMINAL, getpid(), getpid(), NULL);
+    tcsetpgrp(STDIN_FILENO, getpid());
+    tcsetpgrp(STDOUT_FILENO, getpid());
+    tcsetpgrp(STDERR_FILENO, getpid());
+    signals(1);
+    if (stage != NULL) {
+      close(stage->fds[1]);
+      if (dup2(stage->fds[0], STDIN_FILENO) == -1) {
+        perror("jsh: dup2 error");
+        exit(EXIT_FAILURE);
       }
-      job_t *new_job = add_job(pid, RUNNING, cmd);
+      close(stage->fds[0]);
+    }
+    handle_piped_commands(stage != NULL ? start->next : start, 0);
+    exit(last_exit_code);
+  case -1:
+    perror("jsh: error fork");
+    // without reader, the built-in stops at its first write
+    if (stage != NULL && start_builtin_stage(stage, &thread))
+      pthread_join(thread, NULL);
+    last_exit_code = 1;
+    return;
+
+  default:
+    TRACE(TRACE_FORK, pid, 0, start->name);
+    if (stage != NULL)
+      threaded = start_builtin_stage(stage, &thread);
+    wait_leader(pid, &status, &usage, !threaded);
+    TRACE(TRACE_TERMINAL, getpid(), getpid(), NULL);
+    tcsetpgrp(STDIN_FILENO, getpid());
+    tcsetpgrp(STDOUT_FILENO, getpid());
+    tcsetpgrp(STDERR_FILENO, getpid());
+    if (WIFSTOPPED(status)) {
+      // the thread ends on its own once the pipe is drained
+      if (threaded)
+        pthread_detach(thread);
+      // Update the job state
+      job_t *new_job = add_job(pid, STOPPED, get_command(start));
+      new_job->perf = perf;
+      lock_jobs();
+      new_job->start = launch;
+      new_job->usage = usage;
+      publish_jobs();
+      unlock_jobs();
       print_job_details(new_job, STDERR_FILENO);
-      waitpid(pid, RUNNING, WNOHANG);
-      // we update `i` and `start` by assigning them the next command to execute
-      i = tmp;
-      start = i;
-      continue;
-    } else { // we are in the case : `cmdi | cmdj ... ` OR `... cmdi`
-      // we are in the case : `... cmdi` then we have to execute `cmdi` then
-      // exit the loop
-      if (i->pipe == NULL) {
-        for (Command * j = start ; j != NULL ; j = j->next) {
-          for (size_t k = 0 ; k < j->nb_substitutions ; k++) {
-            execution(j->substitutions[k] , 1);
-          }
-        }
-        if (!has_pipe || has_pipe && substituting) {
-          int SAVE_STDOUT, SAVE_STDIN, SAVE_STDERR;
-          if (save_redirections(&SAVE_STDOUT, &SAVE_STDIN, &SAVE_STDERR))
-            goto error_redirection;
-          handle_piped_commands(start, 1);
-          if (reset_redirections(SAVE_STDOUT, SAVE_STDIN, SAVE_STDERR))
-            goto error_redirection;
-          return;
-        } else {
-          pid_t pid = fork();
-          switch(pid) {
-            case 0: 
-              setpgid(getpid(), getpid());
-              tcsetpgrp(STDIN_FILENO, getpid());
-              tcsetpgrp(STDOUT_FILENO, getpid());
-              tcsetpgrp(STDERR_FILENO, getpid());
-              signals(1);
-              handle_piped_commands(start, 0);
-              exit(last_exit_code);
-            case -1:
-              perror("jsh: error fork");
-              last_exit_code = 1;
-              return;
-
-            default:
-              do {
-                waitpid(pid, &status, WUNTRACED);
-              }while (!WIFEXITED(status) && !WIFSIGNALED(status) && !WIFSTOPPED(status));
-              tcsetpgrp(STDIN_FILENO, getpid());
-              tcsetpgrp(STDOUT_FILENO, getpid());
-              tcsetpgrp(STDERR_FILENO, getpid());
-              if (WIFSTOPPED(status)) {
-                // Update the job state
-                job_t *new_job = add_job(pid, STOPPED, get_command(start));
-                print_job_details(new_job, STDERR_FILENO);
-                last_exit_code = 128 + WSTOPSIG(status);
-                return;
-              }
-              if (WIFSIGNALED(status))
-                last_exit_code = 128 + WTERMSIG(status);
-              else
-                last_exit_code = WEXITSTATUS(status);
-          }
-        }
-      }else has_pipe = 1 ;
-      // otherwise we are in the case : `cmdi | cmdj ...` then we continue the
-      // loop until we each the last command
+      last_exit_code = 128 + WSTOPSIG(status);
+      return;
     }
-    i = i->next;
+    if (threaded)
+      pthread_join(thread, NULL);
+    perf_free(perf);
+    if (WIFSIGNALED(status))
+      last_exit_code = 128 + WTERMSIG(status);
+    else
+      last_exit_code = WEXITSTATUS(status);
   }
   return;
 
 error_redirection:
   free_job_list();
-  char *err[1] = {"3"};
-  jexit(err);
-}
\ No newline at end of file
+  char *err[] = {"exit", "3", NULL};
+  last_exit_code = jexit(err);
+}
+
+/**
+ * Executes a list of pipelines separated by `;`, `&`, `&&` or `||`. The
+ * pipeline following `&&` (resp. `||`) is skipped if `last_exit_code` is not
+ * (resp. is) `0`
+ *
+ * @param commands : list of commands
+ * @param substituting : `1` if the list runs in a job rather than in the
+ * interactive shell, `0` otherwise
+ */
+void execution(Command *commands, int substituting) {
+  RedirectionType connector = SEQUENCE;
+  Command *start = commands;
+
+  while (start != NULL && shell->run != 0) {
+    Command *end = start;
+    while (end->pipe != NULL)
+      end = end->next;
+
+    if (connector == SEQUENCE || connector == AND && last_exit_code == 0 ||
+        connector == OR && last_exit_code != 0)
+      execute_pipeline(start, end, substituting);
+
+    connector = end->background ? SEQUENCE : end->connector;
+    start = end->next;
+  }
+}
@@ -0,0 +1,527 @@
+#include "../head/jsh.h"
+
+#define GLOB_BUFFER_SIZE (1 << 20)
+#define GLOB_CACHE_SIZE 256
+
+typedef enum { P_CHAR, P_ANY, P_STAR, P_CLASS } PatternOp;
+
+typedef struct {
+  PatternOp op;
+  unsigned char c;          // P_CHAR : character to match
+  unsigned char class[32];  // P_CLASS : bitmap of the matching characters
+} PatternToken;
+
+// component of a path pattern, between two `/`
+typedef struct {
+  char *literal;        // the component itself if it has no wildcard
+  PatternToken *tokens; // compiled pattern otherwise
+  size_t len;
+  int recursive;        // `**`
+  int dot;              // `1` if the pattern starts with `.`
+} Component;
+
+// names of a directory, read with `getdents64`, kept for one command line as
+// long as the directory is not modified
+typedef struct Listing {
+  char *path;
+  struct timespec mtime;
+  dev_t dev;
+  ino_t ino;
+  char *names;           // names separated by `\0`
+  char **entries;        // pointers into `names`
+  unsigned char *types;  // `d_type` of the entries
+  size_t count;
+  struct Listing *next;
+} Listing;
+
+static Listing *cache[GLOB_CACHE_SIZE];
+
+typedef struct {
+  char ***words;
+  size_t *position;
+  size_t *size;
+  int directories; // `1` if the pattern ends with `/`
+  int error;
+} GlobResult;
+
+/**
+ * Returns `1` if `word` holds `*`, `?` or `[`, `0` otherwise
+ */
+int has_glob(const char *word) {
+  for (size_t i = 0; word[i] != '\0'; i++) {
+    if (word[i] == '\\' && word[i + 1] != '\0')
+      i++;
+    else if (word[i] == '*' || word[i] == '?' || word[i] == '[')
+      return 1;
+  }
+  return 0;
+}
+
+/**
+ * Frees the directory listings read for the last command line
+ */
+void clear_glob_cache(void) {
+  for (size_t i = 0; i < GLOB_CACHE_SIZE; i++) {
+    while (cache[i] != NULL) {
+      Listing *next = cache[i]->next;
+      free(cache[i]->path);
+      free(cache[i]->names);
+      free(cache[i]->entries);
+      free(cache[i]->types);
+      free(cache[i]);
+      cache[i] = next;
+    }
+  }
+}
+
+static size_t hash_path(const char *path) {
+  size_t hash = 5381;
+  for (size_t i = 0; path[i] != '\0'; i++)
+    hash = hash * 33 + (unsigned char)path[i];
+  return hash % GLOB_CACHE_SIZE;
+}
+
+/**
+ * Reads the names of the directory `fd` with `getdents64` into `listing`
+ *
+ * @return `0` on success, `1` on error
+ */
+static int fill_listing(Listing *listing, int fd) {
+  size_t size = GLOB_BUFFER_SIZE;
+  size_t used = 0;
+  size_t capacity = 0;
+  char *buffer = malloc(GLOB_BUFFER_SIZE);
+  char *names = malloc(size);
+  listing->count = 0;
+  listing->types = NULL;
+  if (buffer == NULL || names == NULL)
+    goto error;
+
+  ssize_t nread;
+  while ((nread = getdents64(fd, buffer, GLOB_BUFFER_SIZE)) > 0) {
+    for (ssize_t off = 0; off < nread;) {
+      struct dirent64 *d = (struct dirent64 *)(void *)(buffer + off);
+      off += d->d_reclen;
+      if (strcmp(d->d_name, ".") == 0 || strcmp(d->d_name, "..") == 0)
+        continue;
+      size_t len = strlen(d->d_name) + 1;
+      if (used + len > size) {
+        size *= 2;
+        char *tmp = realloc(names, size);
+        if (tmp == NULL)
+          goto error;
+        names = tmp;
+      }
+      if (listing->count == capacity) {
+        capacity = capacity ? capacity * 2 : 1024;
+        unsigned char *types = realloc(listing->types, capacity);
+        if (types == NULL)
+          goto error;
+        listing->types = types;
+      }
+      memcpy(names + used, d->d_name, len);
+      listing->types[listing->count++] = d->d_type;
+      used += len;
+    }
+  }
+  if (nread == -1)
+    goto error;
+
+  // the names may have moved while growing the buffer
+  listing->entries = malloc((listing->count + 1) * sizeof(char *));
+  if (listing->entries == NULL)
+    goto error;
+  char *name = names;
+  for (size_t i = 0; i < listing->count; i++) {
+    listing->entries[i] = name;
+    name += strlen(name) + 1;
+  }
+  listing->names = names;
+  free(buffer);
+  return 0;
+error:
+  free(buffer);
+  free(names);
+  free(listing->types);
+  return 1;
+}
+
+/**
+ * Returns the listing of the directory `path`, from the cache if the directory
+ * did not change since it was read
+ *
+ * @param path : directory, `""` for the current one
+ * @return the listing, `NULL` if the directory cannot be read
+ */
+static Listing *read_listing(const char *path) {
+  int fd = open(*path ? path : ".", O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+  struct stat st;
+  if (fd == -1)
+    return NULL;
+  if (fstat(fd, &st) == -1) {
+    close(fd);
+    return NULL;
+  }
+
+  size_t index = hash_path(path);
+  Listing **prev = &cache[index];
+  for (Listing *l = *prev; l != NULL; prev = &l->next, l = *prev) {
+    if (strcmp(l->path, path) != 0)
+      continue;
+    if (l->dev == st.st_dev && l->ino == st.st_ino &&
+        l->mtime.tv_sec == st.st_mtim.tv_sec &&
+        l->mtime.tv_nsec == st.st_mtim.tv_nsec) {
+      close(fd);
+      return l;
+    }
+    // modified since : read again
+    *prev = l->next;
+    free(l->path);
+    free(l->names);
+    free(l->entries);
+    free(l->types);
+    free(l);
+    break;
+  }
+
+  Listing *listing = malloc(sizeof(Listing));
+  if (listing == NULL || (listing->path = strdup(path)) == NULL) {
+    free(listing);
+    close(fd);
+    return NULL;
+  }
+  if (fill_listing(listing, fd)) {
+    free(listing->path);
+    free(listing);
+    close(fd);
+    return NULL;
+  }
+  close(fd);
+  listing->mtime = st.st_mtim;
+  listing->dev = st.st_dev;
+  listing->ino = st.st_ino;
+  listing->next = cache[index];
+  cache[index] = listing;
+  return listing;
+}
+
+/**
+ * Compiles the component `pattern` of `len` characters
+ *
+ * @return `0` on success, `1` on allocation error
+ */
+static int compile_component(Component *comp, const char *pattern,
+                             size_t len) {
+  comp->literal = NULL;
+  comp->tokens = NULL;
+  comp->len = 0;
+  comp->recursive = len == 2 && strncmp(pattern, "**", 2) == 0;
+  comp->dot = pattern[0] == '.';
+
+  int wildcard = 0;
+  for (size_t i = 0; i < len; i++) {
+    if (pattern[i] == '\\' && i + 1 < len)
+      i++;
+    else if (pattern[i] == '*' || pattern[i] == '?' || pattern[i] == '[')
+      wildcard = 1;
+  }
+  if (!wildcard) {
+    comp->literal = malloc(len + 1);
+    if (comp->literal == NULL)
+      return 1;
+    size_t j = 0;
+    for (size_t i = 0; i < len; i++) {
+      if (pattern[i] == '\\' && i + 1 < len)
+        i++;
+      comp->literal[j++] = pattern[i];
+    }
+    comp->literal[j] = '\0';
+    return 0;
+  }
+
+  comp->tokens = calloc(len, sizeof(PatternToken));
+  if (comp->tokens == NULL)
+    return 1;
+  for (size_t i = 0; i < len; i++) {
+    PatternToken *t = &comp->tokens[comp->len];
+    if (pattern[i] == '*') {
+      // `**` inside a component is `*`
+      if (comp->len > 0 && t[-1].op == P_STAR)
+        continue;
+      t->op = P_STAR;
+    } else if (pattern[i] == '?') {
+      t->op = P_ANY;
+    } else if (pattern[i] == '[') {
+      size_t j = i + 1;
+      int negate = j < len && (pattern[j] == '!' || pattern[j] == '^');
+      if (negate)
+        j++;
+      // `]` first is a character of the class
+      size_t end = j + (j < len && pattern[j] == ']');
+      while (end < len && pattern[end] != ']')
+        end++;
+      if (end >= len) {
+        t->op = P_CHAR;
+        t->c = '[';
+      } else {
+        t->op = P_CLASS;
+        for (; j < end; j++) {
+          unsigned char first = (unsigned char)pattern[j];
+          unsigned char last = first;
+          if (j + 2 < end && pattern[j + 1] == '-') {
+            last = (unsigned char)pattern[j + 2];
+            j += 2;
+          }
+          for (unsigned c = first; c <= last; c++)
+            t->class[c / 8] |= (unsigned char)(1 << (c % 8));
+        }
+        if (negate) {
+          for (size_t k = 0; k < sizeof(t->class); k++)
+            t->class[k] = (unsigned char)~t->class[k];
+        }
+        i = end;
+      }
+    } else {
+      if (pattern[i] == '\\' && i + 1 < len)
+        i++;
+      t->op = P_CHAR;
+      t->c = (unsigned char)pattern[i];
+    }
+    comp->len++;
+  }
+  return 0;
+}
+
+/**
+ * Returns `1` if `name` matches the compiled component `comp`, `0` otherwise.
+ * `*` backtracks to its last position only, without recursion
+ */
+static int match_component(const Component *comp, const char *name) {
+  if (name[0] == '.' && !comp->dot)
+    return 0;
+  const PatternToken *p = comp->tokens;
+  size_t pi = 0;
+  size_t star = 0;
+  const char *star_name = NULL;
+  while (*name != '\0') {
+    unsigned char c = (unsigned char)*name;
+    if (pi < comp->len && p[pi].op == P_STAR) {
+      star = ++pi;
+      star_name = name;
+      continue;
+    }
+    if (pi < comp->len &&
+        (p[pi].op == P_ANY || (p[pi].op == P_CHAR && p[pi].c == c) ||
+         (p[pi].op == P_CLASS && p[pi].class[c / 8] & (1 << (c % 8))))) {
+      pi++;
+      name++;
+      continue;
+    }
+    if (star_name == NULL)
+      return 0;
+    pi = star;
+    name = ++star_name;
+  }
+  while (pi < comp->len && p[pi].op == P_STAR)
+    pi++;
+  return pi == comp->len;
+}
+
+/**
+ * Appends a copy of `path` to the words
+ */
+static void add_match(GlobResult *result, const char *path) {
+  if (*result->position + 1 >= *result->size) {
+    size_t size = *result->size * 2;
+    char **tmp = realloc(*result->words, size * sizeof(char *));
+    if (tmp == NULL) {
+      result->error = 1;
+      return;
+    }
+    *result->words = tmp;
+    *result->size = size;
+  }
+  char *copy = strdup(path);
+  if (copy == NULL) {
+    result->error = 1;
+    return;
+  }
+  (*result->words)[(*result->position)++] = copy;
+}
+
+/**
+ * Returns `1` if the entry `i` of `listing` is a directory
+ *
+ * @param follow : `1` to follow symbolic links
+ */
+static int is_directory(Listing *listing, size_t i, const char *path,
+                        int follow) {
+  unsigned char type = listing->types[i];
+  if (type == DT_DIR)
+    return 1;
+  if (type != DT_UNKNOWN && (type != DT_LNK || !follow))
+    return 0;
+  struct stat st;
+  if ((follow ? stat(path, &st) : lstat(path, &st)) == -1)
+    return 0;
+  return S_ISDIR(st.st_mode);
+}
+
+/**
+ * Joins `dir` and `name` into `path`
+ *
+ * @return `1` if the path is too long, `0` otherwise
+ */
+static int join_path(char *path, const char *dir, const char *name) {
+  int len;
+  if (*dir == '\0')
+    len = snprintf(path, PATH_MAX, "%s", name);
+  else if (dir[strlen(dir) - 1] == '/')
+    len = snprintf(path, PATH_MAX, "%s%s", dir, name);
+  else
+    len = snprintf(path, PATH_MAX, "%s/%s", dir, name);
+  return len < 0 || len >= PATH_MAX;
+}
+
+/**
+ * Matches the components `comps[i..n-1]` under the directory `dir`
+ *
+ * @param literal : `1` if the last component added to `dir` was not checked
+ */
+static void glob_dir(GlobResult *result, const char *dir, Component *comps,
+                     size_t i, size_t n, int literal) {
+  char path[PATH_MAX];
+  if (result->error)
+    return;
+  if (i == n) {
+    struct stat st;
+    if (result->directories) {
+      // `dir/*/` : directories only, with their `/`
+      if (stat(dir, &st) == 0 && S_ISDIR(st.st_mode) &&
+          join_path(path, dir, "") == 0)
+        add_match(result, path);
+    } else if (!literal || lstat(dir, &st) == 0) {
+      add_match(result, dir);
+    }
+    return;
+  }
+
+  Component *comp = &comps[i];
+  if (comp->literal != NULL) {
+    if (join_path(path, dir, comp->literal) == 0)
+      glob_dir(result, path, comps, i + 1, n, 1);
+    return;
+  }
+
+  // only the listings of the subdirectories are read by the recursive calls,
+  // this one stays in the cache
+  Listing *listing = read_listing(dir);
+  if (listing == NULL)
+    return;
+  if (comp->recursive) {
+    // `**` matches no directory, or any directory and its subdirectories
+    glob_dir(result, dir, comps, i + 1, n, 0);
+    for (size_t j = 0; j < listing->count; j++) {
+      if (listing->entries[j][0] == '.' ||
+          join_path(path, dir, listing->entries[j]) ||
+          !is_directory(listing, j, path, 0))
+        continue;
+      glob_dir(result, path, comps, i, n, 0);
+    }
+    return;
+  }
+  for (size_t j = 0; j < listing->count; j++) {
+    if (!match_component(comp, listing->entries[j]) ||
+        join_path(path, dir, listing->entries[j]))
+      continue;
+    if (i + 1 < n && !is_directory(listing, j, path, 1))
+      continue;
+    glob_dir(result, path, comps, i + 1, n, 0);
+  }
+}
+
+static int compare_words(const void *a, const void *b) {
+  return strcmp(*(char *const *)a, *(char *const *)b);
+}
+
+/**
+ * Expands the pattern `pattern` (`*`, `?`, `[...]` and `**`) into the paths
+ * matching it, sorted, appended to `*words`
+ *
+ * @param words : array of words, reallocated if needed
+ * @param position : number of words in the array
+ * @param size : size of the array
+ * @return the number of paths appended, `-1` on allocation error
+ */
+int glob_word(const char *pattern, char ***words, size_t *position,
+              size_t *size) {
+  size_t n = 0;
+  size_t len = strlen(pattern);
+  Component *comps = calloc(len / 2 + 2, sizeof(Component));
+  if (comps == NULL)
+    return -1;
+
+  int error = 0;
+  for (size_t i = 0; i < len && !error;) {
+    size_t end = i;
+    while (end < len && pattern[end] != '/')
+      end++;
+    if (end > i) {
+      error = compile_component(&comps[n], pattern + i, end - i);
+      n++;
+    }
+    i = end + 1;
+  }
+  // `dir/**` is `dir/**/*`
+  if (!error && n > 0 && comps[n - 1].recursive)
+    error = compile_component(&comps[n++], "*", 1);
+
+  size_t start = *position;
+  if (!error) {
+    GlobResult result = {words, position, size,
+                         len > 1 && pattern[len - 1] == '/', 0};
+    glob_dir(&result, pattern[0] == '/' ? "/" : "", comps, 0, n, 0);
+    error = result.error;
+  }
+  for (size_t i = 0; i < n; i++) {
+    free(comps[i].literal);
+    free(comps[i].tokens);
+  }
+  free(comps);
+  if (error)
+    return -1;
+  qsort(*words + start, *position - start, sizeof(char *), compare_words);
+  return (int)(*position - start);
+}
+
+/**
+ * Checks that the arguments and the environment of a program fit in
+ * `ARG_MAX`, rather than letting `execvp()` fail with `E2BIG`
+ *
+ * @return `0` if they fit, `1` otherwise, with an error message
+ */
+int check_arg_max(char **args) {
+  long limit = sysconf(_SC_ARG_MAX);
+  // longest single argument accepted by Linux
+  size_t max_strlen = (size_t)sysconf(_SC_PAGESIZE) * 32;
+  size_t total = 0;
+  size_t count = 0;
+  for (size_t i = 0; args[i] != NULL; i++, count++) {
+    size_t len = strlen(args[i]) + 1;
+    if (len > max_strlen) {
+      fprintf(stderr, "jsh: %s: argument %zu too long (%zu bytes, limit %zu)\n",
+              args[0], i, len, max_strlen);
+      return 1;
+    }
+    total += len + sizeof(char *);
+  }
+  total += environ_size();
+  if (limit > 0 && total > (size_t)limit) {
+    fprintf(stderr,
+            "jsh: %s: argument list too long (%zu arguments, %zu bytes with "
+            "the environment, limit %ld)\n",
+            args[0], count, total, limit);
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,551 @@
+#include "../head/jsh.h"
+
+#include <ctype.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+
+/*
+ * The history is the append-only file `$JSH_HISTFILE` (`~/.jsh_history` by
+ * default), one command per line, with `\` and new lines written `\\` and
+ * `\n`. Each shell appends its commands under `flock()`, and maps the file
+ * when it starts : the entries point into the mapping, so that the history
+ * costs the page cache rather than a copy in each shell. Only the entries
+ * added since the file was mapped are copies, until the next reload.
+ *
+ * A command typed again replaces its previous entry. Beyond twice
+ * `$JSH_HISTSIZE` lines, the file is rewritten with the `$JSH_HISTSIZE` most
+ * recent distinct commands.
+ */
+
+#define DEFAULT_HISTORY_SIZE 10000
+// entries kept by readline, for the arrows and `Ctrl-R`
+#define READLINE_HISTORY 1000
+// copies of new entries before the file is mapped again
+#define HISTORY_RELOAD 1024
+
+typedef struct {
+  char *text; // escaped, as in the file, read-only in the mapping
+  uint32_t length;
+  uint32_t hash;
+  int owned;   // `text` is a copy, not in the mapping
+  int removed; // typed again since
+} HistoryEntry;
+
+static char *history_path = NULL;
+static int history_fd = -1;
+static char *map = NULL;
+static size_t map_size = 0;
+static size_t history_size = DEFAULT_HISTORY_SIZE;
+
+// entries, from the oldest
+static HistoryEntry *entries = NULL;
+static size_t nb_entries = 0;
+static size_t entries_size = 0;
+static size_t nb_live = 0;
+static size_t nb_owned = 0;
+
+// hash table of the live entries : index + 1, `0` for an empty slot
+static uint32_t *slots = NULL;
+static size_t slots_size = 0;
+
+// live entries sorted by text, for the prefix searches, built on demand
+static uint32_t *sorted = NULL;
+static size_t nb_sorted = 0;
+static int sorted_dirty = 1;
+
+static uint32_t hash_text(const char *text, size_t length) {
+  uint32_t hash = 2166136261u;
+  for (size_t i = 0; i < length; i++) {
+    hash ^= (unsigned char)text[i];
+    hash *= 16777619u;
+  }
+  return hash;
+}
+
+/**
+ * Returns the slot of the live entry `text`, or the empty slot where it
+ * would go
+ */
+static uint32_t *find_slot(const char *text, size_t length, uint32_t hash) {
+  size_t mask = slots_size - 1;
+  for (size_t i = hash & mask;; i = (i + 1) & mask) {
+    if (slots[i] == 0)
+      return &slots[i];
+    HistoryEntry *entry = &entries[slots[i] - 1];
+    if (entry->hash == hash && entry->length == length &&
+        memcmp(entry->text, text, length) == 0)
+      return &slots[i];
+  }
+}
+
+/**
+ * Rebuilds the hash table for `size` entries
+ *
+ * @return `0` on success, `-1` on allocation error
+ */
+static int rebuild_slots(size_t size) {
+  size_t new_size = 64;
+  while (new_size < 2 * size)
+    new_size *= 2;
+  uint32_t *new_slots = calloc(new_size, sizeof(uint32_t));
+  if (new_slots == NULL)
+    return -1;
+  free(slots);
+  slots = new_slots;
+  slots_size = new_size;
+  for (size_t i = 0; i < nb_entries; i++) {
+    if (!entries[i].removed)
+      *find_slot(entries[i].text, entries[i].length, entries[i].hash) =
+          (uint32_t)i + 1;
+  }
+  return 0;
+}
+
+/**
+ * Adds the entry `text`, escaped, and removes its previous occurrence
+ *
+ * @param owned : `1` if `text` is a copy to free with the entry
+ * @return `0` on success, `-1` on allocation error
+ */
+static int index_entry(char *text, size_t length, int owned) {
+  if (nb_entries == entries_size) {
+    size_t size = entries_size ? 2 * entries_size : 1024;
+    HistoryEntry *new_entries = realloc(entries, size * sizeof(HistoryEntry));
+    if (new_entries == NULL)
+      return -1;
+    entries = new_entries;
+    entries_size = size;
+  }
+  if (2 * (nb_entries + 1) > slots_size && rebuild_slots(nb_entries + 1))
+    return -1;
+  uint32_t hash = hash_text(text, length);
+  uint32_t *slot = find_slot(text, length, hash);
+  if (*slot != 0) {
+    HistoryEntry *previous = &entries[*slot - 1];
+    previous->removed = 1;
+    if (previous->owned) {
+      free(previous->text);
+      previous->owned = 0;
+      nb_owned--;
+    }
+    nb_live--;
+  }
+  entries[nb_entries] =
+      (HistoryEntry){text, (uint32_t)length, hash, owned, 0};
+  *slot = (uint32_t)++nb_entries;
+  nb_live++;
+  nb_owned += (size_t)owned;
+  sorted_dirty = 1;
+  return 0;
+}
+
+/**
+ * Keeps only the `history_size` most recent live entries
+ */
+static void compact_entries(void) {
+  size_t skip = nb_live > history_size ? nb_live - history_size : 0;
+  size_t kept = 0;
+  for (size_t i = 0; i < nb_entries; i++) {
+    if (entries[i].removed)
+      continue;
+    if (skip > 0) {
+      skip--;
+      if (entries[i].owned) {
+        free(entries[i].text);
+        nb_owned--;
+      }
+      continue;
+    }
+    entries[kept++] = entries[i];
+  }
+  nb_entries = kept;
+  nb_live = kept;
+  sorted_dirty = 1;
+  rebuild_slots(nb_entries);
+}
+
+/**
+ * Forgets all the entries and unmaps the file
+ */
+static void clear_entries(void) {
+  for (size_t i = 0; i < nb_entries; i++) {
+    if (entries[i].owned)
+      free(entries[i].text);
+  }
+  nb_entries = 0;
+  nb_live = 0;
+  nb_owned = 0;
+  sorted_dirty = 1;
+  if (slots != NULL)
+    memset(slots, 0, slots_size * sizeof(uint32_t));
+  if (map != NULL)
+    munmap(map, map_size);
+  map = NULL;
+  map_size = 0;
+}
+
+/**
+ * Opens the history file and locks it, reopening it when it was replaced
+ * by another shell while waiting for the lock
+ *
+ * @return `0` on success, `-1` on error
+ */
+static int lock_history(void) {
+  for (;;) {
+    if (history_fd == -1)
+      history_fd = open(history_path, O_RDWR | O_APPEND | O_CREAT | O_CLOEXEC,
+                        0600);
+    if (history_fd == -1 || flock(history_fd, LOCK_EX) == -1)
+      return -1;
+    struct stat opened, current;
+    if (fstat(history_fd, &opened) == 0 && stat(history_path, &current) == 0 &&
+        opened.st_dev == current.st_dev && opened.st_ino == current.st_ino)
+      return 0;
+    close(history_fd);
+    history_fd = -1;
+  }
+}
+
+static void unlock_history(void) { flock(history_fd, LOCK_UN); }
+
+/**
+ * Replaces the file by the live entries, while it is locked
+ *
+ * @return `0` on success, `-1` on error
+ */
+static int rewrite_history(void) {
+  size_t length = strlen(history_path);
+  char *tmp = malloc(length + 8);
+  if (tmp == NULL)
+    return -1;
+  snprintf(tmp, length + 8, "%s.XXXXXX", history_path);
+  int fd = mkostemp(tmp, O_CLOEXEC);
+  if (fd == -1) {
+    free(tmp);
+    return -1;
+  }
+  FILE *file = fdopen(fd, "w");
+  int error = file == NULL;
+  for (size_t i = 0; i < nb_entries && !error; i++) {
+    error = fwrite(entries[i].text, 1, entries[i].length, file) !=
+                entries[i].length ||
+            fputc('\n', file) == EOF;
+  }
+  if (file != NULL)
+    error |= fclose(file) == EOF;
+  else
+    close(fd);
+  if (error || rename(tmp, history_path) == -1) {
+    unlink(tmp);
+    error = 1;
+  }
+  free(tmp);
+  return error ? -1 : 0;
+}
+
+/**
+ * Maps the history file again and indexes its entries. The file is
+ * rewritten when it holds more than twice `history_size` lines
+ *
+ * @return `0` on success, `-1` on error
+ */
+static int load_history(void) {
+  clear_entries();
+  if (lock_history())
+    return -1;
+  struct stat st;
+  if (fstat(history_fd, &st) == -1) {
+    unlock_history();
+    return -1;
+  }
+  if (st.st_size > 0) {
+    map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, history_fd,
+               0);
+    if (map == MAP_FAILED) {
+      map = NULL;
+      unlock_history();
+      return -1;
+    }
+    map_size = (size_t)st.st_size;
+  }
+  size_t lines = 0;
+  for (char *line = map; line != NULL && line < map + map_size;) {
+    char *end = memchr(line, '\n', (size_t)(map + map_size - line));
+    // a line without its `\n` is being written by another shell
+    if (end == NULL)
+      break;
+    if (end > line && index_entry(line, (size_t)(end - line), 0)) {
+      unlock_history();
+      return -1;
+    }
+    lines++;
+    line = end + 1;
+  }
+  int rewrite = lines > 2 * history_size;
+  if (rewrite) {
+    compact_entries();
+    rewrite = rewrite_history() == 0;
+  }
+  unlock_history();
+  // the entries point into the old file : map the new one
+  return rewrite ? load_history() : 0;
+}
+
+/**
+ * Escapes a command for the file : `\` and new lines become `\\` and `\n`
+ *
+ * @return the escaped copy, to free, `NULL` on allocation error
+ */
+static char *escape(const char *line, size_t *length) {
+  char *escaped = malloc(2 * strlen(line) + 1);
+  if (escaped == NULL)
+    return NULL;
+  size_t n = 0;
+  for (const char *c = line; *c != '\0'; c++) {
+    if (*c == '\\' || *c == '\n')
+      escaped[n++] = '\\';
+    escaped[n++] = *c == '\n' ? 'n' : *c;
+  }
+  escaped[n] = '\0';
+  *length = n;
+  return escaped;
+}
+
+/**
+ * Writes an entry of the file as it was typed
+ */
+static void print_entry(int fd, size_t number, const HistoryEntry *entry) {
+  char *line = malloc((size_t)entry->length + 1);
+  if (line == NULL)
+    return;
+  size_t n = 0;
+  for (size_t i = 0; i < entry->length; i++) {
+    char c = entry->text[i];
+    if (c == '\\' && i + 1 < entry->length) {
+      c = entry->text[++i];
+      if (c == 'n')
+        c = '\n';
+    }
+    line[n++] = c;
+  }
+  line[n] = '\0';
+  dprintf(fd, "%5zu  %s\n", number, line);
+  free(line);
+}
+
+/**
+ * Loads the history : maps `$JSH_HISTFILE` and gives its most recent entries
+ * to readline. An empty `$JSH_HISTFILE` keeps the history in memory only
+ */
+void open_history(void) {
+  stifle_history(READLINE_HISTORY);
+  const char *size = get_variable("JSH_HISTSIZE");
+  if (size != NULL && atol(size) > 0)
+    history_size = (size_t)atol(size);
+  const char *path = get_variable("JSH_HISTFILE");
+  const char *home = get_variable("HOME");
+  if (path != NULL) {
+    history_path = *path != '\0' ? strdup(path) : NULL;
+  } else if (home != NULL) {
+    history_path = malloc(strlen(home) + sizeof("/.jsh_history"));
+    if (history_path != NULL)
+      sprintf(history_path, "%s/.jsh_history", home);
+  }
+  if (history_path == NULL)
+    return;
+  if (load_history()) {
+    fprintf(stderr, "jsh: %s: %s\n", history_path, strerror(errno));
+    clear_entries();
+    free(history_path);
+    history_path = NULL;
+    return;
+  }
+  size_t start = 0;
+  for (size_t i = nb_entries, count = 0; i > 0 && count < READLINE_HISTORY;
+       i--) {
+    if (!entries[i - 1].removed) {
+      start = i - 1;
+      count++;
+    }
+  }
+  for (size_t i = start; i < nb_entries; i++) {
+    if (entries[i].removed)
+      continue;
+    char *line = strndup(entries[i].text, entries[i].length);
+    if (line == NULL)
+      break;
+    // unescape in place
+    size_t n = 0;
+    for (size_t j = 0; line[j] != '\0'; j++) {
+      if (line[j] == '\\' && line[j + 1] != '\0')
+        line[n++] = line[++j] == 'n' ? '\n' : line[j];
+      else
+        line[n++] = line[j];
+    }
+    line[n] = '\0';
+    add_history(line);
+    free(line);
+  }
+}
+
+/**
+ * Adds a command line to the history and appends it to the file, in a
+ * single `write()`
+ */
+void history_add(const char *line) {
+  if (*line == '\0')
+    return;
+  add_history(line);
+  if (history_path == NULL)
+    return;
+  size_t length;
+  char *escaped = escape(line, &length);
+  if (escaped == NULL)
+    return;
+  // the text of the last entry is written again : nothing to do
+  if (nb_entries > 0 && !entries[nb_entries - 1].removed &&
+      entries[nb_entries - 1].length == length &&
+      memcmp(entries[nb_entries - 1].text, escaped, length) == 0) {
+    free(escaped);
+    return;
+  }
+  if (lock_history() == 0) {
+    escaped[length] = '\n';
+    if (write(history_fd, escaped, length + 1) != (ssize_t)(length + 1))
+      perror("jsh: history");
+    escaped[length] = '\0';
+    unlock_history();
+  }
+  if (index_entry(escaped, length, 1)) {
+    free(escaped);
+    return;
+  }
+  if (nb_owned >= HISTORY_RELOAD || nb_entries > 2 * history_size)
+    load_history();
+}
+
+static int compare_sorted(const void *a, const void *b) {
+  const HistoryEntry *entry_a = &entries[*(const uint32_t *)a];
+  const HistoryEntry *entry_b = &entries[*(const uint32_t *)b];
+  size_t length =
+      entry_a->length < entry_b->length ? entry_a->length : entry_b->length;
+  int order = memcmp(entry_a->text, entry_b->text, length);
+  if (order != 0)
+    return order;
+  return (entry_a->length > entry_b->length) -
+         (entry_a->length < entry_b->length);
+}
+
+static int compare_index(const void *a, const void *b) {
+  uint32_t index_a = *(const uint32_t *)a;
+  uint32_t index_b = *(const uint32_t *)b;
+  return (index_a > index_b) - (index_a < index_b);
+}
+
+/**
+ * Prints the entries starting with the escaped `prefix`, from the oldest.
+ * They are found by a binary search in the entries sorted by text
+ *
+ * @return the number of entries printed
+ */
+static size_t print_prefix(const char *prefix, size_t length) {
+  if (sorted_dirty) {
+    uint32_t *new_sorted = realloc(sorted, (nb_live + 1) * sizeof(uint32_t));
+    if (new_sorted == NULL)
+      return 0;
+    sorted = new_sorted;
+    nb_sorted = 0;
+    for (size_t i = 0; i < nb_entries; i++) {
+      if (!entries[i].removed)
+        sorted[nb_sorted++] = (uint32_t)i;
+    }
+    qsort(sorted, nb_sorted, sizeof(uint32_t), compare_sorted);
+    sorted_dirty = 0;
+  }
+  size_t low = 0, high = nb_sorted;
+  while (low < high) {
+    size_t middle = low + (high - low) / 2;
+    const HistoryEntry *entry = &entries[sorted[middle]];
+    size_t n = entry->length < length ? entry->length : length;
+    int order = memcmp(entry->text, prefix, n);
+    if (order < 0 || (order == 0 && entry->length < length))
+      low = middle + 1;
+    else
+      high = middle;
+  }
+  size_t end = low;
+  while (end < nb_sorted && entries[sorted[end]].length >= length &&
+         memcmp(entries[sorted[end]].text, prefix, length) == 0)
+    end++;
+  uint32_t *matches = malloc((end - low + 1) * sizeof(uint32_t));
+  if (matches == NULL)
+    return 0;
+  memcpy(matches, sorted + low, (end - low) * sizeof(uint32_t));
+  qsort(matches, end - low, sizeof(uint32_t), compare_index);
+  for (size_t i = 0; i < end - low; i++)
+    print_entry(builtin_stdout, matches[i] + 1, &entries[matches[i]]);
+  free(matches);
+  return end - low;
+}
+
+int history(char **args) {
+  if (args[1] != NULL && strcmp(args[1], "-c") == 0) {
+    clear_history();
+    clear_entries();
+    // the file is replaced by an empty one, not truncated : the other
+    // shells keep their entries in their mapping of the old one
+    if (history_path != NULL && lock_history() == 0) {
+      if (rewrite_history() == -1)
+        perror("jsh: history");
+      unlock_history();
+    }
+    return EXIT_SUCCESS;
+  }
+  if (args[1] != NULL &&
+      (strcmp(args[1], "-p") == 0 || strcmp(args[1], "-s") == 0)) {
+    if (args[2] == NULL || args[3] != NULL) {
+      fprintf(stderr, "jsh: history: usage: history [-c | -p prefix | "
+                      "-s text | N]\n");
+      return 2;
+    }
+    size_t length;
+    char *pattern = escape(args[2], &length);
+    if (pattern == NULL) {
+      fprintf(stderr, "jsh: allocation error\n");
+      return EXIT_FAILURE;
+    }
+    size_t found = 0;
+    if (args[1][1] == 'p') {
+      found = print_prefix(pattern, length);
+    } else {
+      for (size_t i = 0; i < nb_entries; i++) {
+        if (!entries[i].removed &&
+            memmem(entries[i].text, entries[i].length, pattern, length)) {
+          print_entry(builtin_stdout, i + 1, &entries[i]);
+          found++;
+        }
+      }
+    }
+    free(pattern);
+    return found > 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+  }
+  size_t count = nb_live;
+  if (args[1] != NULL) {
+    if (!isdigit((unsigned char)args[1][0]) || args[2] != NULL) {
+      fprintf(stderr, "jsh: history: usage: history [-c | -p prefix | "
+                      "-s text | N]\n");
+      return 2;
+    }
+    count = (size_t)atol(args[1]);
+  }
+  size_t skip = nb_live > count ? nb_live - count : 0;
+  for (size_t i = 0; i < nb_entries; i++) {
+    if (entries[i].removed)
+      continue;
+    if (skip > 0)
+      skip--;
+    else
+      print_entry(builtin_stdout, i + 1, &entries[i]);
+  }
+  return EXIT_SUCCESS;
+}
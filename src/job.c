@@ -1,5 +1,16 @@
 #include "../head/jsh.h"
 
+#include <time.h>
+
+// the job list is also read by the built-in stages of pipelines running on
+// their own thread (see `start_builtin_stage()`), and by `jsh_job_next()` and
+// `jsh_wait()` while another context runs
+static pthread_mutex_t job_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+void lock_jobs(void) { pthread_mutex_lock(&job_mutex); }
+
+void unlock_jobs(void) { pthread_mutex_unlock(&job_mutex); }
+
 /**
  * Adds a job to the job list
  *
@@ -14,61 +25,81 @@ job_t *add_job(pid_t pid, job_state state, char *command) {
     fprintf(stderr, "jsh: allocation error\n");
     exit(EXIT_FAILURE);
   }
-  njob++;
-  new_job->age = idjob++;
+  lock_jobs();
+  shell->njob++;
+  new_job->age = shell->idjob++;
+  unlock_jobs();
   new_job->pid = pid;
   new_job->command = command;
   new_job->state = state;
+  new_job->perf = NULL;
+  clock_gettime(CLOCK_REALTIME, &new_job->start);
+  memset(&new_job->usage, 0, sizeof(new_job->usage));
   new_job->next = NULL;
+  TRACE(TRACE_JOB, pid, state, command);
   add_job_list(new_job);
   return new_job;
 }
 
 void add_job_list(job_t *job) {
-  if (job_list == NULL) {
-    job_list = job;
+  lock_jobs();
+  if (shell->job_list == NULL) {
+    shell->job_list = job;
+    publish_jobs();
+    unlock_jobs();
     return;
   }
-  job_t *last_job = job_list;
+  job_t *last_job = shell->job_list;
   while (last_job->next != NULL) {
     last_job = last_job->next;
   }
   last_job->next = job;
+  publish_jobs();
+  unlock_jobs();
 }
 
 void remove_job(pid_t pid) {
-  job_t *current_job = job_list;
+  lock_jobs();
+  job_t *current_job = shell->job_list;
   job_t *previous_job = NULL;
 
   while (current_job != NULL) {
     if (current_job->pid == pid) {
       if (previous_job == NULL) {
-        job_list = current_job->next;
+        shell->job_list = current_job->next;
       } else {
         previous_job->next = current_job->next;
       }
-      if (current_job->age == idjob - 1)
-        idjob--;
+      if (current_job->age == shell->idjob - 1)
+        shell->idjob--;
+      board_ended(current_job);
       free(current_job->command);
+      perf_free(current_job->perf);
       free(current_job);
       break;
     }
     previous_job = current_job;
     current_job = current_job->next;
   }
-  njob--;
+  shell->njob--;
+  publish_jobs();
+  unlock_jobs();
 }
 
 void update_job(pid_t pid, job_state state) {
-  job_t *current_job = job_list;
+  lock_jobs();
+  job_t *current_job = shell->job_list;
 
   while (current_job != NULL) {
     if (current_job->pid == pid) {
       current_job->state = state;
-      return;
+      TRACE(TRACE_JOB, pid, state, current_job->command);
+      break;
     }
     current_job = current_job->next;
   }
+  publish_jobs();
+  unlock_jobs();
 }
 
 
@@ -96,7 +127,7 @@ void print_process_tree(pid_t pid, int fdout, int indent) {
     char buffer[256];
     snprintf(buffer, sizeof(buffer), "/proc/%d/task/%d/status", pid, pid);
 
-    FILE *statusFile = fopen(buffer, "r");
+    FILE *statusFile = fopen(buffer, "re");
     if (statusFile == NULL) {
         return;
     }
@@ -128,13 +159,16 @@ void print_process_tree(pid_t pid, int fdout, int indent) {
  * @param fdout file descriptor to print to
  */
 void check_jobs(int print, int fdout) {
-  job_t *current_job = job_list;
+  lock_jobs();
+  job_t *current_job = shell->job_list;
   job_t *previous_job = NULL;
   int status;
+  int changed = 0;
 
   while (current_job != NULL) {
-    switch (
-        waitpid(current_job->pid, &status, WNOHANG | WUNTRACED | WCONTINUED)) {
+    switch (waitpid_usage(current_job->pid, &status,
+                          WNOHANG | WUNTRACED | WCONTINUED,
+                          &current_job->usage)) {
     case 0:
       if (print)
         print_job_details(current_job, fdout);
@@ -171,41 +205,55 @@ void check_jobs(int print, int fdout) {
     }
     }
   next_print:
+    TRACE(TRACE_JOB, current_job->pid, current_job->state,
+          current_job->command);
     print_job_details(current_job, fdout);
+    changed = 1;
   next:
     previous_job = current_job;
     current_job = current_job->next;
     continue;
   remove_print:
+    TRACE(TRACE_JOB, current_job->pid, current_job->state,
+          current_job->command);
     print_job_details(current_job, fdout);
+    print_perf_counters(current_job->perf, fdout);
   remove:
+    board_ended(current_job);
+    changed = 1;
     if (previous_job == NULL) {
-      job_list = job_list->next;
-      if (current_job->age == idjob - 1)
-        idjob--;
+      shell->job_list = shell->job_list->next;
+      if (current_job->age == shell->idjob - 1)
+        shell->idjob--;
       free(current_job->command);
+      perf_free(current_job->perf);
       free(current_job);
-      current_job = job_list;
-      njob--;
+      current_job = shell->job_list;
+      shell->njob--;
       continue;
     }
     previous_job->next = current_job->next;
-    if (current_job->age == idjob - 1)
-      idjob--;
+    if (current_job->age == shell->idjob - 1)
+      shell->idjob--;
     free(current_job->command);
+    perf_free(current_job->perf);
     free(current_job);
     current_job = previous_job->next;
-    njob--;
+    shell->njob--;
   }
+  if (changed)
+    publish_jobs();
+  unlock_jobs();
 }
 
 void free_job_list() {
-  job_t *current_job = job_list;
+  job_t *current_job = shell->job_list;
   job_t *next_job;
 
   while (current_job != NULL) {
     next_job = current_job->next;
     free(current_job->command);
+    perf_free(current_job->perf);
     free(current_job);
     current_job = next_job;
   }
@@ -0,0 +1,360 @@
+#include "../head/jsh.h"
+
+#include "../head/libjsh.h"
+
+// jobs of the programs using the shell without a context (`jsh_bench`)
+static Shell no_context = {NULL, 0, 1, 1};
+
+// state of the context used by the thread, read and changed by the rest of
+// the shell
+_Thread_local int last_exit_code = EXIT_SUCCESS;
+_Thread_local int builtin_stdout = STDOUT_FILENO;
+_Thread_local Shell *shell = &no_context;
+pid_t shell_pid;
+char *fd_audit = NULL;
+int pipe_size = 0;
+
+struct jsh_ctx {
+  Shell shell;
+  // saved while another context is active
+  Variables variables;
+  Directories directories;
+  int cwd; // descriptor of the current directory
+  // kept here : `last_exit_code` is per thread
+  int last_exit_code;
+  char *command; // copy of the command of the job returned by `jsh_job_next()`
+};
+
+struct jsh_script {
+  Command *commands;
+};
+
+_Static_assert(JSH_JOB_RUNNING == (int)RUNNING &&
+                   JSH_JOB_STOPPED == (int)STOPPED &&
+                   JSH_JOB_DONE == (int)DONE &&
+                   JSH_JOB_KILLED == (int)KILLED &&
+                   JSH_JOB_DETACHED == (int)DETACHED,
+               "the states of libjsh.h are the ones of job_state");
+
+// the commands run in the process : the contexts take turns, and a context
+// lets the others run while it waits for a foreground job
+static pthread_mutex_t ctx_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+// context whose variables, directories and current directory are the ones of
+// the process
+static jsh_ctx *active = NULL;
+
+// context entered by the thread, which holds `ctx_mutex`
+static _Thread_local jsh_ctx *entered = NULL;
+
+// descriptors of the thread while it waits for a foreground job
+static _Thread_local int suspended_fds[3];
+
+// number of calls of `jsh_run()` running, the first one saves the standard
+// descriptors and the handling of the signals of the host, the last one
+// restores them
+static int nb_running = 0;
+static int host_fds[3];
+
+// signals ignored by the shell, restored in its children. Without `SIGPIPE`,
+// a built-in writing to an ended coprocess or pipe gets `EPIPE` instead of
+// killing the shell
+static const int shell_signals[] = {SIGINT,  SIGTERM, SIGTTIN, SIGQUIT,
+                                    SIGTTOU, SIGTSTP, SIGPIPE};
+
+#define NB_SHELL_SIGNALS (sizeof(shell_signals) / sizeof(shell_signals[0]))
+
+static struct sigaction host_signals[NB_SHELL_SIGNALS];
+
+/**
+ * Ignores or resets a set of signals
+ *
+ * @param mode : `0` to ignore the signals, `1` to reset them
+ */
+void signals(int mode) {
+  struct sigaction sa;
+
+  // Set up the signal handler to ignore the signals
+  sa.sa_handler = mode ? SIG_DFL : SIG_IGN;
+  sigemptyset(&sa.sa_mask);
+  sa.sa_flags = 0;
+
+  // Set the signal handler for each signal in the array
+  for (size_t i = 0; i < NB_SHELL_SIGNALS; i++) {
+    sigaction(shell_signals[i], &sa, NULL);
+  }
+}
+
+/**
+ * Moves the state of the active context out of the process, and the state of
+ * `ctx` in. Nothing is moved when `ctx` is already active, as for the `jsh`
+ * frontend and its single context
+ */
+static void switch_context(jsh_ctx *ctx) {
+  if (active == ctx)
+    return;
+  if (active != NULL) {
+    if (active->cwd != -1)
+      close(active->cwd);
+    active->cwd = open(".", O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+  }
+  switch_variables(active != NULL ? &active->variables : NULL,
+                   &ctx->variables);
+  switch_directories(active != NULL ? &active->directories : NULL,
+                     &ctx->directories);
+  if (ctx->cwd != -1 && fchdir(ctx->cwd) == -1)
+    perror("jsh: fchdir error");
+  active = ctx;
+}
+
+/**
+ * Starts a call of the API with the context `ctx`. The thread keeps using
+ * the jobs of `ctx` after the call : the frontend reads them for its prompt
+ */
+static void enter(jsh_ctx *ctx) {
+  pthread_mutex_lock(&ctx_mutex);
+  switch_context(ctx);
+  shell = &ctx->shell;
+  entered = ctx;
+  last_exit_code = ctx->last_exit_code;
+  shell_pid = getpid();
+}
+
+/**
+ * Ends a call of the API with the context `ctx`
+ */
+static void leave(jsh_ctx *ctx) {
+  ctx->last_exit_code = last_exit_code;
+  entered = NULL;
+  pthread_mutex_unlock(&ctx_mutex);
+}
+
+/**
+ * Lets the other contexts run while the thread waits for a foreground job :
+ * the standard descriptors of the host are restored until
+ * `resume_context()`. Only the thread of a call of the API in the shell
+ * process releases the contexts
+ *
+ * @return `1` if the contexts were released, `0` otherwise
+ */
+int suspend_context(void) {
+  if (entered == NULL || getpid() != shell_pid)
+    return 0;
+  for (int fd = 0; fd < 3; fd++) {
+    suspended_fds[fd] = fcntl(fd, F_DUPFD_CLOEXEC, 3);
+    if (suspended_fds[fd] == -1) {
+      while (fd-- > 0)
+        close(suspended_fds[fd]);
+      return 0;
+    }
+  }
+  // a descriptor closed by the host stays closed
+  for (int fd = 0; fd < 3; fd++) {
+    if (host_fds[fd] == -1)
+      close(fd);
+    else
+      dup2(host_fds[fd], fd);
+  }
+  pthread_mutex_unlock(&ctx_mutex);
+  return 1;
+}
+
+/**
+ * Takes the contexts back after `suspend_context()`, with the state and the
+ * descriptors of the context of the thread
+ *
+ * @param suspended : result of `suspend_context()`
+ */
+void resume_context(int suspended) {
+  if (!suspended)
+    return;
+  pthread_mutex_lock(&ctx_mutex);
+  switch_context(entered);
+  for (int fd = 0; fd < 3; fd++) {
+    dup2(suspended_fds[fd], fd);
+    close(suspended_fds[fd]);
+  }
+}
+
+jsh_ctx *jsh_new(void) {
+  jsh_ctx *ctx = calloc(1, sizeof(jsh_ctx));
+  if (ctx == NULL)
+    return NULL;
+  ctx->shell.idjob = 1;
+  ctx->shell.run = 1;
+  ctx->variables.envp_dirty = 1;
+  ctx->cwd = open(".", O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+  if (ctx->cwd == -1) {
+    free(ctx);
+    return NULL;
+  }
+  enter(ctx);
+  init_variables();
+  init_directories();
+  leave(ctx);
+  return ctx;
+}
+
+void jsh_free(jsh_ctx *ctx) {
+  if (ctx == NULL)
+    return;
+  enter(ctx);
+  free_job_list();
+  clear_variables();
+  clear_directories();
+  shell = &no_context;
+  active = NULL;
+  entered = NULL;
+  pthread_mutex_unlock(&ctx_mutex);
+  if (ctx->cwd != -1)
+    close(ctx->cwd);
+  free(ctx->command);
+  free(ctx);
+}
+
+int jsh_parse(jsh_ctx *ctx, const char *line, jsh_script **script) {
+  (void)ctx;
+  jsh_script *new_script = malloc(sizeof(jsh_script));
+  // `parse_command()` cuts the line it parses
+  char *copy = strdup(line);
+  if (new_script == NULL || copy == NULL) {
+    free(new_script);
+    free(copy);
+    return JSH_NO_MEMORY;
+  }
+  // the words are expanded when they run : the parsing does not need the
+  // state of the context
+  errno = 0;
+  int incomplete;
+  TRACE(TRACE_PARSE_BEGIN, shell_pid, 0, NULL);
+  new_script->commands = parse_command(copy, &incomplete);
+  TRACE(TRACE_PARSE_END, shell_pid, 0, NULL);
+  int error = errno;
+  free(copy);
+  if (incomplete || error != 0) {
+    clear_command(new_script->commands);
+    free(new_script);
+    return incomplete       ? JSH_INCOMPLETE
+           : error == ENOMEM ? JSH_NO_MEMORY
+                             : JSH_SYNTAX_ERROR;
+  }
+  *script = new_script;
+  return JSH_OK;
+}
+
+int jsh_run(jsh_ctx *ctx, jsh_script *script) {
+  enter(ctx);
+  // the host of the library may handle the signals of job control
+  if (nb_running++ == 0) {
+    for (size_t i = 0; i < NB_SHELL_SIGNALS; i++)
+      sigaction(shell_signals[i], NULL, &host_signals[i]);
+    for (int fd = 0; fd < 3; fd++)
+      host_fds[fd] = fcntl(fd, F_DUPFD_CLOEXEC, 3);
+  }
+  signals(0);
+  // the children exit with `exit()` : the buffers of the host are written
+  // once, not once per child
+  fflush(NULL);
+  execution(script->commands, 0);
+  clear_glob_cache();
+  if (--nb_running == 0) {
+    for (size_t i = 0; i < NB_SHELL_SIGNALS; i++)
+      sigaction(shell_signals[i], &host_signals[i], NULL);
+    for (int fd = 0; fd < 3; fd++) {
+      if (host_fds[fd] != -1)
+        close(host_fds[fd]);
+    }
+  }
+  int status = last_exit_code;
+  leave(ctx);
+  return status;
+}
+
+void jsh_script_free(jsh_script *script) {
+  if (script == NULL)
+    return;
+  clear_command(script->commands);
+  free(script);
+}
+
+// the following calls only read or wait for the jobs of the context : they
+// run while another context runs its commands. They leave `shell` as they
+// found it, and `jsh_job_next()` reads the jobs of `ctx` without it
+
+int jsh_wait(jsh_ctx *ctx, int id, int *status) {
+  // `remove_job()` and `update_job()` act on the jobs of `shell`
+  Shell *saved = shell;
+  shell = &ctx->shell;
+  pid_t pid = -1;
+  lock_jobs();
+  for (job_t *job = shell->job_list; job != NULL; job = job->next) {
+    if (job->age == id)
+      pid = job->pid;
+  }
+  unlock_jobs();
+  int wstatus;
+  pid_t waited = -1;
+  while (pid != -1 && (waited = jsh_waitpid(pid, &wstatus, WUNTRACED)) == -1 &&
+         errno == EINTR)
+    ;
+  if (waited == -1) {
+    // reaped by someone else : the job is gone
+    if (pid != -1)
+      remove_job(pid);
+  } else if (WIFSTOPPED(wstatus)) {
+    update_job(pid, STOPPED);
+    ctx->last_exit_code = 128 + WSTOPSIG(wstatus);
+  } else {
+    remove_job(pid);
+    ctx->last_exit_code = WIFSIGNALED(wstatus) ? 128 + WTERMSIG(wstatus)
+                                               : WEXITSTATUS(wstatus);
+  }
+  shell = saved;
+  if (waited == -1)
+    return -1;
+  *status = ctx->last_exit_code;
+  return 0;
+}
+
+int jsh_job_next(jsh_ctx *ctx, int id, jsh_job *job) {
+  lock_jobs();
+  job_t *next = NULL;
+  for (job_t *current = ctx->shell.job_list; current != NULL;
+       current = current->next) {
+    if (current->age > id && (next == NULL || current->age < next->age))
+      next = current;
+  }
+  if (next != NULL) {
+    free(ctx->command);
+    ctx->command = strdup(next->command);
+    job->id = next->age;
+    job->pid = next->pid;
+    job->state = (int)next->state;
+    job->command = ctx->command != NULL ? ctx->command : "";
+  }
+  unlock_jobs();
+  return next != NULL;
+}
+
+int jsh_exited(jsh_ctx *ctx) { return ctx->shell.run == 0; }
+
+int jsh_status(jsh_ctx *ctx) { return ctx->last_exit_code; }
+
+char *jsh_get_variable(jsh_ctx *ctx, const char *name) {
+  enter(ctx);
+  char *value = get_variable(name);
+  if (value != NULL)
+    value = strdup(value);
+  leave(ctx);
+  return value;
+}
+
+int jsh_set_variable(jsh_ctx *ctx, const char *name, const char *value,
+                     int export) {
+  if (!is_name(name))
+    return -1;
+  enter(ctx);
+  int error = set_variable(name, value, export);
+  leave(ctx);
+  return error ? -1 : 0;
+}
@@ -1,62 +1,105 @@
 #include "../head/jsh.h"
 
-char main_prompt[MAX_PROMPT_LENGTH];
-int last_exit_code = EXIT_SUCCESS;
-int run = 1;
-int njob = 0;
-int idjob = 1;
-job_t *job_list = NULL;
+#include "../head/libjsh.h"
 
 /**
- * Ignores or resets a set of signals
+ * Parses the line `*input`, reading the next lines while an `if`, `while`,
+ * `for` or `{` is left open
  *
- * @param mode : `0` to ignore the signals, `1` to reset them
+ * @param input : line read, replaced by the lines read joined by `\n`
+ * @return the script, `NULL` on syntax error
  */
-void signals(int mode) {
-  int signals[] = {SIGINT, SIGTERM, SIGTTIN, SIGQUIT, SIGTTOU, SIGTSTP};
-
-  struct sigaction sa;
-
-  // Set up the signal handler to ignore the signals
-  sa.sa_handler = mode ? SIG_DFL : SIG_IGN;
-  sigemptyset(&sa.sa_mask);
-  sa.sa_flags = 0;
+static jsh_script *read_script(jsh_ctx *ctx, char **input) {
+  for (;;) {
+    jsh_script *script;
+    switch (jsh_parse(ctx, *input, &script)) {
+    case JSH_OK:
+      return script;
+    case JSH_INCOMPLETE:
+      break;
+    case JSH_NO_MEMORY:
+      fprintf(stderr, "jsh: allocation error\n");
+      return NULL;
+    default:
+      return NULL;
+    }
 
-  // Set the signal handler for each signal in the array
-  for (size_t i = 0; i < sizeof(signals) / sizeof(int); i++) {
-    sigaction(signals[i], &sa, NULL);
+    char *next = readline("> ");
+    if (next == NULL) {
+      fprintf(stderr, "jsh: error: Syntax error: unexpected end of file\n");
+      return NULL;
+    }
+    size_t len = strlen(*input);
+    char *joined = realloc(*input, len + strlen(next) + 2);
+    if (joined == NULL) {
+      perror("jsh: realloc error");
+      free(next);
+      return NULL;
+    }
+    joined[len] = '\n';
+    strcpy(joined + len + 1, next);
+    *input = joined;
+    free(next);
   }
 }
 
-int main() {
+int main(int argc, char **argv) {
   char *input;
-  Command *commands;
+  jsh_script *script;
 
   signals(0);
+  shell_pid = getpid();
+  // the ring of the events is shared with the zygote and all the children
+  if (getenv("JSH_TRACE") != NULL && start_trace(getenv("JSH_TRACE")))
+    perror("jsh: JSH_TRACE");
+  if (getenv("JSH_BOARD") != NULL && start_board(getenv("JSH_BOARD")))
+    perror("jsh: JSH_BOARD");
+  if (getenv("JSH_ZYGOTE") != NULL && strcmp(getenv("JSH_ZYGOTE"), "1") == 0)
+    start_zygote();
+  // the interactive shell is the single context of libjsh : the globals
+  // read by the prompt and `check_jobs()` stay its state
+  jsh_ctx *ctx = jsh_new();
+  if (ctx == NULL) {
+    perror("jsh: initialization error");
+    exit(EXIT_FAILURE);
+  }
+  fd_audit = getenv("JSH_FD_AUDIT");
+  if (getenv("JSH_PIPE_SIZE") != NULL)
+    pipe_size = atoi(getenv("JSH_PIPE_SIZE"));
+  perf_enabled =
+      getenv("JSH_PERF") != NULL && strcmp(getenv("JSH_PERF"), "1") == 0;
+  if (argc > 1 && strcmp(argv[1], "--serve") == 0) {
+    if (argc != 3) {
+      fprintf(stderr, "jsh: usage: jsh --serve socket\n");
+      exit(2);
+    }
+    exit(serve(argv[2]));
+  }
+  open_history();
+  init_completion();
 
-  while (run) {
-    build_prompt(main_prompt);
+  while (!jsh_exited(ctx)) {
     rl_outstream = stderr;
-    input = readline(main_prompt);
-    add_history(input);
+    input = readline(build_prompt());
 
     if (input == NULL)
       break;
     if (input[0] == '\0')
       goto clear;
 
-    errno = 0;
-    commands = parse_command(input , 0);
-    if (errno != 0)
-      goto clear_command;
-    execution(commands , 0);
+    script = read_script(ctx, &input);
+    // the lines of a command spanning several lines form one entry
+    history_add(input);
+    if (script == NULL)
+      goto clear;
+    jsh_run(ctx, script);
+    jsh_script_free(script);
 
-  clear_command:
-    clear_command(commands);
   clear:
     free(input);
     check_jobs(0, STDERR_FILENO);
   }
-  free_job_list();
-  exit(last_exit_code);
-}
\ No newline at end of file
+  int status = jsh_status(ctx);
+  jsh_free(ctx);
+  exit(status);
+}
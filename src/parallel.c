@@ -0,0 +1,339 @@
+#include "../head/jsh.h"
+
+#include <sys/mman.h>
+
+// highest exit code, as for GNU parallel : the number of failed items, up to
+// `PARALLEL_MAX_FAILED`
+#define PARALLEL_MAX_FAILED 101
+
+// with `-k`, number of items started ahead of the first one not printed yet,
+// per worker, to bound the buffered outputs
+#define PARALLEL_WINDOW 16
+
+typedef struct {
+  char **fixed;    // command and its arguments, `{}` replaced by the item
+  size_t nb_fixed;
+  int append;      // `1` if no argument contains `{}` : the item is appended
+  char **items;
+  size_t nb_items;
+  size_t jobs;     // number of workers
+  int keep_order;  // `1` to print the outputs in the order of the items
+  int from_stdin;  // `1` if the items were read from the standard input
+} Parallel;
+
+typedef struct {
+  pid_t pid;
+  size_t item;
+} Worker;
+
+/**
+ * Returns a copy of `arg` where every `{}` is replaced by `item`
+ *
+ * @return the new string, `NULL` on allocation error
+ */
+static char *replace_braces(const char *arg, const char *item) {
+  size_t count = 0;
+  for (const char *p = strstr(arg, "{}"); p != NULL; p = strstr(p + 2, "{}"))
+    count++;
+  size_t item_len = strlen(item);
+  char *word = malloc(strlen(arg) + count * item_len + 1);
+  if (word == NULL)
+    return NULL;
+  char *out = word;
+  for (const char *p; (p = strstr(arg, "{}")) != NULL; arg = p + 2) {
+    memcpy(out, arg, (size_t)(p - arg));
+    out += p - arg;
+    memcpy(out, item, item_len);
+    out += item_len;
+  }
+  strcpy(out, arg);
+  return word;
+}
+
+/**
+ * Runs the command on the item `item`, in the child process of a worker
+ *
+ * @param out : file receiving the output of the command, `-1` for the
+ * standard output
+ */
+static void run_item(Parallel *parallel, size_t item, int out) {
+  if (out != -1 && dup2(out, STDOUT_FILENO) == -1) {
+    perror("jsh: parallel");
+    exit(EXIT_FAILURE);
+  }
+  // the remaining items are not the input of the commands
+  if (parallel->from_stdin) {
+    int null = open("/dev/null", O_RDONLY | O_CLOEXEC);
+    if (null != -1)
+      dup2(null, STDIN_FILENO);
+  }
+  char **argv = malloc((parallel->nb_fixed + 2) * sizeof(char *));
+  if (argv == NULL) {
+    perror("jsh: parallel");
+    exit(EXIT_FAILURE);
+  }
+  for (size_t i = 0; i < parallel->nb_fixed; i++) {
+    argv[i] = parallel->fixed[i];
+    if (strstr(argv[i], "{}") != NULL)
+      argv[i] = replace_braces(argv[i], parallel->items[item]);
+    if (argv[i] == NULL) {
+      perror("jsh: parallel");
+      exit(EXIT_FAILURE);
+    }
+  }
+  size_t argc = parallel->nb_fixed;
+  if (parallel->append)
+    argv[argc++] = parallel->items[item];
+  argv[argc] = NULL;
+  execute_program(argv);
+}
+
+/**
+ * Copies the buffered output `fd` of an item to the standard output, then
+ * closes it
+ */
+static void flush_output(int fd) {
+  char buffer[65536];
+  ssize_t n;
+  lseek(fd, 0, SEEK_SET);
+  while ((n = read(fd, buffer, sizeof(buffer))) > 0) {
+    for (ssize_t written = 0; written < n;) {
+      ssize_t w = write(STDOUT_FILENO, buffer + written, (size_t)(n - written));
+      if (w == -1) {
+        if (errno == EINTR)
+          continue;
+        close(fd);
+        return;
+      }
+      written += w;
+    }
+  }
+  close(fd);
+}
+
+/**
+ * Reports the status of an item which failed
+ *
+ * @return `1` if the item failed, `0` otherwise
+ */
+static int check_item(const char *item, int status) {
+  if (WIFSIGNALED(status)) {
+    fprintf(stderr, "jsh: parallel: %s: killed by signal %d\n", item,
+            WTERMSIG(status));
+    return 1;
+  }
+  if (WEXITSTATUS(status) != 0) {
+    fprintf(stderr, "jsh: parallel: %s: exit code %d\n", item,
+            WEXITSTATUS(status));
+    return 1;
+  }
+  return 0;
+}
+
+/**
+ * Keeps `jobs` workers busy with the items, each free worker taking the next
+ * item of the queue, and waits for all of them
+ *
+ * @param data : the `Parallel` to run
+ * @return the number of failed items, up to `PARALLEL_MAX_FAILED`
+ */
+static int run_parallel(void *data) {
+  Parallel *parallel = data;
+  if (parallel->nb_items == 0)
+    return EXIT_SUCCESS;
+  size_t jobs = parallel->jobs;
+  if (jobs > parallel->nb_items)
+    jobs = parallel->nb_items;
+  Worker *workers = malloc(jobs * sizeof(Worker));
+  pid_t *pids = malloc(jobs * sizeof(pid_t));
+  // with `-k`, buffered output of each item, and whether it is complete
+  int *outputs = NULL;
+  char *finished = NULL;
+  if (parallel->keep_order) {
+    outputs = malloc(parallel->nb_items * sizeof(int));
+    finished = calloc(parallel->nb_items, sizeof(char));
+  }
+  if (workers == NULL || pids == NULL ||
+      (parallel->keep_order && (outputs == NULL || finished == NULL))) {
+    perror("jsh: parallel");
+    free(workers);
+    free(pids);
+    free(outputs);
+    free(finished);
+    return EXIT_FAILURE;
+  }
+
+  size_t failed = 0;
+  size_t running = 0;
+  size_t next = 0;    // next item of the queue
+  size_t printed = 0; // with `-k`, first item whose output is not printed
+  size_t nb_items = parallel->nb_items;
+  while (next < nb_items || running > 0) {
+    if (next < nb_items && running < jobs &&
+        (!parallel->keep_order || next - printed < jobs * PARALLEL_WINDOW)) {
+      int out = -1;
+      if (parallel->keep_order) {
+        out = memfd_create("jsh-parallel", MFD_CLOEXEC);
+        if (out == -1) {
+          perror("jsh: parallel");
+          failed += nb_items - next;
+          nb_items = next;
+          continue;
+        }
+        outputs[next] = out;
+      }
+      pid_t pid = fork();
+      if (pid == 0)
+        run_item(parallel, next, out);
+      if (pid > 0) {
+        workers[running++] = (Worker){pid, next++};
+        continue;
+      }
+      perror("jsh: parallel: fork error");
+      if (out != -1)
+        close(out);
+      // the remaining items are dropped, the running ones still awaited
+      failed += nb_items - next;
+      nb_items = next;
+      continue;
+    }
+
+    // inside a job, the process may have other children than the workers :
+    // only the workers are waited for
+    for (size_t k = 0; k < running; k++)
+      pids[k] = workers[k].pid;
+    int status;
+    pid_t pid = wait_any(pids, running, &status);
+    if (pid == -1) {
+      if (errno == EINTR)
+        continue;
+      break;
+    }
+    size_t k = 0;
+    while (k < running && workers[k].pid != pid)
+      k++;
+    size_t item = workers[k].item;
+    workers[k] = workers[--running];
+    failed += (size_t)check_item(parallel->items[item], status);
+
+    if (parallel->keep_order) {
+      // the output of an item is printed once all the previous ones are
+      finished[item] = 1;
+      while (printed < next && finished[printed])
+        flush_output(outputs[printed++]);
+    }
+  }
+  free(finished);
+  free(outputs);
+  free(pids);
+  free(workers);
+  return (int)(failed < PARALLEL_MAX_FAILED ? failed : PARALLEL_MAX_FAILED);
+}
+
+/**
+ * Reads the items from the standard input, one per line
+ *
+ * @param nb_items : set to the number of items
+ * @return the items, `NULL` on error with a message
+ */
+static char **read_items(size_t *nb_items) {
+  size_t size = MAX_INPUT;
+  char **items = malloc(size * sizeof(char *));
+  if (items == NULL) {
+    perror("jsh: parallel");
+    return NULL;
+  }
+  *nb_items = 0;
+  char *line = NULL;
+  size_t capacity = 0;
+  ssize_t len;
+  while ((len = getline(&line, &capacity, stdin)) != -1) {
+    if (len > 0 && line[len - 1] == '\n')
+      line[--len] = '\0';
+    if (*nb_items == size) {
+      size *= 2;
+      char **tmp = realloc(items, size * sizeof(char *));
+      if (tmp == NULL)
+        goto error;
+      items = tmp;
+    }
+    items[*nb_items] = strdup(line);
+    if (items[*nb_items] == NULL)
+      goto error;
+    (*nb_items)++;
+  }
+  free(line);
+  clearerr(stdin);
+  return items;
+error:
+  perror("jsh: parallel");
+  free(line);
+  for (size_t i = 0; i < *nb_items; i++)
+    free(items[i]);
+  free(items);
+  return NULL;
+}
+
+/**
+ * Runs a command once per item, on `N` workers, as a single job. Each `{}` in
+ * the arguments is replaced by the item, which is otherwise appended
+ *
+ * `parallel [-j N] [-k] cmd [args...] [::: items...]` : without `:::`, the
+ * items are the lines of the standard input. `-j` defaults to the number of
+ * processors, `-k` prints the outputs in the order of the items. The exit
+ * code is the number of failed items, up to 101
+ *
+ * @param args : command arguments
+ */
+int parallel(char **args) {
+  long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+  Parallel parallel = {NULL, 0, 1, NULL, 0, cpus > 0 ? (size_t)cpus : 1, 0, 0};
+  size_t i = 1;
+  for (; args[i] != NULL && args[i][0] == '-'; i++) {
+    if (strcmp(args[i], "-k") == 0) {
+      parallel.keep_order = 1;
+    } else if (strcmp(args[i], "-j") == 0) {
+      char *end = NULL;
+      long n = args[i + 1] == NULL ? 0 : strtol(args[i + 1], &end, 10);
+      if (n <= 0 || *end != '\0') {
+        fprintf(stderr, "jsh: parallel: -j: positive number expected\n");
+        return 2;
+      }
+      parallel.jobs = (size_t)n;
+      i++;
+    } else {
+      break;
+    }
+  }
+  if (args[i] == NULL || strcmp(args[i], ":::") == 0) {
+    fprintf(stderr, "jsh: parallel: usage: parallel [-j N] [-k] cmd [args...] "
+                    "[::: items...]\n");
+    return 2;
+  }
+
+  parallel.fixed = args + i;
+  while (parallel.fixed[parallel.nb_fixed] != NULL &&
+         strcmp(parallel.fixed[parallel.nb_fixed], ":::") != 0) {
+    if (strstr(parallel.fixed[parallel.nb_fixed], "{}") != NULL)
+      parallel.append = 0;
+    parallel.nb_fixed++;
+  }
+  if (parallel.fixed[parallel.nb_fixed] != NULL) {
+    parallel.items = parallel.fixed + parallel.nb_fixed + 1;
+    while (parallel.items[parallel.nb_items] != NULL)
+      parallel.nb_items++;
+  } else {
+    parallel.from_stdin = 1;
+    parallel.items = read_items(&parallel.nb_items);
+    if (parallel.items == NULL)
+      return EXIT_FAILURE;
+  }
+
+  int status = run_job(args, run_parallel, &parallel);
+  if (parallel.from_stdin) {
+    for (size_t k = 0; k < parallel.nb_items; k++)
+      free(parallel.items[k]);
+    free(parallel.items);
+  }
+  return status;
+}
@@ -1,142 +1,478 @@
 #include "../head/jsh.h"
 
-Command *parse_command(char *input , int substuting) {
-  char *token = strtok(input, DELIMITERS);
-  if (substuting && !token) {
-    perror("jsh: error: Syntax error around << <( >>\n");
-    errno = 2 ;
-    return NULL; 
-  }
-  if (find_redirection_type(token) != NULL) {
-    if (!strcmp(token , ")")) return NULL;
-    perror("jsh: error: Syntax error around << <( >>\n");
+// separators glued to a word (`echo a;echo b`) are tokens on their own
+static char semicolon[] = ";";
+// lines of an `if`, `while`, `for` or `{` spanning several lines are joined
+// by `\n`, which ends a pipeline like `;`
+static char newline[] = "\n";
+
+// reserved words ending the lists of `if`, `while` and `for`
+static const char *closing_words[] = {"then", "elif", "else", "fi", "do",
+                                      "done"};
+// state of the parsing of a line, so that several lines can be parsed at
+// once by different threads
+typedef struct {
+  char *rest; // position of `strtok_r()` in the line
+  // the tokens following the current one in the same word are returned
+  // first by `next_token()`
+  char *pending_separator;
+  char *pending_token;
+  // reserved word which ended the last list parsed with `PARSE_COMPOUND`
+  char *ended_by;
+  int incomplete; // `1` if the line ended inside a construct
+} Parser;
+
+static Command *parse_list(Parser *parser, int substuting);
+
+/**
+ * Returns the next token of the line, splitting the `;` and `\n` glued to
+ * words
+ *
+ * @return the token, `NULL` at the end of the line
+ */
+static char *next_token(Parser *parser) {
+  char *token;
+  if (parser->pending_separator != NULL) {
+    token = parser->pending_separator;
+    parser->pending_separator = NULL;
+    return token;
+  }
+  if (parser->pending_token != NULL) {
+    token = parser->pending_token;
+    parser->pending_token = NULL;
+  } else {
+    token = strtok_r(NULL, " \t\r\a", &parser->rest);
+  }
+  if (token == NULL)
+    return NULL;
+  char *end = strpbrk(token, ";\n");
+  if (end == NULL || strcmp(token, ";") == 0)
+    return token;
+  char *separator = *end == ';' ? semicolon : newline;
+  if (end[1] != '\0')
+    parser->pending_token = end + 1;
+  if (end == token)
+    return separator;
+  *end = '\0';
+  parser->pending_separator = separator;
+  return token;
+}
+
+/**
+ * Returns the next token at the beginning of a command, skipping the ends of
+ * lines
+ */
+static char *command_token(Parser *parser) {
+  char *token;
+  while ((token = next_token(parser)) == newline)
+    ;
+  return token;
+}
+
+/**
+ * Returns `1` if `token` is a reserved word ending a list of `if`, `while` or
+ * `for`, `0` otherwise
+ */
+static int is_closing_word(const char *token) {
+  for (size_t i = 0; i < sizeof(closing_words) / sizeof(char *); i++) {
+    if (strcmp(token, closing_words[i]) == 0)
+      return 1;
+  }
+  return 0;
+}
+
+/**
+ * Prints a syntax error around `token`
+ *
+ * @return always `NULL`, with `errno` set to `2`
+ */
+static Command *syntax_error(const char *token) {
+  fprintf(stderr, "jsh: error: Syntax error around << %s >>\n", token);
+  errno = 2;
+  return NULL;
+}
+
+/**
+ * Marks the line as incomplete : `main()` reads the next line and parses the
+ * whole construct again
+ *
+ * @param command : command parsed so far, freed
+ * @return always `NULL`, with `errno` set to `2`
+ */
+static Command *incomplete(Parser *parser, Command *command) {
+  clear_command(command);
+  parser->incomplete = 1;
+  errno = 2;
+  return NULL;
+}
+
+/**
+ * Parses a list of an `if`, `while` or `for`, ended by a reserved word saved
+ * in `ended_by`
+ *
+ * @return the list, `NULL` on syntax error (`errno` is set)
+ */
+static Command *parse_block(Parser *parser) {
+  parser->ended_by = NULL;
+  Command *list = parse_list(parser, PARSE_COMPOUND);
+  if (list == NULL || errno != 0) {
+    clear_command(list);
+    errno = 2;
+    return NULL;
+  }
+  return list;
+}
+
+/**
+ * Checks that the last list parsed by `parse_block(parser)` was ended by `word`
+ *
+ * @return `0` if so, `1` on syntax error (`errno` is set)
+ */
+static int expect(Parser *parser, const char *word) {
+  if (strcmp(parser->ended_by, word) == 0)
+    return 0;
+  syntax_error(parser->ended_by);
+  return 1;
+}
+
+/**
+ * Parses `if list ; then list ; [elif list ; then list ;]... [else list ;] fi`
+ * once `if` (or `elif`) has been read
+ *
+ * @return the command `if`, `NULL` on syntax error (`errno` is set)
+ */
+static Command *parse_if(Parser *parser) {
+  Command *command = create_command("if", NULL, NULL, 0);
+  if ((command->condition = parse_block(parser)) == NULL ||
+      expect(parser, "then"))
+    goto error;
+  if ((command->group = parse_block(parser)) == NULL)
+    goto error;
+  if (strcmp(parser->ended_by, "elif") == 0) {
+    // `elif` is an `if` in the `else` branch, sharing the `fi`
+    if ((command->alternative = parse_if(parser)) == NULL)
+      goto error;
+  } else if (strcmp(parser->ended_by, "else") == 0) {
+    if ((command->alternative = parse_block(parser)) == NULL ||
+        expect(parser, "fi"))
+      goto error;
+  } else if (expect(parser, "fi")) {
+    goto error;
+  }
+  return command;
+error:
+  clear_command(command);
+  errno = 2;
+  return NULL;
+}
+
+/**
+ * Parses `while list ; do list ; done` once `while` has been read
+ *
+ * @return the command `while`, `NULL` on syntax error (`errno` is set)
+ */
+static Command *parse_while(Parser *parser) {
+  Command *command = create_command("while", NULL, NULL, 0);
+  if ((command->condition = parse_block(parser)) == NULL ||
+      expect(parser, "do") || (command->group = parse_block(parser)) == NULL ||
+      expect(parser, "done")) {
+    clear_command(command);
+    errno = 2;
+    return NULL;
+  }
+  return command;
+}
+
+/**
+ * Parses `for NAME in words ; do list ; done` once `for` has been read. The
+ * first argument of the command is `NAME`, the next ones are the words
+ *
+ * @return the command `for`, `NULL` on syntax error (`errno` is set)
+ */
+static Command *parse_for(Parser *parser) {
+  char *token = next_token(parser);
+  if (token == NULL)
+    return incomplete(parser, NULL);
+  if (!is_name(token))
+    return syntax_error(token);
+  Command *command = create_command("for", NULL, NULL, 0);
+  Argument *last = add_argument(command, token);
+
+  token = next_token(parser);
+  if (token == NULL)
+    return incomplete(parser, command);
+  if (strcmp(token, "in") != 0) {
+    clear_command(command);
+    return syntax_error(token);
+  }
+  // the list may be long : the words are appended after the last one
+  while ((token = next_token(parser)) != NULL && token != semicolon &&
+         token != newline)
+    last = last->next = create_argument(token);
+  if (token == NULL || (token = command_token(parser)) == NULL)
+    return incomplete(parser, command);
+  if (strcmp(token, "do") != 0) {
+    clear_command(command);
+    return syntax_error(token);
+  }
+  if ((command->group = parse_block(parser)) == NULL ||
+      expect(parser, "done")) {
+    clear_command(command);
+    errno = 2;
+    return NULL;
+  }
+  return command;
+}
+
+/**
+ * Creates the command starting with `token` : the group `{ ... }`, `if`,
+ * `while`, `for` or a simple command
+ *
+ * @param token : first token of the command
+ * @return the command, `NULL` on syntax error (`errno` is set)
+ */
+static Command *start_command(Parser *parser, char *token) {
+  if (is_closing_word(token))
+    return syntax_error(token);
+  if (strcmp(token, "if") == 0)
+    return parse_if(parser);
+  if (strcmp(token, "while") == 0)
+    return parse_while(parser);
+  if (strcmp(token, "for") == 0)
+    return parse_for(parser);
+  RedirectionType *ptype = find_redirection_type(token);
+  if (ptype == NULL)
+    return create_command(token, NULL, NULL, 0);
+  if (*ptype != GROUP)
+    return syntax_error(token);
+  Command *group = parse_list(parser, PARSE_GROUP);
+  if (group == NULL || errno != 0) {
+    clear_command(group);
     errno = 2;
     return NULL;
   }
   Command *command = create_command(token, NULL, NULL, 0);
+  command->group = group;
+  return command;
+}
+
+/**
+ * Returns `1` if `token`, at the beginning of a command, ends the list parsed
+ * in the mode `substuting` of `parse_list()`, `0` otherwise
+ */
+static int ends_list(Parser *parser, char *token, int substuting) {
+  switch (substuting) {
+  case 1:
+    return strcmp(token, ")") == 0;
+  case PARSE_GROUP:
+    return strcmp(token, "}") == 0;
+  case PARSE_COMPOUND:
+    if (!is_closing_word(token))
+      return 0;
+    parser->ended_by = token;
+    return 1;
+  default:
+    return 0;
+  }
+}
+
+/**
+ * Returns `1` if `commands` holds more than one pipeline
+ *
+ * @param commands : list of commands
+ */
+static int is_list(Command *commands) {
+  for (Command *i = commands; i->next != NULL; i = i->next) {
+    if (i->pipe == NULL)
+      return 1;
+  }
+  return 0;
+}
+
+/**
+ * Parses the substitution `<( ... )` following the current token. The read
+ * end of its pipe is opened to reserve the descriptor `/dev/fd/N`, the pipe
+ * itself is created by `open_substitution()` each time the command runs
+ *
+ * @param command : command reading the substitution
+ * @param type : `SUBSTITUTION` for an argument `<( ... )`, otherwise the type
+ * of the redirection `type <( ... )`
+ * @return `0` on success or empty substitution, `1` on error (`errno` is set)
+ */
+static int parse_substitution(Parser *parser, Command *command,
+                              RedirectionType type) {
+  Command *to_substitute = parse_list(parser, 1);
+  if (!to_substitute)
+    return errno != 0;
+  // the output of every pipeline of `<( cmd1 ; cmd2 )` goes to the pipe
+  if (is_list(to_substitute)) {
+    Command *group = create_command("{", NULL, NULL, 0);
+    group->group = to_substitute;
+    to_substitute = group;
+  }
+  int fds[2] = {-1, -1};
+  if (pipe2(fds, O_CLOEXEC)) {
+    fprintf(stderr, "jsh: error: Pipe creation failed\n");
+    errno = 2;
+    clear_command(to_substitute);
+    return 1;
+  }
+  close(fds[1]);
+  if (add_substitution(command, to_substitute, fds[0])) {
+    fprintf(stderr, "jsh: allocation error\n");
+    errno = 2;
+    close(fds[0]);
+    clear_command(to_substitute);
+    return 1;
+  }
+  char path[20];
+  sprintf(path, "/dev/fd/%d", fds[0]);
+  if (type == SUBSTITUTION)
+    add_argument(command, path);
+  else
+    add_redirection(command, type, path);
+  Command *last_cmd;
+  for (last_cmd = to_substitute; last_cmd->next != NULL;
+       last_cmd = last_cmd->next)
+    ;
+  add_redirection(last_cmd, SUBSTITUTION_OUT, "-1");
+  return 0;
+}
+
+/**
+ * Parses a list of pipelines separated by `;`, `&`, `&&`, `||` or ends of
+ * lines
+ *
+ * @param substuting : `0` for a command line, `1` for a substitution ended by
+ * `)`, `PARSE_GROUP` for a group ended by `}`, `PARSE_COMPOUND` for a list of
+ * `if`, `while` or `for` ended by a reserved word
+ * @return the list of commands, `NULL` if it is empty. On syntax error,
+ * `errno` is set to `2`, and `parser->incomplete` to `1` if the line ended
+ * inside a construct
+ */
+static Command *parse_list(Parser *parser, int substuting) {
+  char *token = next_token(parser);
+  while (token == newline)
+    token = next_token(parser);
+  if (!token) {
+    if (substuting == 1)
+      return syntax_error("<(");
+    if (substuting)
+      return incomplete(parser, NULL);
+    return NULL;
+  }
+  if (substuting == 1 && !strcmp(token, ")"))
+    return NULL;
+  Command *command = start_command(parser, token);
+  if (command == NULL)
+    return NULL;
 
   Command *currentCommand = command;
-  while ((token = strtok(NULL, " ")) != NULL) {
+  while ((token = next_token(parser)) != NULL) {
     RedirectionType *ptype = find_redirection_type(token);
-    if (ptype != NULL) {
+    if (ptype == NULL || *ptype == GROUP || *ptype == GROUP_OUT) {
+      // `{` and `}` are words outside of the command position
+      add_argument(currentCommand, token);
+      continue;
+    }
+
+    if (*ptype == SUBSTITUTION_OUT){
+      if (substuting == 1) return command;
+      fprintf(stderr , "jsh: error: Syntax error around << ) >>\n");
+      errno = 2;
+      return command;
+    }
 
-      if (*ptype == SUBSTITUTION_OUT){
-        if (substuting) return command;
-        fprintf(stderr , "jsh: error: Syntax error around << ) >>\n");
+    if (*ptype == SUBSTITUTION) {
+      if (parse_substitution(parser, currentCommand, SUBSTITUTION))
+        return command;
+    } else if (*ptype == PIPE) {
+      char *next = command_token(parser);
+      if (next == NULL) {
+        fprintf(stderr , "jsh: error: Syntax error around << | >>\n");
         errno = 2;
         return command;
       }
-
-      if (*ptype == SUBSTITUTION) {
-        Command * to_substitute = parse_command(NULL , 1);
-        if (!to_substitute) {
-          if (errno != 0) {
-            clear_command(to_substitute);
-            return command ; 
-          }
-          continue;
-        }
-        int fds[2] = {-1 , -1}; 
-        if (pipe(fds)) {
-          fprintf(stderr , "jsh: error: Pipe creation failed\n");
-          errno = 2 ;
-          clear_command(to_substitute);
-          return command ; 
-        }
-        if (currentCommand->nb_substitutions + 1 >= currentCommand->size_substitutions) {
-          currentCommand->size_substitutions += 10;
-          currentCommand->substitutions = realloc(currentCommand->substitutions , sizeof(Command *)*currentCommand->size_substitutions);
-        }
-        currentCommand->substitutions[currentCommand->nb_substitutions++] = to_substitute;
-        char arg_val[20];
-        sprintf(arg_val , "/dev/fd/%d" , fds[0]) ; 
-        add_argument(currentCommand , arg_val);
-        Command *last_cmd ; 
-        for (last_cmd = to_substitute ; last_cmd->next != NULL ; last_cmd = last_cmd->next) ; 
-        char redir_val[20] = {0};
-        sprintf(redir_val , "%d" , fds[1]);
-        add_redirection(last_cmd , SUBSTITUTION_OUT , redir_val);
-        continue;
-      } else if (*ptype == PIPE) {
-        char *next = strtok(NULL, " ");
-        if (next == NULL) {
-          fprintf(stderr , "jsh: error: Syntax error around << | >>\n");
-          errno = 2;
+      Command *nextCommand = start_command(parser, next);
+      if (nextCommand == NULL)
+        return command;
+      currentCommand->pipe = malloc(2 * sizeof(int));
+      currentCommand->next = nextCommand;
+      currentCommand = nextCommand;
+    } else if (*ptype == BACKGROUND || *ptype == SEQUENCE || *ptype == AND ||
+               *ptype == OR) {
+      if (*ptype == BACKGROUND)
+        currentCommand->background = 1;
+      else
+        currentCommand->connector = *ptype;
+      char *next = command_token(parser);
+      // end of the list : `cmd &`, `cmd ;`, `{ cmd ; }`, `<( cmd ; )` or
+      // `cmd ; done`...
+      if (next == NULL || ends_list(parser, next, substuting)) {
+        if ((*ptype == AND || *ptype == OR) && (next != NULL || !substuting)) {
+          syntax_error(token);
           return command;
         }
-        Command *nextCommand = create_command(next, NULL, NULL, 0);
-        currentCommand->pipe = malloc(2 * sizeof(int));
-        currentCommand->next = nextCommand;
-        currentCommand = nextCommand;
-      } else if (*ptype == BACKGROUND) {
-        if (currentCommand->pipe != NULL) {
-          fprintf(stderr , "jsh: error: Syntax error around << & >>\n");
+        if (next == NULL)
+          break;
+        return command;
+      }
+      Command *nextCommand = start_command(parser, next);
+      if (nextCommand == NULL)
+        return command;
+      currentCommand->next = nextCommand;
+      currentCommand = nextCommand;
+    } else {
+      char *value = next_token(parser);
+      if (value == NULL || value == newline) {
+        fprintf(stderr , "jsh: error: Syntax error newLine expected\n");
+        errno = 2;
+        return command;
+      }
+      RedirectionType *next = find_redirection_type(value);
+      if (next != NULL) {
+        if (*next != SUBSTITUTION) {
+          fprintf(stderr ,"jsh: error: Syntax error newLine expected\n");
           errno = 2;
           return command;
         }
-        currentCommand->background = 1;
-        token = strtok(NULL, " ");
-        if (token != NULL) { // If there's another command after the &
-          Command *nextCommand = create_command(token, NULL, NULL, 0);
-          currentCommand->next = nextCommand;
-          currentCommand = nextCommand;
-        }
-      } else {
-        char *value = strtok(NULL, " ");
-        if (value == NULL) {
-          fprintf(stderr , "jsh: error: Syntax error newLine expected\n");
-          errno = 2;
+        if (parse_substitution(parser, currentCommand, *ptype))
           return command;
-        }
-        RedirectionType *next = find_redirection_type(value);
-        if (next != NULL) {
-          if (*next != SUBSTITUTION) {
-            fprintf(stderr ,"jsh: error: Syntax error newLine expected\n");
-            errno = 2;
-            return command;
-          }
-          // here 
-          Command * to_substitute = parse_command(NULL , 1);
-          if (!to_substitute) {
-            if (errno != 0) {
-              clear_command(to_substitute);
-              return command ; 
-            }
-            continue;
-          }
-          int fds[2] = {-1 , -1}; 
-          if (pipe(fds)) {
-            fprintf(stderr , "jsh: error: Pipe creation failed\n");
-            errno = 2 ;
-            clear_command(to_substitute);
-            return command ; 
-          }
-          if (currentCommand->nb_substitutions + 1 >= currentCommand->size_substitutions) {
-            currentCommand->size_substitutions += 10;
-            currentCommand->substitutions = realloc(currentCommand->substitutions , sizeof(Command *)*currentCommand->size_substitutions);
-          }
-          currentCommand->substitutions[currentCommand->nb_substitutions++] = to_substitute;
-          char to_redir_val[20];
-          sprintf(to_redir_val , "/dev/fd/%d" , fds[0]) ; 
-          add_redirection(currentCommand , *ptype , to_redir_val);
-          Command *last_cmd ; 
-          for (last_cmd = to_substitute ; last_cmd->next != NULL ; last_cmd = last_cmd->next) ; 
-          char redir_val[20] = {0};
-          sprintf(redir_val , "%d" , fds[1]);
-          add_redirection(last_cmd , SUBSTITUTION_OUT , redir_val);
-
-          continue;
-        }
-        add_redirection(currentCommand, *ptype, value);
+        continue;
       }
-    } else {
-      add_argument(currentCommand, token);
+      add_redirection(currentCommand, *ptype, value);
     }
   }
+  // the line ended before the `}`, `fi` or `done` of the construct
+  if (substuting == PARSE_GROUP || substuting == PARSE_COMPOUND)
+    return incomplete(parser, command);
   return command;
 }
 
-char **get_full_command(Command *cmd) {
+/**
+ * Parses a command line, which may span several lines joined by `\n`
+ *
+ * @param line : line to parse, cut by the parsing
+ * @param incomplete : set to `1` if the line ended inside an `if`, `while`,
+ * `for` or `{`, `0` otherwise
+ * @return the list of commands, `NULL` if it is empty. On syntax error,
+ * `errno` is set to `2`
+ */
+Command *parse_command(char *line, int *incomplete) {
+  Parser parser = {line, NULL, NULL, NULL, 0};
+  Command *commands = parse_list(&parser, 0);
+  *incomplete = parser.incomplete;
+  return commands;
+}
+
+/**
+ * Expands the words `arguments` as `expand_arguments()`
+ *
+ * @param arguments : list of words
+ * @param name : `1` if the first word names a command. The `?` and `[`
+ * built-ins are then not taken for patterns
+ */
+static char **expand_words(Argument *arguments, int name) {
   size_t bufsize = MAX_INPUT;
   size_t position = 0;
   char **command = malloc(bufsize * sizeof(char *));
@@ -144,55 +480,222 @@ char **get_full_command(Command *cmd) {
   if (!command)
     goto error_alloc;
 
-  command[position++] = cmd->name;
-
-  for (Argument *i = cmd->arguments; i != NULL; i = i->next) {
-    if (position >= bufsize) {
+  for (Argument *i = arguments; i != NULL; i = i->next) {
+    if (position + 1 >= bufsize) {
       bufsize += MAX_INPUT;
-      command = realloc(command, bufsize * sizeof(char *));
-      if (!command)
-        goto error_alloc;
+      char **tmp = realloc(command, bufsize * sizeof(char *));
+      if (!tmp)
+        goto error_expand;
+      command = tmp;
+    }
+    char *word = expand_word(i->value);
+    if (word == NULL)
+      goto error_expand;
+    if (word[0] == '\0' && strchr(i->value, '$') != NULL) {
+      free(word);
+      continue;
+    }
+    if (has_glob(word) && !(name && i == arguments && (strcmp(word, "?") == 0 ||
+                                                      strcmp(word, "[") == 0))) {
+      int matches = glob_word(word, &command, &position, &bufsize);
+      if (matches != 0) {
+        free(word);
+        if (matches == -1)
+          goto error_expand;
+        continue;
+      }
     }
-    command[position++] = i->value;
+    command[position++] = word;
   }
   command[position] = NULL;
   return command;
+error_expand:
+  command[position] = NULL;
+  free_full_command(command);
 error_alloc:
   fprintf(stderr, "jsh: allocation error\n");
   return NULL;
 }
 
-char *get_command(Command *cmd) {
-  size_t bufsize = MAX_INPUT;
-  size_t position = 0;
-  size_t len;
-  char *command = malloc(bufsize * sizeof(char));
+/**
+ * Returns the words `arguments` once their variables are expanded and their
+ * patterns replaced by the matching paths. A word containing `$` and expanded
+ * to an empty string is removed, a pattern matching no path is kept
+ *
+ * @param arguments : list of words
+ * @return the array of words, to free with `free_full_command()`, `NULL` on
+ * allocation error
+ */
+char **expand_arguments(Argument *arguments) {
+  return expand_words(arguments, 0);
+}
 
-  if (!command)
-    goto error_alloc;
+/**
+ * Returns the words of the simple command `cmd`, expanded by
+ * `expand_arguments()`
+ */
+char **get_full_command(Command *cmd) {
+  Argument name = {cmd->name, cmd->arguments};
+  return expand_words(&name, 1);
+}
+
+/**
+ * Frees an array returned by `get_full_command()`
+ */
+void free_full_command(char **args) {
+  if (args == NULL)
+    return;
+  for (size_t i = 0; args[i] != NULL; i++)
+    free(args[i]);
+  free(args);
+}
+
+/**
+ * Appends `str` followed by a space to the buffer `*command`
+ *
+ * @param command : buffer, reallocated if needed
+ * @param bufsize : size of the buffer
+ * @param position : end of the string in the buffer
+ * @param str : string to append
+ * @return `0` on success, `1` on allocation error (`*command` is freed)
+ */
+static int append_word(char **command, size_t *bufsize, size_t *position,
+                       const char *str) {
+  size_t len = strlen(str);
+  if (*position + len + 1 >= *bufsize) {
+    *bufsize += len + MAX_INPUT;
+    char *tmp = realloc(*command, *bufsize * sizeof(char));
+    if (!tmp) {
+      free(*command);
+      return 1;
+    }
+    *command = tmp;
+  }
+  memmove(*command + *position, str, len);
+  *position += len;
+  (*command)[(*position)++] = ' ';
+  return 0;
+}
+
+/**
+ * Appends the pipeline starting with `cmd` to the buffer `*command`
+ *
+ * @return the last command of the pipeline, `NULL` on allocation error
+ */
+static Command *append_pipeline(char **command, size_t *bufsize,
+                                size_t *position, Command *cmd);
+
+/**
+ * Appends the list of pipelines `cmd` to the buffer `*command`, with their
+ * separators
+ *
+ * @return `0` on success, `1` on allocation error
+ */
+static int append_list(char **command, size_t *bufsize, size_t *position,
+                       Command *cmd) {
   for (Command *k = cmd; k != NULL; k = k->next) {
-    len = strlen(k->name);
-    memmove(command + position, k->name, len);
-    position += strlen(k->name);
-    command[position++] = ' ';
+    k = append_pipeline(command, bufsize, position, k);
+    if (k == NULL)
+      return 1;
+    const char *separator = k->background ? "&"
+                            : k->connector == AND ? "&&"
+                            : k->connector == OR  ? "||"
+                                                  : ";";
+    if ((k->next != NULL || k->background) &&
+        append_word(command, bufsize, position, separator))
+      return 1;
+  }
+  return 0;
+}
+
+/**
+ * Appends the list `cmd` of a construct followed by the reserved word `word`
+ *
+ * @return `0` on success, `1` on allocation error
+ */
+static int append_block(char **command, size_t *bufsize, size_t *position,
+                        Command *cmd, const char *word) {
+  if (append_list(command, bufsize, position, cmd))
+    return 1;
+  // `{ cmd ; }` but `{ cmd & }`
+  Command *last = cmd;
+  while (last->next != NULL)
+    last = last->next;
+  if (!last->background && append_word(command, bufsize, position, ";"))
+    return 1;
+  return append_word(command, bufsize, position, word);
+}
 
+/**
+ * Appends the group, `if`, `while` or `for` command `k`
+ *
+ * @return `0` on success, `1` on allocation error
+ */
+static int append_compound(char **command, size_t *bufsize, size_t *position,
+                           Command *k) {
+  if (append_word(command, bufsize, position, k->name))
+    return 1;
+  if (strcmp(k->name, "if") == 0) {
+    if (append_block(command, bufsize, position, k->condition, "then"))
+      return 1;
+    if (k->alternative == NULL)
+      return append_block(command, bufsize, position, k->group, "fi");
+    return append_block(command, bufsize, position, k->group, "else") ||
+           append_block(command, bufsize, position, k->alternative, "fi");
+  }
+  if (strcmp(k->name, "while") == 0)
+    return append_block(command, bufsize, position, k->condition, "do") ||
+           append_block(command, bufsize, position, k->group, "done");
+  if (strcmp(k->name, "for") == 0) {
     for (Argument *i = k->arguments; i != NULL; i = i->next) {
-      len = strlen(i->value);
-      if (position + len >= bufsize) {
-        bufsize += MAX_INPUT;
-        command = realloc(command, bufsize * sizeof(char));
-        if (!command)
-          goto error_alloc;
-      }
-      memmove(command + position, i->value, len);
-      position += len;
-      command[position++] = ' ';
+      if (append_word(command, bufsize, position, i->value) ||
+          (i == k->arguments && append_word(command, bufsize, position, "in")))
+        return 1;
     }
-    if (k->pipe != NULL) {
-      command[position++] = '|';
-      command[position++] = ' ';
+    return append_word(command, bufsize, position, "; do") ||
+           append_block(command, bufsize, position, k->group, "done");
+  }
+  return append_block(command, bufsize, position, k->group, "}");
+}
+
+static Command *append_pipeline(char **command, size_t *bufsize,
+                                size_t *position, Command *cmd) {
+  for (Command *k = cmd; k != NULL; k = k->next) {
+    if (k->group != NULL) {
+      if (append_compound(command, bufsize, position, k))
+        return NULL;
+    } else {
+      if (append_word(command, bufsize, position, k->name))
+        return NULL;
+      for (Argument *i = k->arguments; i != NULL; i = i->next) {
+        if (append_word(command, bufsize, position, i->value))
+          return NULL;
+      }
     }
+    if (k->pipe == NULL)
+      return k;
+    if (append_word(command, bufsize, position, "|"))
+      return NULL;
   }
+  return NULL;
+}
+
+/**
+ * Returns the command line of the pipeline starting with `cmd`, as printed
+ * by `jobs`
+ *
+ * @param cmd : first command of the pipeline
+ * @return the command line to free, `NULL` on allocation error
+ */
+char *get_command(Command *cmd) {
+  size_t bufsize = MAX_INPUT;
+  size_t position = 0;
+  char *command = malloc(bufsize * sizeof(char));
+
+  if (!command)
+    goto error_alloc;
+  if (append_pipeline(&command, &bufsize, &position, cmd) == NULL)
+    goto error_alloc;
   command[position - 1] = '\0';
   return command;
 error_alloc:
@@ -0,0 +1,190 @@
+#include "../head/jsh.h"
+
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+
+/*
+ * With `JSH_PERF=1`, the hardware counters of each job are opened on the
+ * leader of the job right after its fork, while the child waits on a pipe
+ * for them to be attached. The counters are inherited : the processes the
+ * job forks add theirs when they end. They are read once the job is reaped,
+ * for its completion notice, or on demand by `jobs -l`.
+ */
+
+struct PerfCounters {
+  int fds[PERF_COUNTERS]; // `-1` if the counter could not be opened
+};
+
+static const struct {
+  uint64_t config;
+  const char *name;
+} counters[PERF_COUNTERS] = {
+    {PERF_COUNT_HW_CPU_CYCLES, "cycles"},
+    {PERF_COUNT_HW_INSTRUCTIONS, "instructions"},
+    {PERF_COUNT_HW_CACHE_MISSES, "cache misses"},
+    {PERF_COUNT_HW_BRANCH_MISSES, "branch misses"},
+};
+
+int perf_enabled = 0;
+// set once the kernel refuses to count in kernel mode
+static int user_only = 0;
+
+/**
+ * Opens one counter of `pid`, in user mode only if `perf_event_paranoid`
+ * requires it
+ *
+ * @return the descriptor of the counter, `-1` on error
+ */
+static int open_counter(pid_t pid, uint64_t config) {
+  struct perf_event_attr attr;
+  memset(&attr, 0, sizeof(attr));
+  attr.size = sizeof(attr);
+  attr.type = PERF_TYPE_HARDWARE;
+  attr.config = config;
+  attr.inherit = 1;
+  attr.exclude_hv = 1;
+  // the counters of a job are multiplexed with the others on the PMU
+  attr.read_format =
+      PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+  for (;;) {
+    attr.exclude_kernel = user_only ? 1 : 0;
+    int fd = (int)syscall(SYS_perf_event_open, &attr, pid, -1, -1,
+                          PERF_FLAG_FD_CLOEXEC);
+    if (fd != -1 || user_only || errno != EACCES && errno != EPERM)
+      return fd;
+    user_only = 1;
+  }
+}
+
+/**
+ * Prepares the counting of the job about to be forked : the child calls
+ * `perf_child()` and the parent `perf_attach()` with `sync`
+ *
+ * @param sync : set to the pipe synchronizing the child with its parent,
+ * `-1` if the job is not counted
+ */
+void perf_prepare(int sync[2]) {
+  sync[0] = sync[1] = -1;
+  if (perf_enabled && pipe2(sync, O_CLOEXEC) == -1)
+    sync[0] = sync[1] = -1;
+}
+
+/**
+ * In the child, waits for the parent to attach the counters, so that they
+ * see all of the job
+ */
+void perf_child(int sync[2]) {
+  if (sync[0] == -1)
+    return;
+  close(sync[1]);
+  char c;
+  while (read(sync[0], &c, 1) == -1 && errno == EINTR)
+    ;
+  close(sync[0]);
+}
+
+/**
+ * In the parent, opens the counters of the child `pid` then lets it run. If
+ * no counter can be opened, counting is disabled for the rest of the session
+ *
+ * @param pid : child forked, negative if `fork()` failed
+ * @return the counters, `NULL` if the job is not counted
+ */
+PerfCounters *perf_attach(pid_t pid, int sync[2]) {
+  if (sync[0] == -1)
+    return NULL;
+  PerfCounters *perf = pid > 0 ? malloc(sizeof(PerfCounters)) : NULL;
+  int opened = 0;
+  int error = 0;
+  for (size_t i = 0; perf != NULL && i < PERF_COUNTERS; i++) {
+    perf->fds[i] = open_counter(pid, counters[i].config);
+    if (perf->fds[i] != -1)
+      opened++;
+    else if (error == 0)
+      error = errno;
+  }
+  close(sync[0]);
+  close(sync[1]);
+  if (perf == NULL || opened > 0)
+    return perf;
+
+  free(perf);
+  FILE *paranoid = fopen("/proc/sys/kernel/perf_event_paranoid", "re");
+  int level;
+  if (paranoid != NULL && fscanf(paranoid, "%d", &level) == 1 &&
+      (error == EACCES || error == EPERM))
+    fprintf(stderr, "jsh: JSH_PERF: %s (perf_event_paranoid is %d)\n",
+            strerror(error), level);
+  else
+    fprintf(stderr, "jsh: JSH_PERF: hardware counters unavailable: %s\n",
+            strerror(error));
+  if (paranoid != NULL)
+    fclose(paranoid);
+  perf_enabled = 0;
+  return NULL;
+}
+
+/**
+ * Writes `value` with 3 significant digits and a `k`, `M`, `G` or `T`
+ * suffix
+ */
+static void format_count(char *buffer, size_t size, double value) {
+  const char *suffixes = " kMGT";
+  while (value >= 999.5 && suffixes[1] != '\0') {
+    value /= 1000;
+    suffixes++;
+  }
+  if (*suffixes == ' ')
+    snprintf(buffer, size, "%.0f", value);
+  else
+    snprintf(buffer, size, "%.*f%c", value < 9.995 ? 2 : value < 99.95 ? 1 : 0,
+             value, *suffixes);
+}
+
+/**
+ * Prints the counters of a job : the ones of its processes which ended, and
+ * the ones of its leader so far. Counts measured only part of the time, the
+ * PMU being shared, are scaled
+ *
+ * @param fdout : file descriptor to print to
+ */
+void print_perf_counters(const PerfCounters *perf, int fdout) {
+  if (perf == NULL)
+    return;
+  double values[PERF_COUNTERS];
+  char line[256];
+  size_t length = 0;
+  for (size_t i = 0; i < PERF_COUNTERS; i++) {
+    // value, time enabled, time running
+    uint64_t data[3];
+    char count[16] = "n/a";
+    values[i] = -1;
+    if (perf->fds[i] != -1 &&
+        read(perf->fds[i], data, sizeof(data)) == sizeof(data) &&
+        data[2] > 0) {
+      values[i] = (double)data[0];
+      if (data[2] < data[1])
+        values[i] *= (double)data[1] / (double)data[2];
+      format_count(count, sizeof(count), values[i]);
+    }
+    length += (size_t)snprintf(line + length, sizeof(line) - length, "%s%s %s",
+                               i == 0 ? "" : ", ", count, counters[i].name);
+    // instructions per cycle, after the instructions
+    if (i == 1 && values[0] > 0 && values[1] >= 0)
+      length += (size_t)snprintf(line + length, sizeof(line) - length,
+                                 " (%.2f per cycle)", values[1] / values[0]);
+  }
+  dprintf(fdout, "\t%s\n", line);
+}
+
+/**
+ * Closes the counters of a job
+ */
+void perf_free(PerfCounters *perf) {
+  if (perf == NULL)
+    return;
+  for (size_t i = 0; i < PERF_COUNTERS; i++)
+    if (perf->fds[i] != -1)
+      close(perf->fds[i]);
+  free(perf);
+}
@@ -1,34 +1,320 @@
 #include "../head/jsh.h"
 
-void current_folder(char *prompt) {
-  char cwd[256];
-  if (getcwd(cwd, sizeof(cwd)) == NULL) {
-    perror("cwd");
+#include <pwd.h>
+#include <time.h>
+
+/*
+ * The prompt is described by `$JSH_PS1`, whose escapes are :
+ *
+ *   \?  exit code of the last command     \j  number of jobs
+ *   \w  current directory, its end only   \W  last component of the
+ *       beyond MAX_PROMPT_LENGTH               current directory
+ *   \t  time, HH:MM:SS                    \h  host name, up to the first `.`
+ *   \H  host name                         \u  user name
+ *   \$  `#` for root, `$` otherwise       \C  green color after a success,
+ *   \e  escape character                      red otherwise
+ *   \[  \]  around the escape sequences, which take no room on the screen
+ *   \n  new line                          \\  backslash
+ *
+ * The template is compiled once into segments. Each dynamic segment keeps
+ * its rendering and the input it was computed from, and is only rendered
+ * again when this input changes
+ */
+
+#define DEFAULT_PS1 "\\C[\\j]\\[\\e[33m\\]\\w\\[\\e[00m\\]$ "
+
+typedef enum {
+  SEGMENT_TEXT,
+  SEGMENT_STATUS,
+  SEGMENT_STATUS_COLOR,
+  SEGMENT_JOBS,
+  SEGMENT_CWD,
+  SEGMENT_CWD_BASENAME,
+  SEGMENT_TIME
+} segment_type;
+
+typedef struct {
+  segment_type type;
+  char *text; // literal text, or rendering of the segment
+  size_t length;
+  size_t size; // allocated size of `text`
+  long long input; // value the rendering was computed from
+  int rendered;
+} Segment;
+
+static char *template = NULL; // template compiled into `segments`
+static Segment *segments = NULL;
+static size_t nb_segments = 0;
+static char *prompt = NULL;
+static size_t prompt_size = 0;
+
+/**
+ * Replaces the text of a segment by the `length` bytes at `text`
+ *
+ * @return `0` on success, `-1` on allocation error
+ */
+static int set_text(Segment *segment, const char *text, size_t length) {
+  if (length + 1 > segment->size) {
+    char *new_text = realloc(segment->text, length + 1);
+    if (new_text == NULL)
+      return -1;
+    segment->text = new_text;
+    segment->size = length + 1;
+  }
+  memcpy(segment->text, text, length);
+  segment->text[length] = '\0';
+  segment->length = length;
+  return 0;
+}
+
+/**
+ * Appends a segment, or the `length` bytes at `text` to the last segment
+ * when both are literal text
+ *
+ * @return `0` on success, `-1` on allocation error
+ */
+static int add_segment(segment_type type, const char *text, size_t length) {
+  if (type == SEGMENT_TEXT && nb_segments > 0 &&
+      segments[nb_segments - 1].type == SEGMENT_TEXT) {
+    Segment *last = &segments[nb_segments - 1];
+    char *new_text = realloc(last->text, last->length + length + 1);
+    if (new_text == NULL)
+      return -1;
+    memcpy(new_text + last->length, text, length);
+    last->length += length;
+    new_text[last->length] = '\0';
+    last->text = new_text;
+    last->size = last->length + 1;
+    return 0;
   }
+  Segment *new_segments =
+      realloc(segments, (nb_segments + 1) * sizeof(Segment));
+  if (new_segments == NULL)
+    return -1;
+  segments = new_segments;
+  Segment *segment = &segments[nb_segments++];
+  *segment = (Segment){type, NULL, 0, 0, 0, 0};
+  return set_text(segment, text, length);
+}
 
-  if (strlen(cwd) > MAX_PROMPT_LENGTH - 2) {
-    memcpy(prompt, "...", 3);
-    prompt[3] = '\0';
-    strncpy(prompt + 3, cwd + strlen(cwd) - (MAX_PROMPT_LENGTH - 8),
-            MAX_PROMPT_LENGTH - 4);
-  } else {
-    strcpy(prompt, cwd);
+/**
+ * Frees the compiled template
+ */
+static void clear_segments(void) {
+  for (size_t i = 0; i < nb_segments; i++)
+    free(segments[i].text);
+  free(segments);
+  free(template);
+  segments = NULL;
+  nb_segments = 0;
+  template = NULL;
+}
+
+/**
+ * Compiles the template `ps1` into segments. The host and user names are
+ * constant : they are resolved here, as literal text
+ *
+ * @return `0` on success, `-1` on allocation error
+ */
+static int compile_template(const char *ps1) {
+  clear_segments();
+  template = strdup(ps1);
+  if (template == NULL)
+    return -1;
+  int error = 0;
+  for (const char *c = ps1; *c != '\0' && !error; c++) {
+    if (*c != '\\' || c[1] == '\0') {
+      size_t length = strcspn(c + 1, "\\") + 1;
+      error = add_segment(SEGMENT_TEXT, c, length);
+      c += length - 1;
+      continue;
+    }
+    char host[256];
+    const char *text = NULL;
+    switch (*++c) {
+    case '?':
+      error = add_segment(SEGMENT_STATUS, "", 0);
+      break;
+    case 'C':
+      error = add_segment(SEGMENT_STATUS_COLOR, "", 0);
+      break;
+    case 'j':
+      error = add_segment(SEGMENT_JOBS, "", 0);
+      break;
+    case 'w':
+      error = add_segment(SEGMENT_CWD, "", 0);
+      break;
+    case 'W':
+      error = add_segment(SEGMENT_CWD_BASENAME, "", 0);
+      break;
+    case 't':
+      error = add_segment(SEGMENT_TIME, "", 0);
+      break;
+    case 'h':
+    case 'H':
+      if (gethostname(host, sizeof(host)) == -1)
+        strcpy(host, "?");
+      host[sizeof(host) - 1] = '\0';
+      if (*c == 'h')
+        host[strcspn(host, ".")] = '\0';
+      text = host;
+      break;
+    case 'u': {
+      struct passwd *pw = getpwuid(geteuid());
+      text = pw != NULL ? pw->pw_name : get_variable("USER");
+      if (text == NULL)
+        text = "?";
+      break;
+    }
+    case '$':
+      text = geteuid() == 0 ? "#" : "$";
+      break;
+    case 'e':
+      text = "\033";
+      break;
+    case '[':
+      text = "\001";
+      break;
+    case ']':
+      text = "\002";
+      break;
+    case 'n':
+      text = "\n";
+      break;
+    case '\\':
+      text = "\\";
+      break;
+    default:
+      // unknown escapes are kept as they are
+      error = add_segment(SEGMENT_TEXT, c - 1, 2);
+    }
+    if (text != NULL)
+      error = add_segment(SEGMENT_TEXT, text, strlen(text));
   }
+  if (error)
+    clear_segments();
+  return error ? -1 : 0;
 }
 
-void build_prompt(char *prompt) {
-  if (last_exit_code == 0) {
-    strcpy(prompt, "\001\033[32m\002");
-  } else {
-    strcpy(prompt, "\001\033[31m\002");
-  }
-  char jobs_str[10];
-  snprintf(jobs_str, sizeof(jobs_str), "[%d]", njob);
-  strcat(prompt, jobs_str);
-  strcat(prompt, "\001\033[33m\002");
-  char temp[MAX_PROMPT_LENGTH];
-  current_folder(temp);
-  strcat(prompt, temp);
-  strcat(prompt, "\001\033[00m\002");
-  strcat(prompt, "$ ");
-}
\ No newline at end of file
+/**
+ * Returns the value a dynamic segment is computed from
+ */
+static long long segment_input(const Segment *segment) {
+  switch (segment->type) {
+  case SEGMENT_STATUS:
+    return last_exit_code;
+  case SEGMENT_STATUS_COLOR:
+    return last_exit_code != 0;
+  case SEGMENT_JOBS:
+    return shell->njob;
+  case SEGMENT_CWD:
+  case SEGMENT_CWD_BASENAME:
+    return (long long)directory_version();
+  case SEGMENT_TIME:
+    return (long long)time(NULL);
+  default:
+    return 0;
+  }
+}
+
+/**
+ * Renders a dynamic segment
+ *
+ * @return `0` on success, `-1` on allocation error
+ */
+static int render_segment(Segment *segment) {
+  char buffer[32];
+  const char *cwd = current_directory();
+  if (cwd == NULL)
+    cwd = "?";
+  size_t length;
+  switch (segment->type) {
+  case SEGMENT_STATUS:
+    return set_text(segment, buffer,
+                    (size_t)snprintf(buffer, sizeof(buffer), "%d",
+                                     last_exit_code));
+  case SEGMENT_STATUS_COLOR:
+    return set_text(segment,
+                    last_exit_code == 0 ? "\001\033[32m\002"
+                                        : "\001\033[31m\002",
+                    strlen("\001\033[32m\002"));
+  case SEGMENT_JOBS:
+    return set_text(
+        segment, buffer,
+        (size_t)snprintf(buffer, sizeof(buffer), "%d", shell->njob));
+  case SEGMENT_CWD:
+    length = strlen(cwd);
+    if (length <= MAX_PROMPT_LENGTH - 2)
+      return set_text(segment, cwd, length);
+    // "..." followed by the end of the path
+    char end[MAX_PROMPT_LENGTH];
+    memcpy(end, "...", 3);
+    memcpy(end + 3, cwd + length - (MAX_PROMPT_LENGTH - 8),
+           MAX_PROMPT_LENGTH - 8);
+    return set_text(segment, end, 3 + MAX_PROMPT_LENGTH - 8);
+  case SEGMENT_CWD_BASENAME: {
+    const char *slash = strrchr(cwd, '/');
+    const char *base = slash != NULL && slash[1] != '\0' ? slash + 1 : cwd;
+    return set_text(segment, base, strlen(base));
+  }
+  case SEGMENT_TIME: {
+    time_t now = (time_t)segment->input;
+    struct tm tm;
+    localtime_r(&now, &tm);
+    return set_text(segment, buffer,
+                    strftime(buffer, sizeof(buffer), "%H:%M:%S", &tm));
+  }
+  default:
+    return 0;
+  }
+}
+
+/**
+ * Builds the prompt from `$JSH_PS1`, compiled again only when it changes. The
+ * segments whose inputs did not change are not rendered again, and the
+ * prompt is not rebuilt when none changed
+ *
+ * @return the prompt, valid until the next call
+ */
+const char *build_prompt(void) {
+  const char *ps1 = get_variable("JSH_PS1");
+  if (ps1 == NULL)
+    ps1 = DEFAULT_PS1;
+  int changed = 0;
+  if (template == NULL || strcmp(template, ps1) != 0) {
+    if (compile_template(ps1) && compile_template(DEFAULT_PS1))
+      return "$ ";
+    changed = 1;
+  }
+
+  size_t length = 0;
+  for (size_t i = 0; i < nb_segments; i++) {
+    Segment *segment = &segments[i];
+    if (segment->type != SEGMENT_TEXT) {
+      long long input = segment_input(segment);
+      if (!segment->rendered || segment->input != input) {
+        segment->input = input;
+        segment->rendered = render_segment(segment) == 0;
+        changed = 1;
+      }
+    }
+    length += segment->length;
+  }
+  if (!changed && prompt != NULL)
+    return prompt;
+
+  if (length + 1 > prompt_size) {
+    char *new_prompt = realloc(prompt, length + 1);
+    if (new_prompt == NULL)
+      return "$ ";
+    prompt = new_prompt;
+    prompt_size = length + 1;
+  }
+  length = 0;
+  for (size_t i = 0; i < nb_segments; i++) {
+    memcpy(prompt + length, segments[i].text, segments[i].length);
+    length += segments[i].length;
+  }
+  prompt[length] = '\0';
+  return prompt;
+}
@@ -12,10 +12,19 @@ RedirectionMap redirections[] = {
     {"&", BACKGROUND, 0, 0, 0},
     {"<(", SUBSTITUTION, 0, 0, 0},
     {")", SUBSTITUTION_OUT, 0, 0, 0},
+    {";", SEQUENCE, 0, 0, 0},
+    {"\n", SEQUENCE, 0, 0, 0},
+    {"&&", AND, 0, 0, 0},
+    {"||", OR, 0, 0, 0},
+    {"{", GROUP, 0, 0, 0},
+    {"}", GROUP_OUT, 0, 0, 0},
+    {">&", DUP_OUT, 0, 0, 0},
+    {"<&", DUP_IN, 0, 0, 0},
+    {"2>&", DUP_ERR, 1, 0, 0},
 };
 
 int redirect_input(char *filename) {
-  int fd = open(filename, O_RDONLY);
+  int fd = open(filename, O_RDONLY | O_CLOEXEC);
 
   if (fd == -1) {
     fprintf(stderr, "jsh: open error (%s): %s\n", filename, strerror(errno));
@@ -42,7 +51,7 @@ int redirect_input(char *filename) {
  * @return 1 on failure, 0 on success
  */
 int redirect_output(char *filename, int err, int mode, int create) {
-  int fd = open(filename, mode | create,
+  int fd = open(filename, mode | create | O_CLOEXEC,
                 S_IRUSR | S_IWUSR | S_IRGRP | S_IWGRP | S_IROTH | S_IWOTH);
 
   if (fd == -1) {
@@ -61,16 +70,39 @@ int redirect_output(char *filename, int err, int mode, int create) {
 }
 
 /**
- * @brief Saves the current stdout, stdin and stderr
+ * @brief Makes `target` a copy of the descriptor `fd` : `>& N`, `<& N` and
+ * `2>& N`
+ * @param fd The number of the descriptor to copy
+ * @param target `STDIN_FILENO`, `STDOUT_FILENO` or `STDERR_FILENO`
+ * @return 1 on failure, 0 on success
+ */
+int redirect_fd(const char *fd, int target) {
+  char *end;
+  long n = strtol(fd, &end, 10);
+  if (*fd == '\0' || *end != '\0' || n < 0 || n > INT_MAX) {
+    fprintf(stderr, "jsh: %s: bad file descriptor\n", fd);
+    return 1;
+  }
+  if ((int)n != target && dup2((int)n, target) == -1) {
+    fprintf(stderr, "jsh: %s: %s\n", fd, strerror(errno));
+    return 1;
+  }
+  return 0;
+}
+
+/**
+ * @brief Saves the current stdout, stdin and stderr. The copies are
+ * close-on-exec and above the descriptors a command usually expects, so they
+ * are never inherited by the children
  * @param SAVE_STDOUT 
  * @param SAVE_STDIN 
  * @param SAVE_STDERR 
  * @return 1 on failure, 0 on success
  */
 int save_redirections(int *SAVE_STDOUT, int *SAVE_STDIN, int *SAVE_STDERR) {
-  *SAVE_STDOUT = dup(STDOUT_FILENO);
-  *SAVE_STDIN = dup(STDIN_FILENO);
-  *SAVE_STDERR = dup(STDERR_FILENO);
+  *SAVE_STDOUT = fcntl(STDOUT_FILENO, F_DUPFD_CLOEXEC, 10);
+  *SAVE_STDIN = fcntl(STDIN_FILENO, F_DUPFD_CLOEXEC, 10);
+  *SAVE_STDERR = fcntl(STDERR_FILENO, F_DUPFD_CLOEXEC, 10);
   if (*SAVE_STDOUT == -1 || *SAVE_STDIN == -1 || *SAVE_STDERR == -1) {
     perror("jsh: error dup");
     close(*SAVE_STDIN);
@@ -84,6 +116,7 @@ int save_redirections(int *SAVE_STDOUT, int *SAVE_STDIN, int *SAVE_STDERR) {
 int apply_redirections(Redirection *redirection) {
   int res = 0;
   int fd ; 
+  char *path;
   while (redirection != NULL) {
     for (size_t i = 0; i < sizeof(redirections) / sizeof(RedirectionMap); i++) {
       if (redirection->type == redirections[i].type) {
@@ -94,11 +127,28 @@ int apply_redirections(Redirection *redirection) {
         case REDIRECT_ERR:
         case PIPE_ERR:
         case APPEND_ERR:
-          res = redirect_output(redirection->value, redirections[i].err,
+          if ((path = expand_word(redirection->value)) == NULL)
+            return 1;
+          res = redirect_output(path, redirections[i].err,
                                 redirections[i].mode, redirections[i].create);
+          free(path);
           break;
         case REDIRECT_IN:
-          res = redirect_input(redirection->value);
+          if ((path = expand_word(redirection->value)) == NULL)
+            return 1;
+          res = redirect_input(path);
+          free(path);
+          break;
+        case DUP_OUT:
+        case DUP_IN:
+        case DUP_ERR:
+          if ((path = expand_word(redirection->value)) == NULL)
+            return 1;
+          res = redirect_fd(path, redirections[i].type == DUP_IN
+                                      ? STDIN_FILENO
+                                      : redirections[i].err ? STDERR_FILENO
+                                                            : STDOUT_FILENO);
+          free(path);
           break;
         case SUBSTITUTION_OUT:
           fd = atoi(redirection->value);
@@ -136,4 +186,72 @@ int reset_redirections(int SAVE_STDOUT, int SAVE_STDIN, int SAVE_STDERR) {
   close(SAVE_STDOUT);
   close(SAVE_STDERR);
   return res;
+}
+
+/**
+ * @brief Lets the substitutions passed as `/dev/fd/N` arguments of `cmd` be
+ * inherited by the program it executes. The substitutions used as
+ * redirections are opened by the shell itself and stay close-on-exec
+ * @param cmd the command reading the substitutions
+ * @param inherit `1` to clear `FD_CLOEXEC`, `0` to set it back
+ */
+void inherit_substitutions(Command *cmd, int inherit) {
+  char path[32];
+  for (size_t i = 0; i < cmd->nb_substitutions; i++) {
+    snprintf(path, sizeof(path), "/dev/fd/%d", cmd->substitution_fds[i]);
+    for (Argument *arg = cmd->arguments; arg != NULL; arg = arg->next) {
+      if (strcmp(arg->value, path) == 0) {
+        fcntl(cmd->substitution_fds[i], F_SETFD, inherit ? 0 : FD_CLOEXEC);
+        break;
+      }
+    }
+  }
+}
+
+/**
+ * @brief Lists the descriptors that the program `args[0]` is about to inherit
+ * and flags those outside of the expected set (stdin, stdout, stderr and the
+ * `/dev/fd/N` arguments). Enabled with `JSH_FD_AUDIT=1` (report on stderr) or
+ * `JSH_FD_AUDIT=<file>` (report appended to the file)
+ * @param args arguments of the program, called right before `execvp()`
+ */
+void audit_fds(char **args) {
+  DIR *dir = opendir("/proc/self/fd");
+  if (dir == NULL)
+    return;
+
+  int out = STDERR_FILENO;
+  if (strcmp(fd_audit, "1") != 0) {
+    out = open(fd_audit, O_WRONLY | O_APPEND | O_CREAT | O_CLOEXEC, 0644);
+    if (out == -1)
+      out = STDERR_FILENO;
+  }
+
+  struct dirent *entry;
+  while ((entry = readdir(dir)) != NULL) {
+    if (entry->d_name[0] == '.')
+      continue;
+    int fd = atoi(entry->d_name);
+    if (fd == dirfd(dir) || fd == out && out != STDERR_FILENO)
+      continue;
+    int flags = fcntl(fd, F_GETFD);
+    if (flags == -1 || flags & FD_CLOEXEC)
+      continue;
+
+    int expected = fd <= STDERR_FILENO;
+    char path[32];
+    snprintf(path, sizeof(path), "/dev/fd/%d", fd);
+    for (size_t i = 1; !expected && args[i] != NULL; i++)
+      expected = strcmp(args[i], path) == 0;
+
+    char link[32], target[PATH_MAX];
+    snprintf(link, sizeof(link), "/proc/self/fd/%d", fd);
+    ssize_t len = readlink(link, target, sizeof(target) - 1);
+    target[len < 0 ? 0 : len] = '\0';
+    dprintf(out, "jsh: fd audit: [%d] %s: fd %d -> %s%s\n", getpid(), args[0],
+            fd, target, expected ? "" : " (leaked)");
+  }
+  closedir(dir);
+  if (out != STDERR_FILENO)
+    close(out);
 }
\ No newline at end of file
@@ -0,0 +1,269 @@
+#include "../head/jsh.h"
+
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <time.h>
+
+#include "../head/jsh_proto.h"
+
+/**
+ * Microseconds of a `timeval`
+ */
+static int64_t microseconds(struct timeval time) {
+  return (int64_t)time.tv_sec * 1000000 + time.tv_usec;
+}
+
+/**
+ * Closes the descriptors of a request, up to the first `-1`
+ */
+static void close_request_fds(int fds[3]) {
+  for (int i = 0; i < 3 && fds[i] != -1; i++) {
+    close(fds[i]);
+    fds[i] = -1;
+  }
+}
+
+/**
+ * Receives the header of a request and the descriptors attached to it. The
+ * request is rejected unless exactly three descriptors come with it, in one
+ * or several `SCM_RIGHTS` messages : any other one received is closed
+ *
+ * @param fds : set to the three descriptors received, in order
+ * @return `0` on success, `-1` on error
+ */
+static int receive_request(int sock, jsh_request *request, int fds[3]) {
+  char control[CMSG_SPACE(3 * sizeof(int))];
+  struct iovec iov = {request, sizeof(*request)};
+  struct msghdr msg = {0};
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+  msg.msg_control = control;
+  msg.msg_controllen = sizeof(control);
+
+  ssize_t n;
+  while ((n = recvmsg(sock, &msg, MSG_CMSG_CLOEXEC)) == -1 && errno == EINTR)
+    ;
+  if (n <= 0)
+    return -1;
+  size_t received = 0;
+  for (struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg); cmsg != NULL;
+       cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+    if (cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_RIGHTS)
+      continue;
+    size_t count = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+    for (size_t i = 0; i < count; i++, received++) {
+      int fd;
+      memcpy(&fd, CMSG_DATA(cmsg) + i * sizeof(int), sizeof(int));
+      if (received < 3)
+        fds[received] = fd;
+      else
+        close(fd);
+    }
+  }
+  // descriptors beyond the control buffer were dropped by the kernel
+  if (received != 3 || msg.msg_flags & MSG_CTRUNC ||
+      ((size_t)n < sizeof(*request) &&
+       read_all(sock, (char *)request + n, sizeof(*request) - (size_t)n))) {
+    close_request_fds(fds);
+    return -1;
+  }
+  return 0;
+}
+
+/**
+ * Splits `count` NUL-terminated strings from `*payload`, of `*length` bytes
+ *
+ * @return the `NULL`-terminated array pointing into the payload, `NULL` if
+ * the payload is too short or on allocation error
+ */
+static char **split_strings(char **payload, size_t *length, size_t count) {
+  char **strings = malloc((count + 1) * sizeof(char *));
+  if (strings == NULL)
+    return NULL;
+  for (size_t i = 0; i < count; i++) {
+    char *end = memchr(*payload, '\0', *length);
+    if (end == NULL) {
+      free(strings);
+      return NULL;
+    }
+    strings[i] = *payload;
+    *length -= (size_t)(end + 1 - *payload);
+    *payload = end + 1;
+  }
+  strings[count] = NULL;
+  return strings;
+}
+
+/**
+ * Applies the changes of environment of a request : `NAME=value` exports a
+ * variable, `NAME` unsets it
+ */
+static void apply_environment(char **env) {
+  for (size_t i = 0; env[i] != NULL; i++) {
+    char *equal = strchr(env[i], '=');
+    if (equal == NULL) {
+      unset_variable(env[i]);
+      continue;
+    }
+    *equal = '\0';
+    if (is_name(env[i]) && set_variable(env[i], equal + 1, 1))
+      fprintf(stderr, "jsh: allocation error\n");
+    *equal = '=';
+  }
+}
+
+/**
+ * Runs a command line as typed in the shell
+ */
+static void run_line(char *line) {
+  errno = 0;
+  int incomplete;
+  Command *commands = parse_command(line, &incomplete);
+  if (incomplete) {
+    fprintf(stderr, "jsh: error: Syntax error: unexpected end of file\n");
+    errno = 2;
+  }
+  if (errno != 0) {
+    last_exit_code = 2;
+  } else {
+    execution(commands, 0);
+  }
+  clear_command(commands);
+}
+
+/**
+ * Serves a connection, in a copy of the server : reads the request, runs it
+ * with its descriptors, directory and environment, and sends the replies
+ */
+static void serve_connection(int sock) {
+  struct timespec start;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  jsh_request request;
+  int fds[3] = {-1, -1, -1};
+  if (receive_request(sock, &request, fds) ||
+      request.magic != JSH_PROTO_MAGIC ||
+      request.version != JSH_PROTO_VERSION || request.nb_fds != 3 ||
+      request.length > JSH_PROTO_MAX_PAYLOAD || request.nb_words == 0)
+    exit(EXIT_FAILURE);
+  char *payload = malloc((size_t)request.length + 1);
+  if (payload == NULL || read_all(sock, payload, request.length))
+    exit(EXIT_FAILURE);
+  payload[request.length] = '\0';
+
+  char *cursor = payload;
+  size_t length = request.length;
+  char **cwd = split_strings(&cursor, &length, 1);
+  char **words = split_strings(&cursor, &length, request.nb_words);
+  char **env = split_strings(&cursor, &length, request.nb_env);
+  if (cwd == NULL || words == NULL || env == NULL)
+    exit(EXIT_FAILURE);
+
+  // the command runs on the descriptors of the client
+  for (int i = 0; i < 3; i++) {
+    if (fds[i] != i) {
+      dup2(fds[i], i);
+      close(fds[i]);
+    }
+  }
+  // the process runs the request as the shell would, with job control
+  shell_pid = getpid();
+  jsh_reply reply = {JSH_PROTO_MAGIC, JSH_REPLY_STARTED, getpid(), 0, 0, 0, 0, 0};
+  write_all(sock, &reply, sizeof(reply));
+
+  if (*cwd[0] != '\0' && change_directory(cwd[0], 0) == -1) {
+    fprintf(stderr, "jsh: %s: %s\n", cwd[0], strerror(errno));
+    last_exit_code = EXIT_FAILURE;
+  } else {
+    apply_environment(env);
+    if (request.flags & JSH_REQUEST_LINE)
+      run_line(words[0]);
+    else
+      execute_command(words, 1);
+  }
+
+  struct rusage self, children;
+  struct timespec end;
+  getrusage(RUSAGE_SELF, &self);
+  getrusage(RUSAGE_CHILDREN, &children);
+  clock_gettime(CLOCK_MONOTONIC, &end);
+  reply.type = JSH_REPLY_DONE;
+  reply.status = last_exit_code;
+  reply.utime_us = microseconds(self.ru_utime) + microseconds(children.ru_utime);
+  reply.stime_us = microseconds(self.ru_stime) + microseconds(children.ru_stime);
+  reply.maxrss_kb = self.ru_maxrss > children.ru_maxrss ? self.ru_maxrss
+                                                        : children.ru_maxrss;
+  reply.real_us = (int64_t)(end.tv_sec - start.tv_sec) * 1000000 +
+                  (end.tv_nsec - start.tv_nsec) / 1000;
+  // the output of the command reaches the client before the status
+  fflush(stdout);
+  write_all(sock, &reply, sizeof(reply));
+  exit(last_exit_code);
+}
+
+/**
+ * `jsh --serve path` : serves the requests of `jshc` on the Unix socket
+ * `path` (see `jsh_proto.h`). Each connection is served by a copy of the
+ * server, which keeps its variables and caches warm and isolates the
+ * directory and environment of each request
+ *
+ * @return the exit code of the server, on error
+ */
+int serve(const char *path) {
+  struct sockaddr_un address = {0};
+  address.sun_family = AF_UNIX;
+  if (strlen(path) >= sizeof(address.sun_path)) {
+    fprintf(stderr, "jsh: --serve: %s: path too long\n", path);
+    return EXIT_FAILURE;
+  }
+  strcpy(address.sun_path, path);
+
+  int sock = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (sock == -1) {
+    perror("jsh: --serve: socket");
+    return EXIT_FAILURE;
+  }
+  // a socket left by a previous server is replaced, not another file
+  struct stat st;
+  if (lstat(path, &st) == 0 && S_ISSOCK(st.st_mode))
+    unlink(path);
+  mode_t mask = umask(077);
+  int error = bind(sock, (struct sockaddr *)&address, sizeof(address)) == -1 ||
+              listen(sock, SOMAXCONN) == -1;
+  umask(mask);
+  if (error) {
+    fprintf(stderr, "jsh: --serve: %s: %s\n", path, strerror(errno));
+    close(sock);
+    return EXIT_FAILURE;
+  }
+
+  // the servers of the connections are reaped by the kernel
+  struct sigaction sa = {0};
+  sa.sa_handler = SIG_IGN;
+  sa.sa_flags = SA_NOCLDWAIT;
+  sigaction(SIGCHLD, &sa, NULL);
+
+  while (1) {
+    int connection = accept4(sock, NULL, NULL, SOCK_CLOEXEC);
+    if (connection == -1) {
+      if (errno == EINTR || errno == ECONNABORTED || errno == EMFILE ||
+          errno == ENFILE)
+        continue;
+      perror("jsh: --serve: accept");
+      break;
+    }
+    pid_t pid = fork();
+    if (pid == 0) {
+      close(sock);
+      sa.sa_handler = SIG_DFL;
+      sa.sa_flags = 0;
+      sigaction(SIGCHLD, &sa, NULL);
+      serve_connection(connection);
+    }
+    if (pid == -1)
+      perror("jsh: --serve: fork error");
+    close(connection);
+  }
+  close(sock);
+  return EXIT_FAILURE;
+}
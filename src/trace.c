@@ -0,0 +1,226 @@
+#include "../head/jsh.h"
+
+#include <stdatomic.h>
+#include <sys/mman.h>
+#include <time.h>
+
+/*
+ * `JSH_TRACE=file` records the events of the shell and of its children in a
+ * ring buffer mapped before the first fork, shared by all of them. A writer
+ * reserves a slot with one atomic increment, fills it, then publishes it by
+ * storing its sequence number : no lock, and the oldest events are
+ * overwritten when the ring is full. When the shell exits, the events are
+ * written to `file` in the Chrome trace format, read by `chrome://tracing`
+ * and Perfetto.
+ */
+
+#define TRACE_EVENTS (1 << 16)
+#define TRACE_NAME_SIZE 48
+
+typedef struct {
+  _Atomic uint32_t seq; // index of the event + 1 once written
+  int32_t type;
+  int32_t pid;     // process recording the event
+  int32_t subject; // process the event is about
+  int64_t arg;
+  int64_t time; // nanoseconds, `CLOCK_MONOTONIC`
+  char name[TRACE_NAME_SIZE];
+} TraceEvent;
+
+struct TraceRing {
+  _Atomic uint64_t next;
+  TraceEvent events[TRACE_EVENTS];
+};
+
+TraceRing *trace_ring = NULL;
+static char *trace_path = NULL;
+static pid_t trace_owner;
+
+static const char *job_states[] = {"Running", "Stopped", "Done", "Killed",
+                                   "Detached"};
+
+/**
+ * Records an event, through the `TRACE()` macro which only calls it when
+ * tracing is enabled
+ *
+ * @param subject : process the event is about
+ * @param arg : status, state or process group, depending on `type`
+ * @param name : program or command, `NULL` if none
+ */
+void trace_event(trace_type type, pid_t subject, int64_t arg,
+                 const char *name) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  uint64_t index =
+      atomic_fetch_add_explicit(&trace_ring->next, 1, memory_order_relaxed);
+  TraceEvent *event = &trace_ring->events[index % TRACE_EVENTS];
+  // a reader skips the slot while it is being written
+  atomic_store_explicit(&event->seq, 0, memory_order_relaxed);
+  atomic_thread_fence(memory_order_release);
+  event->type = (int32_t)type;
+  event->pid = getpid();
+  event->subject = subject;
+  event->arg = arg;
+  event->time = (int64_t)now.tv_sec * 1000000000 + now.tv_nsec;
+  if (name != NULL) {
+    strncpy(event->name, name, TRACE_NAME_SIZE - 1);
+    event->name[TRACE_NAME_SIZE - 1] = '\0';
+  } else {
+    event->name[0] = '\0';
+  }
+  atomic_store_explicit(&event->seq, (uint32_t)(index + 1),
+                        memory_order_release);
+}
+
+/**
+ * Writes `s` as a JSON string
+ */
+void write_json_string(FILE *file, const char *s) {
+  fputc('"', file);
+  for (; *s != '\0'; s++) {
+    if (*s == '"' || *s == '\\')
+      fprintf(file, "\\%c", *s);
+    else if ((unsigned char)*s < 0x20)
+      fprintf(file, "\\u%04x", (unsigned char)*s);
+    else
+      fputc(*s, file);
+  }
+  fputc('"', file);
+}
+
+/**
+ * Writes an event in the Chrome trace format. The processes are the threads
+ * of a single trace process, the one of the shell : a process is a slice
+ * from its fork to its end
+ */
+static void write_event(FILE *file, const TraceEvent *event, int *first) {
+  const char *name;
+  const char *phase = "i";
+  pid_t tid = event->pid;
+  switch ((trace_type)event->type) {
+  case TRACE_PARSE_BEGIN:
+    name = "parse";
+    phase = "B";
+    break;
+  case TRACE_PARSE_END:
+    name = "parse";
+    phase = "E";
+    break;
+  case TRACE_FORK:
+    name = "fork";
+    break;
+  case TRACE_EXEC:
+    name = "exec";
+    break;
+  case TRACE_EXIT:
+    name = "exit";
+    break;
+  case TRACE_STOP:
+    name = "stopped";
+    tid = event->subject;
+    break;
+  case TRACE_JOB:
+    name = "job";
+    tid = event->subject;
+    break;
+  case TRACE_TERMINAL:
+    name = "tcsetpgrp";
+    break;
+  default:
+    return;
+  }
+  double ts = (double)event->time / 1000.0;
+  fprintf(file, "%s\n{\"name\":", *first ? "" : ",");
+  *first = 0;
+  write_json_string(file, name);
+  fprintf(file, ",\"ph\":\"%s\",\"ts\":%.3f,\"pid\":%d,\"tid\":%d", phase, ts,
+          trace_owner, tid);
+  if (*phase == 'i')
+    fprintf(file, ",\"s\":\"t\"");
+  switch ((trace_type)event->type) {
+  case TRACE_FORK:
+    fprintf(file, ",\"args\":{\"child\":%d}}", event->subject);
+    // the life of the child, ended by its `TRACE_EXIT`
+    fprintf(file, ",\n{\"name\":\"process\",\"ph\":\"B\",\"ts\":%.3f,"
+                  "\"pid\":%d,\"tid\":%d}",
+            ts, trace_owner, event->subject);
+    return;
+  case TRACE_EXEC:
+    fprintf(file, ",\"args\":{\"program\":");
+    write_json_string(file, event->name);
+    fprintf(file, "}}");
+    return;
+  case TRACE_EXIT:
+    fprintf(file, ",\"args\":{\"child\":%d,\"status\":%lld}}", event->subject,
+            (long long)event->arg);
+    fprintf(file, ",\n{\"ph\":\"E\",\"ts\":%.3f,\"pid\":%d,\"tid\":%d}", ts,
+            trace_owner, event->subject);
+    return;
+  case TRACE_JOB:
+    fprintf(file, ",\"args\":{\"state\":\"%s\",\"command\":",
+            event->arg >= 0 && event->arg < 5 ? job_states[event->arg] : "?");
+    write_json_string(file, event->name);
+    fprintf(file, "}}");
+    return;
+  case TRACE_TERMINAL:
+    fprintf(file, ",\"args\":{\"pgid\":%lld}}", (long long)event->arg);
+    return;
+  default:
+    fprintf(file, "}");
+  }
+}
+
+/**
+ * Writes the events of the ring to the trace file, when the shell exits
+ */
+static void write_trace(void) {
+  if (trace_ring == NULL || getpid() != trace_owner)
+    return;
+  FILE *file = fopen(trace_path, "we");
+  if (file == NULL) {
+    fprintf(stderr, "jsh: %s: %s\n", trace_path, strerror(errno));
+    return;
+  }
+  uint64_t next = atomic_load_explicit(&trace_ring->next, memory_order_acquire);
+  uint64_t start = next > TRACE_EVENTS ? next - TRACE_EVENTS : 0;
+  fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[");
+  fprintf(file, "\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%d,"
+                "\"tid\":%d,\"args\":{\"name\":\"jsh\"}}",
+          trace_owner, trace_owner);
+  int first = 0;
+  for (uint64_t index = start; index < next; index++) {
+    TraceEvent *event = &trace_ring->events[index % TRACE_EVENTS];
+    if (atomic_load_explicit(&event->seq, memory_order_acquire) !=
+        (uint32_t)(index + 1))
+      continue;
+    write_event(file, event, &first);
+  }
+  fprintf(file, "\n]}\n");
+  if (fclose(file) == EOF)
+    fprintf(stderr, "jsh: %s: %s\n", trace_path, strerror(errno));
+}
+
+/**
+ * Enables tracing : maps the ring shared with the children to come, and
+ * writes the trace to `path` when the calling process exits
+ *
+ * @return `0` on success, `-1` on error
+ */
+int start_trace(const char *path) {
+  if (trace_ring != NULL)
+    return 0;
+  trace_path = strdup(path);
+  if (trace_path == NULL)
+    return -1;
+  TraceRing *ring = mmap(NULL, sizeof(TraceRing), PROT_READ | PROT_WRITE,
+                         MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+  if (ring == MAP_FAILED) {
+    free(trace_path);
+    trace_path = NULL;
+    return -1;
+  }
+  trace_owner = getpid();
+  trace_ring = ring;
+  atexit(write_trace);
+  return 0;
+}
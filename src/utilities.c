@@ -0,0 +1,777 @@
+#include "../head/jsh.h"
+
+#include <ctype.h>
+
+/**
+ * Writes the output `buffer` of a built-in, collected by `open_memstream()`,
+ * to its standard output in a single call when possible
+ *
+ * @param name : name of the built-in, for the error message
+ * @param out : stream of the buffer, closed
+ * @param buffer : buffer of the stream, freed
+ * @param size : size of the buffer, set by `fclose()`
+ * @return `0` on success, `1` on write error
+ */
+static int write_output(const char *name, FILE *out, char **buffer,
+                        size_t *size) {
+  int error = fclose(out) != 0;
+  for (size_t written = 0; !error && written < *size;) {
+    ssize_t n = write(builtin_stdout, *buffer + written, *size - written);
+    if (n == -1 && errno != EINTR)
+      error = 1;
+    else if (n > 0)
+      written += (size_t)n;
+  }
+  if (error)
+    fprintf(stderr, "jsh: %s: write error: %s\n", name, strerror(errno));
+  free(*buffer);
+  return error;
+}
+
+/**
+ * Writes the character of the escape sequence starting after the backslash
+ * at `*p`, and moves `*p` after the sequence
+ *
+ * @param zero : `1` if octal values start with `\0` (`echo`, `%b`), `0` if
+ * they do not (format of `printf`)
+ * @return `1` for `\c`, which ends the output, `0` otherwise
+ */
+static int put_escape(FILE *out, const char **p, int zero) {
+  const char *s = *p;
+  int c = (unsigned char)*s++;
+  switch (c) {
+  case 'a': c = '\a'; break;
+  case 'b': c = '\b'; break;
+  case 'e': c = 033; break;
+  case 'f': c = '\f'; break;
+  case 'n': c = '\n'; break;
+  case 'r': c = '\r'; break;
+  case 't': c = '\t'; break;
+  case 'v': c = '\v'; break;
+  case '\\': break;
+  case 'c':
+    *p = s;
+    return 1;
+  case 'x':
+    if (!isxdigit((unsigned char)*s)) {
+      c = '\\';
+      s--;
+      break;
+    }
+    c = 0;
+    for (int i = 0; i < 2 && isxdigit((unsigned char)*s); i++, s++)
+      c = c * 16 + (isdigit((unsigned char)*s) ? *s - '0'
+                                               : tolower((unsigned char)*s) - 'a' + 10);
+    break;
+  case '\0':
+    c = '\\';
+    s--;
+    break;
+  default:
+    if (c >= '0' && c <= '7' && (!zero || c == '0')) {
+      s -= !zero;
+      c = 0;
+      for (int i = 0; i < 3 && *s >= '0' && *s <= '7'; i++, s++)
+        c = c * 8 + *s - '0';
+    } else {
+      // unknown sequences are written as is
+      fputc('\\', out);
+    }
+  }
+  fputc(c, out);
+  *p = s;
+  return 0;
+}
+
+/**
+ * `echo [-neE] [arg...]` : writes the arguments separated by spaces. `-n`
+ * omits the final newline, `-e` interprets the escape sequences, `-E` does not
+ *
+ * @param args : command arguments
+ */
+int jecho(char **args) {
+  int newline = 1;
+  int escapes = 0;
+  size_t i = 1;
+  for (; args[i] != NULL && args[i][0] == '-' && args[i][1] != '\0' &&
+         strspn(args[i] + 1, "neE") == strlen(args[i] + 1);
+       i++) {
+    for (const char *opt = args[i] + 1; *opt != '\0'; opt++) {
+      if (*opt == 'n')
+        newline = 0;
+      else
+        escapes = *opt == 'e';
+    }
+  }
+
+  char *buffer = NULL;
+  size_t size;
+  FILE *out = open_memstream(&buffer, &size);
+  if (out == NULL) {
+    perror("jsh: echo");
+    return EXIT_FAILURE;
+  }
+  for (size_t first = i; args[i] != NULL; i++) {
+    if (i > first)
+      fputc(' ', out);
+    if (!escapes) {
+      fputs(args[i], out);
+      continue;
+    }
+    for (const char *p = args[i]; *p != '\0';) {
+      if (*p != '\\') {
+        fputc(*p++, out);
+        continue;
+      }
+      p++;
+      if (put_escape(out, &p, 1)) {
+        newline = 0;
+        goto end;
+      }
+    }
+  }
+end:
+  if (newline)
+    fputc('\n', out);
+  return write_output("echo", out, &buffer, &size);
+}
+
+/**
+ * Converts an argument of `printf` to a number : a C integer constant, or the
+ * code of the character following a quote
+ *
+ * @param error : set to `1` if `arg` is not entirely a number
+ */
+static long long printf_number(const char *arg, int *error) {
+  if (arg[0] == '\'' || arg[0] == '"')
+    return (unsigned char)arg[1];
+  char *end;
+  errno = 0;
+  long long n = strtoll(arg, &end, 0);
+  if (*arg == '\0' || *end != '\0' || errno == ERANGE) {
+    fprintf(stderr, "jsh: printf: %s: invalid number\n", arg);
+    *error = 1;
+  }
+  return n;
+}
+
+/**
+ * Converts an argument of `printf` to a floating number
+ *
+ * @param error : set to `1` if `arg` is not entirely a number
+ */
+static double printf_float(const char *arg, int *error) {
+  if (arg[0] == '\'' || arg[0] == '"')
+    return (unsigned char)arg[1];
+  char *end;
+  double n = strtod(arg, &end);
+  if (*arg == '\0' || *end != '\0') {
+    fprintf(stderr, "jsh: printf: %s: invalid number\n", arg);
+    *error = 1;
+  }
+  return n;
+}
+
+// the conversions of the format are checked before being passed to
+// `fprintf()`
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wformat-nonliteral"
+
+/**
+ * Writes the format of `printf` once, with the arguments from `args[*used]`
+ *
+ * @param used : number of arguments consumed, updated
+ * @param error : set to `1` on an invalid number or format
+ * @return `1` if the output is over (`\c`, invalid format), `0` otherwise
+ */
+static int printf_format(FILE *out, const char *format, char **args,
+                         size_t *used, int *error) {
+  for (const char *p = format; *p != '\0';) {
+    if (*p == '\\') {
+      p++;
+      if (put_escape(out, &p, 0))
+        return 1;
+      continue;
+    }
+    if (*p != '%' || p[1] == '%') {
+      fputc(*p, out);
+      p += *p == '%' ? 2 : 1;
+      continue;
+    }
+
+    // the conversion is rebuilt for `fprintf()`, `*` replaced by the numbers
+    char spec[64];
+    size_t len = 0;
+    spec[len++] = *p++;
+    while (*p != '\0' && strchr("-+ #0", *p) != NULL && len < 8)
+      spec[len++] = *p++;
+    for (int part = 0; part < 2; part++) {
+      if (part == 1) {
+        if (*p != '.')
+          break;
+        spec[len++] = *p++;
+      }
+      if (*p == '*') {
+        p++;
+        const char *arg = args[*used] != NULL ? args[(*used)++] : "0";
+        len += (size_t)snprintf(spec + len, 24, "%d",
+                                (int)printf_number(arg, error));
+      }
+      while (isdigit((unsigned char)*p) && len < 48)
+        spec[len++] = *p++;
+    }
+
+    char conversion = *p;
+    if (conversion == '\0' || strchr("diouxXeEfFgGaAcsb", conversion) == NULL) {
+      fprintf(stderr, "jsh: printf: %%%c: invalid format character\n",
+              conversion);
+      *error = 1;
+      return 1;
+    }
+    p++;
+    const char *arg = args[*used] != NULL ? args[(*used)++] : NULL;
+    if (strchr("diouxX", conversion) != NULL) {
+      spec[len++] = 'l';
+      spec[len++] = 'l';
+    }
+    spec[len++] = conversion == 'b' ? 's' : conversion;
+    spec[len] = '\0';
+
+    switch (conversion) {
+    case 'd':
+    case 'i':
+      fprintf(out, spec, arg != NULL ? printf_number(arg, error) : 0LL);
+      break;
+    case 'o':
+    case 'u':
+    case 'x':
+    case 'X':
+      fprintf(out, spec,
+              (unsigned long long)(arg != NULL ? printf_number(arg, error) : 0));
+      break;
+    case 'c':
+      if (arg != NULL && *arg != '\0')
+        fprintf(out, spec, *arg);
+      break;
+    case 's':
+      fprintf(out, spec, arg != NULL ? arg : "");
+      break;
+    case 'b': {
+      // the escape sequences of the argument are expanded first
+      char *expanded = NULL;
+      size_t size;
+      FILE *tmp = open_memstream(&expanded, &size);
+      if (tmp == NULL)
+        return 1;
+      int stop = 0;
+      for (const char *s = arg != NULL ? arg : ""; *s != '\0' && !stop;) {
+        if (*s != '\\')
+          fputc(*s++, tmp);
+        else if (s++, put_escape(tmp, &s, 1))
+          stop = 1;
+      }
+      fclose(tmp);
+      fprintf(out, spec, expanded);
+      free(expanded);
+      if (stop)
+        return 1;
+      break;
+    }
+    default:
+      fprintf(out, spec, arg != NULL ? printf_float(arg, error) : 0.0);
+    }
+  }
+  return 0;
+}
+
+#pragma GCC diagnostic pop
+
+/**
+ * `printf format [arg...]` : writes the arguments according to `format`,
+ * which is reused while arguments remain
+ *
+ * @param args : command arguments
+ */
+int jprintf(char **args) {
+  size_t first = 1;
+  if (args[first] != NULL && strcmp(args[first], "--") == 0)
+    first++;
+  if (args[first] == NULL) {
+    fprintf(stderr, "jsh: printf: usage: printf format [arguments]\n");
+    return 2;
+  }
+
+  char *buffer = NULL;
+  size_t size;
+  FILE *out = open_memstream(&buffer, &size);
+  if (out == NULL) {
+    perror("jsh: printf");
+    return EXIT_FAILURE;
+  }
+  char **values = args + first + 1;
+  size_t used = 0;
+  int error = 0;
+  while (1) {
+    size_t before = used;
+    if (printf_format(out, args[first], values, &used, &error))
+      break;
+    // the format is reused only if it consumes arguments
+    if (values[used] == NULL || used == before)
+      break;
+  }
+  if (write_output("printf", out, &buffer, &size))
+    error = 1;
+  return error ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+typedef struct {
+  char **args;
+  size_t pos;
+  size_t end;
+  int error; // `1` after a syntax error
+} TestState;
+
+/**
+ * Reports a syntax error of `test`
+ */
+static int test_error(TestState *state, const char *message, const char *arg) {
+  if (!state->error) {
+    if (arg != NULL)
+      fprintf(stderr, "jsh: test: %s: %s\n", arg, message);
+    else
+      fprintf(stderr, "jsh: test: %s\n", message);
+  }
+  state->error = 1;
+  return 0;
+}
+
+/**
+ * Checks if `op` is a unary operator of `test`
+ */
+static int is_unary(const char *op) {
+  return op[0] == '-' && op[1] != '\0' && op[2] == '\0' &&
+         strchr("bcdefghkLnOGprsStuwxz", op[1]) != NULL;
+}
+
+/**
+ * Checks if `op` is a binary operator of `test`
+ */
+static int is_binary(const char *op) {
+  static const char *const binaries[] = {"=",   "==",  "!=",  "<",   ">",
+                                         "-eq", "-ne", "-lt", "-le", "-gt",
+                                         "-ge", "-nt", "-ot", "-ef", NULL};
+  for (size_t i = 0; binaries[i] != NULL; i++) {
+    if (strcmp(op, binaries[i]) == 0)
+      return 1;
+  }
+  return 0;
+}
+
+/**
+ * Evaluates the unary operator `op` of `test` on `arg`
+ */
+static int test_unary(TestState *state, const char *op, const char *arg) {
+  struct stat st;
+  switch (op[1]) {
+  case 'n':
+    return arg[0] != '\0';
+  case 'z':
+    return arg[0] == '\0';
+  case 't': {
+    char *end;
+    long fd = strtol(arg, &end, 10);
+    if (*arg == '\0' || *end != '\0')
+      return test_error(state, "integer expression expected", arg);
+    return fd >= 0 && fd <= INT_MAX && isatty((int)fd);
+  }
+  case 'r':
+    return eaccess(arg, R_OK) == 0;
+  case 'w':
+    return eaccess(arg, W_OK) == 0;
+  case 'x':
+    return eaccess(arg, X_OK) == 0;
+  case 'h':
+  case 'L':
+    return lstat(arg, &st) == 0 && S_ISLNK(st.st_mode);
+  }
+  if (stat(arg, &st) != 0)
+    return 0;
+  switch (op[1]) {
+  case 'b': return S_ISBLK(st.st_mode);
+  case 'c': return S_ISCHR(st.st_mode);
+  case 'd': return S_ISDIR(st.st_mode);
+  case 'f': return S_ISREG(st.st_mode);
+  case 'p': return S_ISFIFO(st.st_mode);
+  case 'S': return S_ISSOCK(st.st_mode);
+  case 'g': return (st.st_mode & S_ISGID) != 0;
+  case 'u': return (st.st_mode & S_ISUID) != 0;
+  case 'k': return (st.st_mode & S_ISVTX) != 0;
+  case 's': return st.st_size > 0;
+  case 'O': return st.st_uid == geteuid();
+  case 'G': return st.st_gid == getegid();
+  default: return 1; // `-e`
+  }
+}
+
+/**
+ * Converts an operand of an integer comparison of `test`
+ */
+static long long test_integer(TestState *state, const char *arg) {
+  char *end;
+  errno = 0;
+  long long n = strtoll(arg, &end, 10);
+  while (isspace((unsigned char)*end))
+    end++;
+  if (*arg == '\0' || *end != '\0' || errno == ERANGE)
+    test_error(state, "integer expression expected", arg);
+  return n;
+}
+
+/**
+ * Evaluates the binary operator `op` of `test`
+ */
+static int test_binary(TestState *state, const char *left, const char *op,
+                       const char *right) {
+  if (strcmp(op, "=") == 0 || strcmp(op, "==") == 0)
+    return strcmp(left, right) == 0;
+  if (strcmp(op, "!=") == 0)
+    return strcmp(left, right) != 0;
+  if (strcmp(op, "<") == 0)
+    return strcoll(left, right) < 0;
+  if (strcmp(op, ">") == 0)
+    return strcoll(left, right) > 0;
+
+  if (op[1] == 'n' || op[1] == 'o' || (op[1] == 'e' && op[2] == 'f')) {
+    struct stat l, r;
+    int has_left = stat(left, &l) == 0;
+    int has_right = stat(right, &r) == 0;
+    if (op[1] == 'e')
+      return has_left && has_right && l.st_dev == r.st_dev &&
+             l.st_ino == r.st_ino;
+    // a missing file is older than any other
+    if (!has_left || !has_right)
+      return op[1] == 'n' ? has_left : has_right;
+    int newer = l.st_mtim.tv_sec != r.st_mtim.tv_sec
+                    ? l.st_mtim.tv_sec > r.st_mtim.tv_sec
+                    : l.st_mtim.tv_nsec > r.st_mtim.tv_nsec;
+    int older = l.st_mtim.tv_sec != r.st_mtim.tv_sec
+                    ? l.st_mtim.tv_sec < r.st_mtim.tv_sec
+                    : l.st_mtim.tv_nsec < r.st_mtim.tv_nsec;
+    return op[1] == 'n' ? newer : older;
+  }
+
+  long long a = test_integer(state, left);
+  long long b = test_integer(state, right);
+  if (strcmp(op, "-eq") == 0)
+    return a == b;
+  if (strcmp(op, "-ne") == 0)
+    return a != b;
+  if (strcmp(op, "-lt") == 0)
+    return a < b;
+  if (strcmp(op, "-le") == 0)
+    return a <= b;
+  if (strcmp(op, "-gt") == 0)
+    return a > b;
+  return a >= b; // `-ge`
+}
+
+static int test_or(TestState *state);
+
+/**
+ * `primary : ( expr ) | unary-op arg | arg binary-op arg | arg`
+ */
+static int test_primary(TestState *state) {
+  char **args = state->args;
+  size_t left = state->end - state->pos;
+  if (left == 0)
+    return test_error(state, "argument expected", NULL);
+  const char *arg = args[state->pos];
+  if (left >= 3 && is_binary(args[state->pos + 1])) {
+    state->pos += 3;
+    return test_binary(state, arg, args[state->pos - 2], args[state->pos - 1]);
+  }
+  if (strcmp(arg, "(") == 0) {
+    state->pos++;
+    int result = test_or(state);
+    if (state->pos >= state->end || strcmp(args[state->pos], ")") != 0)
+      return test_error(state, "`)' expected", NULL);
+    state->pos++;
+    return result;
+  }
+  if (left >= 2 && is_unary(arg)) {
+    state->pos += 2;
+    return test_unary(state, arg, args[state->pos - 1]);
+  }
+  state->pos++;
+  return arg[0] != '\0';
+}
+
+/**
+ * `not : ! not | primary`
+ */
+static int test_not(TestState *state) {
+  if (state->pos < state->end && strcmp(state->args[state->pos], "!") == 0) {
+    state->pos++;
+    return !test_not(state);
+  }
+  return test_primary(state);
+}
+
+/**
+ * `and : not [-a and]`
+ */
+static int test_and(TestState *state) {
+  int result = test_not(state);
+  while (state->pos < state->end && strcmp(state->args[state->pos], "-a") == 0) {
+    state->pos++;
+    // both sides are parsed, to report syntax errors
+    result = test_not(state) && result;
+  }
+  return result;
+}
+
+/**
+ * `or : and [-o or]`
+ */
+static int test_or(TestState *state) {
+  int result = test_and(state);
+  while (state->pos < state->end && strcmp(state->args[state->pos], "-o") == 0) {
+    state->pos++;
+    result = test_and(state) || result;
+  }
+  return result;
+}
+
+/**
+ * Evaluates the expression `args[pos..end[` of `test`, with the rules of
+ * POSIX for up to 4 arguments
+ */
+static int test_expression(TestState *state) {
+  char **args = state->args + state->pos;
+  size_t count = state->end - state->pos;
+  switch (count) {
+  case 0:
+    return 0;
+  case 1:
+    state->pos++;
+    return args[0][0] != '\0';
+  case 2:
+    if (strcmp(args[0], "!") == 0) {
+      state->pos += 2;
+      return args[1][0] == '\0';
+    }
+    if (is_unary(args[0])) {
+      state->pos += 2;
+      return test_unary(state, args[0], args[1]);
+    }
+    return test_error(state, "unary operator expected", args[0]);
+  case 3:
+    if (is_binary(args[1]) || strcmp(args[1], "-a") == 0 ||
+        strcmp(args[1], "-o") == 0)
+      break;
+    if (strcmp(args[0], "!") == 0) {
+      state->pos++;
+      return !test_expression(state);
+    }
+    if (strcmp(args[0], "(") == 0 && strcmp(args[2], ")") == 0) {
+      state->pos += 3;
+      return args[1][0] != '\0';
+    }
+    break;
+  case 4:
+    if (strcmp(args[0], "!") == 0) {
+      state->pos++;
+      return !test_expression(state);
+    }
+    if (strcmp(args[0], "(") == 0 && strcmp(args[3], ")") == 0) {
+      state->pos++;
+      state->end--;
+      int result = test_expression(state);
+      state->end++;
+      state->pos++;
+      return result;
+    }
+    break;
+  }
+  return test_or(state);
+}
+
+/**
+ * `test expr` or `[ expr ]` : evaluates a conditional expression. The exit
+ * code is `0` if it is true, `1` if it is false, `2` on error
+ *
+ * @param args : command arguments
+ */
+int jtest(char **args) {
+  size_t end = 1;
+  while (args[end] != NULL)
+    end++;
+  if (strcmp(args[0], "[") == 0) {
+    if (strcmp(args[end - 1], "]") != 0 || end == 1) {
+      fprintf(stderr, "jsh: [: missing `]'\n");
+      return 2;
+    }
+    end--;
+  }
+  TestState state = {args, 1, end, 0};
+  int result = test_expression(&state);
+  if (!state.error && state.pos < state.end)
+    test_error(&state, "too many arguments", NULL);
+  return state.error ? 2 : !result;
+}
+
+/**
+ * Checks if `c` is a separator of `ifs`, and if it is a white space
+ */
+static int is_ifs(const char *ifs, char c, int *space) {
+  if (c == '\0' || strchr(ifs, c) == NULL)
+    return 0;
+  *space = c == ' ' || c == '\t' || c == '\n';
+  return 1;
+}
+
+/**
+ * `read [-r] [-p prompt] [name...]` : reads a line of the standard input and
+ * splits it into the variables `name` (`REPLY` by default) with `IFS`. The
+ * last variable receives the rest of the line. Without `-r`, a backslash
+ * protects the next character and joins the lines
+ *
+ * @param args : command arguments
+ */
+int jread(char **args) {
+  int raw = 0;
+  const char *prompt = NULL;
+  size_t i = 1;
+  for (; args[i] != NULL && args[i][0] == '-' && args[i][1] != '\0'; i++) {
+    if (strcmp(args[i], "--") == 0) {
+      i++;
+      break;
+    }
+    if (strcmp(args[i], "-r") == 0) {
+      raw = 1;
+    } else if (strcmp(args[i], "-p") == 0 && args[i + 1] != NULL) {
+      prompt = args[++i];
+    } else {
+      fprintf(stderr, "jsh: read: %s: invalid option\n", args[i]);
+      return 2;
+    }
+  }
+  char *reply[] = {"REPLY", NULL};
+  char **names = args[i] != NULL ? args + i : reply;
+  for (size_t k = 0; names[k] != NULL; k++) {
+    if (!is_name(names[k])) {
+      fprintf(stderr, "jsh: read: `%s': not a valid identifier\n", names[k]);
+      return EXIT_FAILURE;
+    }
+  }
+  if (prompt != NULL && isatty(STDIN_FILENO))
+    fprintf(stderr, "%s", prompt);
+
+  // the line is read byte by byte : the rest of the input belongs to the
+  // next commands. `quoted[k]` is set for the characters protected by `\`
+  size_t size = 128, len = 0;
+  char *line = malloc(size);
+  char *quoted = malloc(size);
+  int eof = 0;
+  int error = line == NULL || quoted == NULL;
+  while (!error) {
+    char c;
+    ssize_t n = read(STDIN_FILENO, &c, 1);
+    if (n == -1 && errno == EINTR)
+      continue;
+    if (n <= 0) {
+      eof = 1;
+      break;
+    }
+    int protected = 0;
+    if (c == '\\' && !raw) {
+      n = read(STDIN_FILENO, &c, 1);
+      if (n <= 0) {
+        eof = 1;
+        break;
+      }
+      if (c == '\n')
+        continue;
+      protected = 1;
+    } else if (c == '\n') {
+      break;
+    }
+    if (len + 1 >= size) {
+      char *tmp = realloc(line, size * 2);
+      if (tmp != NULL)
+        line = tmp;
+      if (tmp == NULL || (tmp = realloc(quoted, size * 2)) == NULL) {
+        error = 1;
+        break;
+      }
+      quoted = tmp;
+      size *= 2;
+    }
+    quoted[len] = (char)protected;
+    line[len++] = c;
+  }
+  if (error) {
+    fprintf(stderr, "jsh: allocation error\n");
+    free(line);
+    free(quoted);
+    return EXIT_FAILURE;
+  }
+  line[len] = '\0';
+
+  const char *ifs = get_variable("IFS");
+  if (ifs == NULL)
+    ifs = " \t\n";
+  int space;
+  size_t pos = 0;
+  // the leading white spaces are skipped
+  while (pos < len && !quoted[pos] && is_ifs(ifs, line[pos], &space) && space)
+    pos++;
+  for (size_t k = 0; names[k] != NULL; k++) {
+    size_t start = pos;
+    size_t stop;
+    if (names[k + 1] == NULL) {
+      // the last variable takes the rest, without the trailing white spaces
+      stop = len;
+      while (stop > start && !quoted[stop - 1] &&
+             is_ifs(ifs, line[stop - 1], &space) && space)
+        stop--;
+      pos = len;
+    } else {
+      while (pos < len && !(!quoted[pos] && is_ifs(ifs, line[pos], &space)))
+        pos++;
+      stop = pos;
+      // a field ends at white spaces and at most one other separator
+      int separator = 0;
+      while (pos < len && !quoted[pos] && is_ifs(ifs, line[pos], &space) &&
+             (space || !separator)) {
+        separator |= !space;
+        pos++;
+      }
+    }
+    char saved = line[stop];
+    line[stop] = '\0';
+    if (set_variable(names[k], line + start, 0))
+      fprintf(stderr, "jsh: allocation error\n");
+    line[stop] = saved;
+  }
+  free(line);
+  free(quoted);
+  // at the end of the input, the variables are set but the read fails
+  return eof ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+/**
+ * `true` and `:` : do nothing, successfully
+ */
+int jtrue(char **args) {
+  (void)args;
+  return EXIT_SUCCESS;
+}
+
+/**
+ * `false` : does nothing, unsuccessfully
+ */
+int jfalse(char **args) {
+  (void)args;
+  return EXIT_FAILURE;
+}
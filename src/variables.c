@@ -0,0 +1,530 @@
+#include "../head/jsh.h"
+
+typedef struct Variable {
+  char *entry;     // `NAME=value`, as passed to the programs
+  size_t name_len; // length of `NAME`
+  int exported;    // `1` if the variable is in the environment of programs
+  struct Variable *next;
+} Variable;
+
+// shell variables, hashed by name. The table doubles when the number of
+// variables reaches its size
+static Variable **table = NULL;
+static size_t table_size = 0;
+static size_t nb_variables = 0;
+
+// environment of the programs, rebuilt only when an exported variable changes
+static char **envp = NULL;
+static int envp_dirty = 1;
+
+/**
+ * FNV-1a hash of the `len` first characters of `name`
+ */
+static size_t hash_name(const char *name, size_t len) {
+  size_t hash = 14695981039346656037UL;
+  for (size_t i = 0; i < len; i++) {
+    hash ^= (unsigned char)name[i];
+    hash *= 1099511628211UL;
+  }
+  return hash;
+}
+
+/**
+ * Returns the variable named by the `len` first characters of `name`, `NULL`
+ * if it does not exist
+ */
+static Variable *find_variable(const char *name, size_t len) {
+  if (table_size == 0)
+    return NULL;
+  for (Variable *var = table[hash_name(name, len) & (table_size - 1)];
+       var != NULL; var = var->next) {
+    if (var->name_len == len && strncmp(var->entry, name, len) == 0)
+      return var;
+  }
+  return NULL;
+}
+
+/**
+ * Doubles the size of the table
+ *
+ * @return `1` on allocation error, `0` otherwise
+ */
+static int grow_table(void) {
+  size_t size = table_size ? table_size * 2 : 64;
+  Variable **new_table = calloc(size, sizeof(Variable *));
+  if (new_table == NULL)
+    return 1;
+  for (size_t i = 0; i < table_size; i++) {
+    Variable *var = table[i];
+    while (var != NULL) {
+      Variable *next = var->next;
+      size_t index = hash_name(var->entry, var->name_len) & (size - 1);
+      var->next = new_table[index];
+      new_table[index] = var;
+      var = next;
+    }
+  }
+  free(table);
+  table = new_table;
+  table_size = size;
+  return 0;
+}
+
+/**
+ * Returns `1` if `word` is a valid variable name, `0` otherwise
+ */
+int is_name(const char *word) {
+  if (!(word[0] == '_' || (word[0] >= 'a' && word[0] <= 'z') ||
+        (word[0] >= 'A' && word[0] <= 'Z')))
+    return 0;
+  for (size_t i = 1; word[i] != '\0'; i++) {
+    if (!(word[i] == '_' || (word[i] >= 'a' && word[i] <= 'z') ||
+          (word[i] >= 'A' && word[i] <= 'Z') ||
+          (word[i] >= '0' && word[i] <= '9')))
+      return 0;
+  }
+  return 1;
+}
+
+/**
+ * Returns the length of the variable name starting `word`, `0` if there is
+ * none
+ */
+static size_t name_length(const char *word) {
+  size_t len = 0;
+  while (word[len] == '_' || (word[len] >= 'a' && word[len] <= 'z') ||
+         (word[len] >= 'A' && word[len] <= 'Z') ||
+         (len > 0 && word[len] >= '0' && word[len] <= '9'))
+    len++;
+  return len;
+}
+
+/**
+ * Returns `1` if `word` is an assignment `NAME=value`, `0` otherwise
+ */
+int is_assignment(const char *word) {
+  size_t len = name_length(word);
+  return len > 0 && word[len] == '=';
+}
+
+/**
+ * Imports the environment of the shell as exported variables
+ */
+void init_variables(void) {
+  for (size_t i = 0; environ[i] != NULL; i++) {
+    char *equal = strchr(environ[i], '=');
+    if (equal == NULL)
+      continue;
+    *equal = '\0';
+    if (is_name(environ[i]))
+      set_variable(environ[i], equal + 1, 1);
+    *equal = '=';
+  }
+}
+
+/**
+ * Saves the variables of the shell in `*save`, if not `NULL`, and replaces
+ * them with `*load`, for the contexts of `libjsh.c`
+ */
+void switch_variables(Variables *save, const Variables *load) {
+  if (save != NULL) {
+    save->table = table;
+    save->table_size = table_size;
+    save->nb_variables = nb_variables;
+    save->envp = envp;
+    save->envp_dirty = envp_dirty;
+  }
+  table = load->table;
+  table_size = load->table_size;
+  nb_variables = load->nb_variables;
+  envp = load->envp;
+  envp_dirty = load->envp_dirty;
+}
+
+/**
+ * Removes all the variables
+ */
+void clear_variables(void) {
+  for (size_t i = 0; i < table_size; i++) {
+    Variable *var = table[i];
+    while (var != NULL) {
+      Variable *next = var->next;
+      free(var->entry);
+      free(var);
+      var = next;
+    }
+  }
+  free(table);
+  free(envp);
+  table = NULL;
+  table_size = 0;
+  nb_variables = 0;
+  envp = NULL;
+  envp_dirty = 1;
+}
+
+/**
+ * Returns the value of the variable `name`
+ *
+ * @return the value, only valid until the variable changes, `NULL` if the
+ * variable does not exist
+ */
+char *get_variable(const char *name) {
+  Variable *var = find_variable(name, strlen(name));
+  return var != NULL ? var->entry + var->name_len + 1 : NULL;
+}
+
+/**
+ * Returns `1` if the variable `name` is exported, `0` otherwise
+ */
+int is_exported(const char *name) {
+  Variable *var = find_variable(name, strlen(name));
+  return var != NULL && var->exported;
+}
+
+/**
+ * Sets the variable `name`, creating it if needed
+ *
+ * @param export : `1` to export the variable, `0` to keep its attribute (a
+ * new variable is not exported)
+ * @return `1` on allocation error, `0` otherwise
+ */
+int set_variable(const char *name, const char *value, int export) {
+  size_t len = strlen(name);
+  Variable *var = find_variable(name, len);
+  char *entry = malloc(len + strlen(value) + 2);
+  if (entry == NULL)
+    return 1;
+  sprintf(entry, "%s=%s", name, value);
+
+  if (var == NULL) {
+    if (nb_variables >= table_size && grow_table()) {
+      free(entry);
+      return 1;
+    }
+    var = malloc(sizeof(Variable));
+    if (var == NULL) {
+      free(entry);
+      return 1;
+    }
+    size_t index = hash_name(name, len) & (table_size - 1);
+    var->name_len = len;
+    var->exported = 0;
+    var->next = table[index];
+    table[index] = var;
+    nb_variables++;
+  } else {
+    free(var->entry);
+  }
+  var->entry = entry;
+  var->exported |= export;
+  if (var->exported)
+    envp_dirty = 1;
+  return 0;
+}
+
+/**
+ * Marks the variable `name` as exported, creating it empty if needed
+ *
+ * @return `1` on allocation error, `0` otherwise
+ */
+int export_variable(const char *name) {
+  Variable *var = find_variable(name, strlen(name));
+  if (var == NULL)
+    return set_variable(name, "", 1);
+  if (!var->exported)
+    envp_dirty = 1;
+  var->exported = 1;
+  return 0;
+}
+
+/**
+ * Removes the variable `name`, if it exists
+ */
+void unset_variable(const char *name) {
+  size_t len = strlen(name);
+  if (table_size == 0)
+    return;
+  Variable **prev = &table[hash_name(name, len) & (table_size - 1)];
+  for (Variable *var = *prev; var != NULL; prev = &var->next, var = *prev) {
+    if (var->name_len == len && strncmp(var->entry, name, len) == 0) {
+      *prev = var->next;
+      if (var->exported)
+        envp_dirty = 1;
+      free(var->entry);
+      free(var);
+      nb_variables--;
+      return;
+    }
+  }
+}
+
+/**
+ * Returns the environment of the programs : the `NAME=value` entries of the
+ * exported variables. The array is only rebuilt after a change of an exported
+ * variable
+ *
+ * @return the environment, `NULL` on allocation error. Before
+ * `init_variables()` (in the zygote), the environment of the process
+ */
+char **variables_environ(void) {
+  if (table == NULL)
+    return environ;
+  if (!envp_dirty)
+    return envp;
+  size_t count = 0;
+  for (size_t i = 0; i < table_size; i++) {
+    for (Variable *var = table[i]; var != NULL; var = var->next)
+      count += (size_t)var->exported;
+  }
+  char **new_envp = realloc(envp, (count + 1) * sizeof(char *));
+  if (new_envp == NULL)
+    return NULL;
+  envp = new_envp;
+  count = 0;
+  for (size_t i = 0; i < table_size; i++) {
+    for (Variable *var = table[i]; var != NULL; var = var->next) {
+      if (var->exported)
+        envp[count++] = var->entry;
+    }
+  }
+  envp[count] = NULL;
+  envp_dirty = 0;
+  return envp;
+}
+
+/**
+ * Returns the room taken by the environment of the programs in `ARG_MAX`,
+ * with the pointers
+ */
+size_t environ_size(void) {
+  size_t total = 0;
+  char **env = variables_environ();
+  for (size_t i = 0; env != NULL && env[i] != NULL; i++)
+    total += strlen(env[i]) + 1 + sizeof(char *);
+  return total;
+}
+
+/**
+ * Appends `len` characters of `str` to the buffer `*buf`
+ *
+ * @return `1` on allocation error (`*buf` is freed), `0` otherwise
+ */
+static int append(char **buf, size_t *size, size_t *position, const char *str,
+                  size_t len) {
+  if (*position + len + 1 > *size) {
+    *size = (*position + len + 1) * 2;
+    char *tmp = realloc(*buf, *size);
+    if (tmp == NULL) {
+      free(*buf);
+      return 1;
+    }
+    *buf = tmp;
+  }
+  memcpy(*buf + *position, str, len);
+  *position += len;
+  (*buf)[*position] = '\0';
+  return 0;
+}
+
+/**
+ * Expands the `len` first characters of `word` into `*buf` : `$NAME`,
+ * `${NAME}`, `${NAME:-default}`, `$?` and `$$`
+ *
+ * @return `1` on allocation error (`*buf` is freed), `0` otherwise
+ */
+static int expand_into(char **buf, size_t *size, size_t *position,
+                       const char *word, size_t len) {
+  char number[16];
+  size_t i = 0;
+  while (i < len) {
+    const char *dollar = memchr(word + i, '$', len - i);
+    size_t literal = dollar != NULL ? (size_t)(dollar - word) - i : len - i;
+    if (append(buf, size, position, word + i, literal))
+      return 1;
+    i += literal;
+    if (i >= len)
+      break;
+
+    // `word[i]` is `$`
+    const char *value = NULL;
+    size_t name_len = name_length(word + i + 1);
+    if (i + 1 < len && (word[i + 1] == '?' || word[i + 1] == '$')) {
+      sprintf(number, "%d",
+              word[i + 1] == '?' ? last_exit_code : (int)shell_pid);
+      value = number;
+      i += 2;
+    } else if (name_len > 0 && i + 1 + name_len <= len) {
+      Variable *var = find_variable(word + i + 1, name_len);
+      value = var != NULL ? var->entry + var->name_len + 1 : "";
+      i += 1 + name_len;
+    } else if (i + 1 < len && word[i + 1] == '{') {
+      // `${NAME}` or `${NAME:-default}`, the default may hold `${...}`
+      size_t start = i + 2;
+      size_t end = start;
+      int depth = 1;
+      for (; end < len; end++) {
+        if (word[end] == '{')
+          depth++;
+        else if (word[end] == '}' && --depth == 0)
+          break;
+      }
+      name_len = name_length(word + start);
+      if (end >= len || name_len == 0 ||
+          (start + name_len != end &&
+           strncmp(word + start + name_len, ":-", 2) != 0)) {
+        // not a parameter : kept as is
+        value = "$";
+        i++;
+      } else {
+        Variable *var = find_variable(word + start, name_len);
+        value = var != NULL ? var->entry + var->name_len + 1 : "";
+        if (start + name_len != end && *value == '\0') {
+          size_t def = start + name_len + 2;
+          if (expand_into(buf, size, position, word + def, end - def))
+            return 1;
+          value = "";
+        }
+        i = end + 1;
+      }
+    } else {
+      value = "$";
+      i++;
+    }
+    if (append(buf, size, position, value, strlen(value)))
+      return 1;
+  }
+  return 0;
+}
+
+/**
+ * Expands the variables of `word` : `$NAME`, `${NAME}`, `${NAME:-default}`,
+ * `$?` and `$$`
+ *
+ * @param word : word of the command line
+ * @return the expanded word to free, `NULL` on allocation error
+ */
+char *expand_word(const char *word) {
+  size_t len = strlen(word);
+  size_t size = len + 1;
+  size_t position = 0;
+  char *buf = malloc(size);
+  if (buf == NULL)
+    return NULL;
+  buf[0] = '\0';
+  if (strchr(word, '$') == NULL) {
+    memcpy(buf, word, size);
+    return buf;
+  }
+  if (expand_into(&buf, &size, &position, word, len))
+    return NULL;
+  return buf;
+}
+
+/**
+ * Built-in `export [NAME[=value]]...`. Without argument, lists the exported
+ * variables
+ */
+int export(char **args) {
+  int status = EXIT_SUCCESS;
+  if (args[1] == NULL) {
+    char **env = variables_environ();
+    for (size_t i = 0; env != NULL && env[i] != NULL; i++)
+      dprintf(builtin_stdout, "export %s\n", env[i]);
+    return EXIT_SUCCESS;
+  }
+  for (size_t i = 1; args[i] != NULL; i++) {
+    char *equal = strchr(args[i], '=');
+    if (equal != NULL)
+      *equal = '\0';
+    if (!is_name(args[i])) {
+      fprintf(stderr, "jsh: export: `%s': not a valid identifier\n", args[i]);
+      status = EXIT_FAILURE;
+    } else if (equal != NULL ? set_variable(args[i], equal + 1, 1)
+                             : export_variable(args[i])) {
+      fprintf(stderr, "jsh: allocation error\n");
+      status = EXIT_FAILURE;
+    }
+    if (equal != NULL)
+      *equal = '=';
+  }
+  return status;
+}
+
+/**
+ * Built-in `unset NAME...`
+ */
+int unset(char **args) {
+  int status = EXIT_SUCCESS;
+  for (size_t i = 1; args[i] != NULL; i++) {
+    if (!is_name(args[i])) {
+      fprintf(stderr, "jsh: unset: `%s': not a valid identifier\n", args[i]);
+      status = EXIT_FAILURE;
+      continue;
+    }
+    unset_variable(args[i]);
+  }
+  return status;
+}
+
+/**
+ * Executes the assignments `NAME=value` leading `args`. Alone, they set shell
+ * variables. Followed by a command, they are exported for this command only
+ *
+ * @param args : arguments, starting with at least one assignment
+ * @param forking : as for `execute_command()`
+ */
+void execute_assignments(char **args, int forking) {
+  size_t n = 0;
+  while (args[n] != NULL && is_assignment(args[n]))
+    n++;
+
+  if (args[n] == NULL) {
+    last_exit_code = EXIT_SUCCESS;
+    for (size_t i = 0; i < n; i++) {
+      char *equal = strchr(args[i], '=');
+      *equal = '\0';
+      if (set_variable(args[i], equal + 1, 0)) {
+        fprintf(stderr, "jsh: allocation error\n");
+        last_exit_code = EXIT_FAILURE;
+      }
+      *equal = '=';
+    }
+    return;
+  }
+
+  // previous values, restored once the command is done
+  char **saved = calloc(n, sizeof(char *));
+  int *exported = calloc(n, sizeof(int));
+  if (saved == NULL || exported == NULL) {
+    fprintf(stderr, "jsh: allocation error\n");
+    free(saved);
+    free(exported);
+    last_exit_code = EXIT_FAILURE;
+    return;
+  }
+  for (size_t i = 0; i < n; i++) {
+    char *equal = strchr(args[i], '=');
+    *equal = '\0';
+    char *value = get_variable(args[i]);
+    saved[i] = value != NULL ? strdup(value) : NULL;
+    exported[i] = is_exported(args[i]);
+    set_variable(args[i], equal + 1, 1);
+    *equal = '=';
+  }
+  execute_command(args + n, forking);
+  for (size_t i = n; i-- > 0;) {
+    char *equal = strchr(args[i], '=');
+    *equal = '\0';
+    if (saved[i] == NULL) {
+      unset_variable(args[i]);
+    } else {
+      unset_variable(args[i]);
+      set_variable(args[i], saved[i], exported[i]);
+    }
+    *equal = '=';
+    free(saved[i]);
+  }
+  free(saved);
+  free(exported);
+}
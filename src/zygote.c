@@ -0,0 +1,497 @@
+#include "../head/jsh.h"
+
+#include <poll.h>
+#include <sys/prctl.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+
+#define ZYGOTE_LAUNCH 1
+#define ZYGOTE_WAIT 2
+// stdin, stdout, stderr, working directory then the substitutions
+// passed as `/dev/fd/N` arguments
+#define ZYGOTE_MAX_FDS 16
+#define ZYGOTE_CWD 3
+// period of the polls of a child of the zygote for its stops
+#define ZYGOTE_POLL_MS 10
+
+typedef struct {
+  int type;
+  pid_t pid;     // ZYGOTE_WAIT : child to wait for
+  int options;   // ZYGOTE_WAIT : options of `waitpid()`
+  size_t argc;   // ZYGOTE_LAUNCH : number of arguments in the payload
+  size_t envc;   // ZYGOTE_LAUNCH : number of environment variables
+  size_t size;   // ZYGOTE_LAUNCH : size of the payload
+  int nb_fds;    // ZYGOTE_LAUNCH : number of descriptors sent
+  int targets[ZYGOTE_MAX_FDS]; // ZYGOTE_LAUNCH : number of each descriptor
+                               // in the child
+} ZygoteRequest;
+
+typedef struct {
+  pid_t pid;  // result of `fork()` or `waitpid()`
+  int status; // status set by `waitpid()`
+  int error;  // errno if `pid` is `-1`
+  struct rusage usage; // ZYGOTE_WAIT : resources used by the child
+} ZygoteReply;
+
+static int zygote_fd = -1;
+static pid_t zygote_owner = -1;
+// requests may come from the threads running built-ins (see `jobs`)
+static pthread_mutex_t zygote_mutex = PTHREAD_MUTEX_INITIALIZER;
+// children launched by the zygote and not reaped yet
+static pid_t *zygote_children = NULL;
+static size_t nb_zygote_children = 0;
+
+/**
+ * Sends the `size` bytes of `buffer` on the socket `fd`, without `SIGPIPE`
+ *
+ * @return `0` on success, `-1` on error
+ */
+int write_all(int fd, const void *buffer, size_t size) {
+  for (size_t done = 0; done < size;) {
+    ssize_t n = send(fd, (const char *)buffer + done, size - done, MSG_NOSIGNAL);
+    if (n == -1 && errno == EINTR)
+      continue;
+    if (n <= 0)
+      return -1;
+    done += (size_t)n;
+  }
+  return 0;
+}
+
+/**
+ * Reads exactly `size` bytes from `fd` into `buffer`
+ *
+ * @return `0` on success, `-1` on error or end of file
+ */
+int read_all(int fd, void *buffer, size_t size) {
+  for (size_t done = 0; done < size;) {
+    ssize_t n = read(fd, (char *)buffer + done, size - done);
+    if (n == -1 && errno == EINTR)
+      continue;
+    if (n <= 0)
+      return -1;
+    done += (size_t)n;
+  }
+  return 0;
+}
+
+/**
+ * Splits a payload of NUL-terminated strings into a NULL-terminated array
+ *
+ * @param payload : strings to split
+ * @param count : number of strings to take
+ * @param end : set to the first byte after the last string taken
+ * @return the array, `NULL` on allocation error
+ */
+static char **split_payload(char *payload, size_t count, char **end) {
+  char **array = malloc(sizeof(char *) * (count + 1));
+  if (array == NULL)
+    return NULL;
+  for (size_t i = 0; i < count; i++) {
+    array[i] = payload;
+    payload += strlen(payload) + 1;
+  }
+  array[count] = NULL;
+  *end = payload;
+  return array;
+}
+
+/**
+ * Forks and executes a program for the shell. The child gets the standard
+ * streams and the working directory of the shell, its own process group and
+ * the terminal, like the children forked by `execute_external_command()`
+ *
+ * @param request : the launch request
+ * @param payload : arguments then environment of the program
+ * @param fds : descriptors received with the request
+ * @return the pid of the child, `-1` on error
+ */
+static pid_t zygote_launch_child(ZygoteRequest *request, char *payload,
+                                 int *fds) {
+  pid_t pid = fork();
+  if (pid != 0)
+    return pid;
+
+  char *end;
+  char **args = split_payload(payload, request->argc, &end);
+  char **env = split_payload(end, request->envc, &end);
+  if (args == NULL || env == NULL) {
+    fprintf(stderr, "jsh: allocation error\n");
+    exit(EXIT_FAILURE);
+  }
+  // the received descriptors may use the numbers expected by the child
+  int max = 0;
+  for (int i = 0; i < request->nb_fds; i++)
+    max = request->targets[i] > max ? request->targets[i] : max;
+  for (int i = 0; i < request->nb_fds; i++) {
+    if ((fds[i] = fcntl(fds[i], F_DUPFD_CLOEXEC, max + 1)) == -1) {
+      perror("jsh: dup error");
+      exit(EXIT_FAILURE);
+    }
+  }
+  for (int i = 0; i < request->nb_fds; i++) {
+    if (i != ZYGOTE_CWD && dup2(fds[i], request->targets[i]) == -1) {
+      perror("jsh: dup2 error");
+      exit(EXIT_FAILURE);
+    }
+  }
+  if (fchdir(fds[ZYGOTE_CWD]) == -1) {
+    perror("jsh: chdir error");
+    exit(EXIT_FAILURE);
+  }
+  environ = env;
+  if (setpgid(getpid(), getpid())) {
+    perror("jsh: setgid error");
+    exit(EXIT_FAILURE);
+  }
+  tcsetpgrp(STDIN_FILENO, getpid());
+  tcsetpgrp(STDOUT_FILENO, getpid());
+  tcsetpgrp(STDERR_FILENO, getpid());
+  signals(1);
+  execute_program(args);
+  return -1;
+}
+
+/**
+ * Main loop of the zygote : serves the requests of the shell until it closes
+ * its end of the socket
+ *
+ * @param sock : socket connected to the shell
+ */
+static void zygote_loop(int sock) {
+  prctl(PR_SET_NAME, "jsh-zygote");
+  prctl(PR_SET_PDEATHSIG, SIGKILL);
+
+  for (;;) {
+    ZygoteRequest request;
+    ZygoteReply reply;
+    memset(&reply, 0, sizeof(reply));
+    reply.pid = -1;
+    int fds[ZYGOTE_MAX_FDS];
+    char control[CMSG_SPACE(sizeof(fds))];
+    struct iovec iov = {&request, sizeof(request)};
+    struct msghdr msg = {0};
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+
+    ssize_t n = recvmsg(sock, &msg, MSG_CMSG_CLOEXEC);
+    if (n == -1 && errno == EINTR)
+      continue;
+    if (n <= 0)
+      exit(EXIT_SUCCESS);
+    if ((size_t)n < sizeof(request) &&
+        read_all(sock, (char *)&request + n, sizeof(request) - (size_t)n))
+      exit(EXIT_FAILURE);
+
+    if (request.type == ZYGOTE_WAIT) {
+      reply.pid =
+          wait4(request.pid, &reply.status, request.options, &reply.usage);
+      reply.error = errno;
+    } else {
+      struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+      char *payload = malloc(request.size);
+      if (payload == NULL || read_all(sock, payload, request.size))
+        exit(EXIT_FAILURE);
+      size_t size = sizeof(int) * (size_t)request.nb_fds;
+      if (cmsg == NULL || cmsg->cmsg_type != SCM_RIGHTS ||
+          request.nb_fds > ZYGOTE_MAX_FDS || cmsg->cmsg_len != CMSG_LEN(size)) {
+        reply.error = EBADF;
+      } else {
+        memcpy(fds, CMSG_DATA(cmsg), size);
+        reply.pid = zygote_launch_child(&request, payload, fds);
+        reply.error = errno;
+        for (int i = 0; i < request.nb_fds; i++)
+          close(fds[i]);
+      }
+      free(payload);
+    }
+    if (write_all(sock, &reply, sizeof(reply)))
+      exit(EXIT_FAILURE);
+  }
+}
+
+/**
+ * Forks the zygote, a copy of the shell taken before it grows, which forks
+ * the external commands on its behalf : the address space of the shell is
+ * then never duplicated. Enabled with `JSH_ZYGOTE=1`
+ *
+ * @return `0` on success, `1` if the zygote cannot be started and the shell
+ * forks by itself
+ */
+int start_zygote(void) {
+  int fds[2];
+  if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, fds) == -1) {
+    perror("jsh: zygote error");
+    return 1;
+  }
+  pid_t pid = fork();
+  if (pid == -1) {
+    perror("jsh: zygote error");
+    close(fds[0]);
+    close(fds[1]);
+    return 1;
+  }
+  if (pid == 0) {
+    close(fds[0]);
+    zygote_loop(fds[1]);
+  }
+  close(fds[1]);
+  zygote_fd = fds[0];
+  zygote_owner = getpid();
+  return 0;
+}
+
+/**
+ * Stops using the zygote after a communication error
+ */
+static void stop_zygote(void) {
+  fprintf(stderr, "jsh: zygote error, forking from the shell\n");
+  close(zygote_fd);
+  zygote_fd = -1;
+}
+
+/**
+ * Asks the zygote to launch a program in its own process group with the
+ * standard streams, working directory and environment of the shell
+ *
+ * @param args : arguments of the program
+ * @return the pid of the program, `-1` if the zygote is not available and the
+ * caller has to fork by itself
+ */
+pid_t zygote_launch(char **args) {
+  // children of the shell must not talk to the zygote of their parent
+  if (zygote_fd == -1 || getpid() != zygote_owner)
+    return -1;
+
+  ZygoteRequest request = {ZYGOTE_LAUNCH, 0, 0, 0, 0, 0, 0, {0, 1, 2, -1}};
+  int fds[ZYGOTE_MAX_FDS] = {STDIN_FILENO, STDOUT_FILENO, STDERR_FILENO,
+                             open(".", O_PATH | O_DIRECTORY | O_CLOEXEC)};
+  request.nb_fds = ZYGOTE_CWD + 1;
+  for (; args[request.argc] != NULL; request.argc++) {
+    request.size += strlen(args[request.argc]) + 1;
+    // substitutions inherited by the program (see `inherit_substitutions()`)
+    int fd;
+    if (sscanf(args[request.argc], "/dev/fd/%d", &fd) == 1 &&
+        request.nb_fds < ZYGOTE_MAX_FDS && fcntl(fd, F_GETFD) == 0) {
+      request.targets[request.nb_fds] = fd;
+      fds[request.nb_fds++] = fd;
+    }
+  }
+  char **env = variables_environ();
+  if (env == NULL)
+    return -1;
+  for (; env[request.envc] != NULL; request.envc++)
+    request.size += strlen(env[request.envc]) + 1;
+
+  char *payload = malloc(request.size);
+  if (payload == NULL) {
+    close(fds[ZYGOTE_CWD]);
+    return -1;
+  }
+  char *end = payload;
+  for (size_t i = 0; i < request.argc; i++)
+    end = stpcpy(end, args[i]) + 1;
+  for (size_t i = 0; i < request.envc; i++)
+    end = stpcpy(end, env[i]) + 1;
+
+  pthread_mutex_lock(&zygote_mutex);
+  pid_t *children =
+      realloc(zygote_children, sizeof(pid_t) * (nb_zygote_children + 1));
+  if (fds[ZYGOTE_CWD] == -1 || children == NULL || zygote_fd == -1) {
+    pthread_mutex_unlock(&zygote_mutex);
+    close(fds[ZYGOTE_CWD]);
+    free(payload);
+    return -1;
+  }
+  zygote_children = children;
+  size_t size = sizeof(int) * (size_t)request.nb_fds;
+  char control[CMSG_SPACE(sizeof(fds))];
+  memset(control, 0, sizeof(control));
+  struct iovec iov = {&request, sizeof(request)};
+  struct msghdr msg = {0};
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+  msg.msg_control = control;
+  msg.msg_controllen = CMSG_SPACE(size);
+  struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+  cmsg->cmsg_level = SOL_SOCKET;
+  cmsg->cmsg_type = SCM_RIGHTS;
+  cmsg->cmsg_len = CMSG_LEN(size);
+  memcpy(CMSG_DATA(cmsg), fds, size);
+
+  ZygoteReply reply;
+  ssize_t n = sendmsg(zygote_fd, &msg, MSG_NOSIGNAL);
+  close(fds[ZYGOTE_CWD]);
+  if (n == -1 ||
+      (size_t)n < sizeof(request) &&
+          write_all(zygote_fd, (char *)&request + n, sizeof(request) - (size_t)n) ||
+      write_all(zygote_fd, payload, request.size) ||
+      read_all(zygote_fd, &reply, sizeof(reply))) {
+    free(payload);
+    stop_zygote();
+    pthread_mutex_unlock(&zygote_mutex);
+    return -1;
+  }
+  free(payload);
+  if (reply.pid == -1) {
+    pthread_mutex_unlock(&zygote_mutex);
+    errno = reply.error;
+    return -1;
+  }
+  zygote_children[nb_zygote_children++] = reply.pid;
+  pthread_mutex_unlock(&zygote_mutex);
+  return reply.pid;
+}
+
+/**
+ * Asks the zygote for a change of state of its child `pid`, without waiting
+ *
+ * @return see `waitpid()` with `WNOHANG`
+ */
+static pid_t poll_zygote_child(pid_t pid, int *status, int options,
+                               struct rusage *usage) {
+  pthread_mutex_lock(&zygote_mutex);
+  size_t i = 0;
+  while (i < nb_zygote_children && zygote_children[i] != pid)
+    i++;
+  if (i == nb_zygote_children) {
+    pthread_mutex_unlock(&zygote_mutex);
+    return wait4(pid, status, options | WNOHANG, usage);
+  }
+
+  ZygoteRequest request = {ZYGOTE_WAIT, pid, options | WNOHANG, 0, 0, 0, 0,
+                           {0}};
+  ZygoteReply reply;
+  memset(&reply, 0, sizeof(reply));
+  reply.pid = -1;
+  reply.error = ECHILD;
+  if (zygote_fd != -1 && (write_all(zygote_fd, &request, sizeof(request)) ||
+                          read_all(zygote_fd, &reply, sizeof(reply)))) {
+    stop_zygote();
+    reply.pid = -1;
+    reply.error = ECHILD;
+  }
+  if (reply.pid == pid && (WIFEXITED(reply.status) || WIFSIGNALED(reply.status)) ||
+      reply.pid == -1 && reply.error == ECHILD)
+    zygote_children[i] = zygote_children[--nb_zygote_children];
+  pthread_mutex_unlock(&zygote_mutex);
+
+  if (reply.pid == -1) {
+    errno = reply.error;
+  } else if (reply.pid > 0) {
+    *status = reply.status;
+    if (usage != NULL)
+      *usage = reply.usage;
+  }
+  return reply.pid;
+}
+
+/**
+ * `wait4()` which also works for the children launched by the zygote. The
+ * zygote never waits on behalf of the shell : a wait on one of its children
+ * polls it with `WNOHANG`, and sleeps in between without holding
+ * `zygote_mutex`, until the end of the child (its pidfd becomes readable)
+ * or `ZYGOTE_POLL_MS` for its stops and continues
+ */
+static pid_t wait_child(pid_t pid, int *status, int options,
+                        struct rusage *usage) {
+  if (getpid() != zygote_owner)
+    return wait4(pid, status, options, usage);
+  pid_t waited = poll_zygote_child(pid, status, options, usage);
+  if (waited != 0 || options & WNOHANG)
+    return waited;
+
+  struct pollfd end = {(int)syscall(SYS_pidfd_open, pid, 0), POLLIN, 0};
+  while (waited == 0) {
+    if (poll(&end, end.fd != -1, ZYGOTE_POLL_MS) == -1 && errno != EINTR) {
+      waited = -1;
+      break;
+    }
+    waited = poll_zygote_child(pid, status, options, usage);
+  }
+  if (end.fd != -1)
+    close(end.fd);
+  return waited;
+}
+
+/**
+ * `waitpid()` which also works for the children launched by the zygote, and
+ * traces the ends and stops of the children
+ *
+ * @param pid : process to wait for
+ * @param status : set to the status of the process
+ * @param options : options of `waitpid()`
+ * @return see `waitpid()`
+ */
+pid_t jsh_waitpid(pid_t pid, int *status, int options) {
+  return waitpid_usage(pid, status, options, NULL);
+}
+
+/**
+ * `jsh_waitpid()` which also sets `usage` to the resources used by the
+ * process when it stopped or ended, as `wait4()`
+ *
+ * @param usage : left unchanged if no process changed state, may be `NULL`
+ */
+pid_t waitpid_usage(pid_t pid, int *status, int options, struct rusage *usage) {
+  pid_t waited = wait_child(pid, status, options, usage);
+  if (waited > 0) {
+    if (WIFEXITED(*status))
+      TRACE(TRACE_EXIT, waited, WEXITSTATUS(*status), NULL);
+    else if (WIFSIGNALED(*status))
+      TRACE(TRACE_EXIT, waited, 128 + WTERMSIG(*status), NULL);
+    else if (WIFSTOPPED(*status))
+      TRACE(TRACE_STOP, waited, WSTOPSIG(*status), NULL);
+  }
+  return waited;
+}
+
+/**
+ * Waits for the first of the children `pids` to end. The other children of
+ * the process are left alone : inside a job, it may have some of its own
+ * (background members of a group...) whose status belongs to their waiter
+ *
+ * @param pids : children to wait for, forked by the process
+ * @param n : number of children, at least one
+ * @param status : set to the status of the child
+ * @return the child which ended, `-1` on error
+ */
+pid_t wait_any(const pid_t *pids, size_t n, int *status) {
+  for (size_t i = 0; i < n; i++) {
+    pid_t pid = jsh_waitpid(pids[i], status, WNOHANG);
+    if (pid != 0)
+      return pid;
+  }
+  // a descriptor per child becomes readable when it ends. Without them,
+  // the children are waited for in order
+  struct pollfd *fds = malloc(n * sizeof(struct pollfd));
+  size_t opened = 0;
+  while (fds != NULL && opened < n) {
+    int fd = (int)syscall(SYS_pidfd_open, pids[opened], 0);
+    if (fd == -1)
+      break;
+    fds[opened++] = (struct pollfd){fd, POLLIN, 0};
+  }
+  pid_t ended = pids[0];
+  if (fds != NULL && opened == n) {
+    if (poll(fds, n, -1) == -1)
+      ended = -1;
+    for (size_t i = 0; ended != -1 && i < n; i++) {
+      if (fds[i].revents != 0) {
+        ended = pids[i];
+        break;
+      }
+    }
+  }
+  int error = errno;
+  for (size_t i = 0; i < opened; i++)
+    close(fds[i].fd);
+  free(fds);
+  if (ended == -1) {
+    errno = error;
+    return -1;
+  }
+  return jsh_waitpid(ended, status, 0);
+}
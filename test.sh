@@ -6,6 +6,46 @@ Je n'ai pas détecté de fichier AUTHORS.md non vide dans le répertoire courant
   exit 1
 fi
 
+# Tests de non-régression, chacun dans un répertoire temporaire vide qui sert
+# aussi de HOME : chaque script tests/NOM.jsh est lu par ./jsh, et chaque
+# script tests/NOM.sh est lancé par bash avec le chemin du dépôt dans $ROOT.
+# La sortie standard (sans l'invite de jsh, écrite sur la sortie d'erreur)
+# doit être tests/NOM.out, où le chemin du répertoire temporaire est écrit TMP
+run_regressions() {
+  local failed=0 script expected dir
+  for script in tests/*.jsh tests/*.sh; do
+    [ -e "$script" ] || continue
+    expected="${script%.*}.out"
+    dir=$(mktemp -d) || return 1
+    if (cd "$dir" &&
+        if [ "${script##*.}" = jsh ]; then
+          HOME="$dir" JSH_HISTFILE= "$OLDPWD/jsh" < "$OLDPWD/$script"
+        else
+          HOME="$dir" JSH_HISTFILE= ROOT="$OLDPWD" bash "$OLDPWD/$script"
+        fi 2>/dev/null) | sed "s|$dir|TMP|g" | diff -u "$expected" - >&2; then
+      printf "ok    %s\n" "$script"
+    else
+      printf "ÉCHEC %s\n" "$script"
+      failed=1
+    fi
+    rm -rf "$dir"
+  done
+  return $failed
+}
+
+if ! make -s jsh tools/jshc libjsh.a; then
+  printf "Erreur: la compilation de jsh a échoué. Abandon.\n" >&2
+  exit 1
+fi
+if ! run_regressions; then
+  printf "Erreur: des tests de non-régression ont échoué. Abandon.\n" >&2
+  exit 1
+fi
+# `./test.sh --local` s'arrête là, sans les tests automatiques distants
+if [ "$1" = "--local" ]; then
+  exit 0
+fi
+
 AUTOTEST_GIT="https://gaufre.informatique.univ-paris-diderot.fr/geoffroy/sy5-2023-2024-projet-jsh-autotests.git"
 AUTOTEST_DIR=".sy5-2023-2024-projet-jsh-autotests.nosync"
 
@@ -0,0 +1,23 @@
+# Splitting of a long argument list by batch : every item is given once, in
+# several invocations under the `ARG_MAX` of a 512 KB stack, and the exit
+# codes 123 and 125 of a failed and of a killed invocation
+ulimit -s 512
+mkdir items
+(cd items && for i in $(seq 1000 3999); do
+  : > "item-$i-aaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaa"
+done)
+printf 'echo $# >> calls\nfor i; do echo $i; done >> args\n' > count.sh
+printf 'kill -KILL $$\n' > killed.sh
+"$ROOT/jsh" <<'END'
+batch -j 2 sh count.sh -- items/*
+?
+batch false -- a b
+?
+batch sh killed.sh -- a
+?
+batch true
+?
+END
+echo invocations: $([ $(wc -l < calls) -gt 1 ] && echo several)
+echo items: $(awk '{ n += $1 } END { print n }' calls) $(sort -u args | wc -l)
+ls items | sed 's|^|items/|' | diff - <(sort args) && echo same items
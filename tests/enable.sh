@@ -0,0 +1,42 @@
+# Built-ins loaded by `enable -f` from a library, run in a pipeline and
+# removed by `enable -d`, and the built-ins disabled by `enable -n`
+cat > hello.c <<'EOF'
+#include <stdio.h>
+#include "jsh_builtin.h"
+
+static int hello(int argc, char **argv, const jsh_io *io) {
+  dprintf(io->out, "hello %s\n", argc > 1 ? argv[1] : "world");
+  return argc > 2 ? 4 : 0;
+}
+
+int jsh_builtins_init(int version, jsh_register_func add) {
+  static const jsh_builtin builtin = {"hello", hello, JSH_THREADED};
+  return version != JSH_BUILTIN_VERSION || add(&builtin);
+}
+EOF
+gcc -shared -fPIC -I "$ROOT/head" hello.c -o hello.so || exit 1
+"$ROOT/jsh" <<'END2'
+hello
+?
+enable -f ./hello.so
+?
+hello
+?
+hello jsh | tr a-z A-Z
+hello a b
+?
+enable -d hello
+?
+hello
+?
+enable -f ./missing.so
+?
+enable -n echo
+enable -n
+echo disabled
+?
+enable echo
+enable -n
+echo enabled
+?
+END2
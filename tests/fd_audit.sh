@@ -0,0 +1,15 @@
+# Descriptors inherited by the programs, as listed by JSH_FD_AUDIT : only
+# their standard streams and the /dev/fd/N of the substitutions, none leaked
+JSH_FD_AUDIT=audit.log "$ROOT/jsh" > out.txt <<'END'
+echo x > f
+cat f
+wc -l < f
+echo a | cat
+cat <( echo sub )
+coproc sleep 5
+cat f
+coproc -c COPROC
+END
+cat out.txt
+sed -E -e 's/\[[0-9]+\] //' -e 's/pipe:\[[0-9]+\]/pipe/' audit.log
+echo leaked: $(grep -c leaked audit.log)
@@ -0,0 +1,27 @@
+# History in `$JSH_HISTFILE` : a command typed again replaces its previous
+# entry, the file is rewritten with the `$JSH_HISTSIZE` most recent distinct
+# commands beyond twice that many lines, and a new shell finds the history
+export JSH_HISTFILE=$PWD/history JSH_HISTSIZE=3
+"$ROOT/jsh" > /dev/null <<'EOF'
+echo a
+echo b
+echo a
+EOF
+cat history
+echo ---
+"$ROOT/jsh" <<'EOF'
+history
+history -p echo
+history -s b
+echo c
+echo d
+echo e
+EOF
+echo ---
+cat history
+echo ---
+"$ROOT/jsh" <<'EOF'
+history -c
+history
+EOF
+wc -l < history
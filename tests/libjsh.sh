@@ -0,0 +1,78 @@
+# The libjsh interface, from a program linked with libjsh.a : parsing,
+# exit codes, variables and directory of two contexts, jobs, a context
+# running while another waits for a foreground program, and `exit`
+printf 'sleep 0.1\nkill -9 $$\n' > killed.sh
+cat > api.c <<'EOF'
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include "libjsh.h"
+
+static int run(jsh_ctx *ctx, const char *line) {
+  jsh_script *script;
+  int res = jsh_parse(ctx, line, &script);
+  if (res != JSH_OK)
+    return -res;
+  res = jsh_run(ctx, script);
+  jsh_script_free(script);
+  fflush(stdout);
+  return res;
+}
+
+static volatile int a_done = 0;
+
+static void *run_a(void *ctx) {
+  run(ctx, "sleep 0.4");
+  a_done = 1;
+  return NULL;
+}
+
+int main(void) {
+  jsh_ctx *a = jsh_new(), *b = jsh_new();
+  jsh_script *script;
+  printf("parse: %d %d %d\n", jsh_parse(a, "if true", &script),
+         jsh_parse(a, "echo a |", &script), jsh_parse(a, "echo a", &script));
+  jsh_script_free(script);
+
+  int res = run(a, "false");
+  printf("status: %d %d\n", res, jsh_status(a));
+  jsh_set_variable(a, "WHO", "a", 1);
+  jsh_set_variable(b, "WHO", "b", 0);
+  run(a, "mkdir dir ; cd dir");
+  run(a, "echo $WHO ; pwd");
+  run(b, "echo $WHO ; pwd");
+  char *who = jsh_get_variable(a, "WHO");
+  printf("variable: %s %p\n", who, (void *)jsh_get_variable(b, "NONE"));
+  free(who);
+
+  run(a, "sleep 0.2 & sh ../killed.sh &");
+  for (jsh_job job = {0}; jsh_job_next(a, job.id, &job);)
+    printf("job %d %s %d\n", job.id, job.command, job.state);
+  jsh_job job;
+  printf("jobs of b: %d\n", jsh_job_next(b, 0, &job));
+  int status;
+  res = jsh_wait(a, 1, &status);
+  printf("wait: %d %d\n", res, status);
+  res = jsh_wait(a, 2, &status);
+  printf("wait: %d %d\n", res, status);
+  printf("wait: %d\n", jsh_wait(a, 2, &status));
+
+  // b runs while a waits for its foreground program
+  pthread_t thread;
+  pthread_create(&thread, NULL, run_a, a);
+  usleep(100000);
+  run(b, "echo b");
+  printf("a still waiting: %d\n", !a_done);
+  pthread_join(thread, NULL);
+
+  res = run(b, "exit 4");
+  printf("exit: %d %d %d\n", res, jsh_exited(a), jsh_exited(b));
+  printf("after exit: %d\n", run(b, "echo not run"));
+  jsh_free(a);
+  jsh_free(b);
+  return 0;
+}
+EOF
+gcc api.c -I "$ROOT/head" "$ROOT/libjsh.a" -pthread -lreadline -ldl -o api &&
+  ./api
@@ -0,0 +1,26 @@
+# Requests of jshc to `jsh --serve` : the command runs in the directory and
+# on the descriptors of the client, with its variables, and its exit code is
+# the one of jshc. The server, which ignores SIGTERM as the shell does, is
+# killed at the end
+"$ROOT/jsh" --serve server.sock &
+server=$!
+for i in $(seq 100); do
+  [ -S server.sock ] && break
+  sleep 0.05
+done
+export JSH_SOCKET=$PWD/server.sock
+mkdir dir
+cd dir
+"$ROOT/tools/jshc" pwd
+echo $?
+echo input | "$ROOT/tools/jshc" cat
+"$ROOT/tools/jshc" -e NAME=value -c 'echo $NAME | tr a-z A-Z'
+"$ROOT/tools/jshc" -c 'false'
+echo $?
+"$ROOT/tools/jshc" sh -c 'exit 7'
+echo $?
+"$ROOT/tools/jshc" -c 'cd missing' 2>&1 >/dev/null
+"$ROOT/tools/jshc" -c 'echo out > file'
+cat file
+kill -KILL $server
+wait $server 2>/dev/null
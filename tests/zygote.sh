@@ -0,0 +1,18 @@
+# Job control of the programs launched by the zygote : their stops, their
+# resumption in the foreground and the end of the background ones
+printf 'kill -STOP $$\necho resumed\nexit 3\n' > stop.sh
+JSH_ZYGOTE=1 "$ROOT/jsh" <<'END2' | sed -E 's/^\[([0-9]+)\] [0-9]+ /[\1] PID /'
+sleep 0.1
+?
+sh stop.sh
+?
+jobs
+fg %1
+?
+sleep 0.1 &
+jobs
+sleep 0.3
+jobs
+parallel -k -j 3 echo ::: a b c
+?
+END2
@@ -0,0 +1,55 @@
+/*
+ * Generates `head/builtin_hash.h` : a seed for which `builtin_hash()` sends
+ * every built-in of `src/builtins.def` to its own slot, and the table of the
+ * slots. `find_builtin()` then finds a built-in with one hash and at most one
+ * `strcmp()`
+ */
+#include "../head/jsh.h"
+
+#define BUILTIN(name, func, flags) name,
+static const char *const names[] = {
+#include "../src/builtins.def"
+};
+#undef BUILTIN
+
+#define NB_NAMES (sizeof(names) / sizeof(names[0]))
+#define MAX_BITS 10
+#define MAX_SEEDS 10000000
+
+int main(void) {
+  static signed char slots[1 << MAX_BITS];
+  int bits = 1;
+  while ((1U << bits) < NB_NAMES * 2)
+    bits++;
+
+  // the table is kept at most 4 times bigger than the list : with more than
+  // twice as many slots as names, a seed is found in a few thousand tries
+  for (; bits <= MAX_BITS; bits++) {
+    for (uint64_t seed = 1; seed <= MAX_SEEDS; seed++) {
+      memset(slots, -1, sizeof(slots));
+      size_t i = 0;
+      for (; i < NB_NAMES; i++) {
+        size_t slot = builtin_hash(names[i], seed, bits);
+        if (slots[slot] != -1)
+          break;
+        slots[slot] = (signed char)i;
+      }
+      if (i < NB_NAMES)
+        continue;
+
+      printf("// Generated by tools/gen_builtin_hash from src/builtins.def : "
+             "do not edit\n\n");
+      printf("#define BUILTIN_HASH_SEED %lluULL\n", (unsigned long long)seed);
+      printf("#define BUILTIN_HASH_BITS %d\n\n", bits);
+      printf("// index in the table of the built-in of each slot, `-1` if "
+             "none\n");
+      printf("static const signed char builtin_slots[] = {");
+      for (size_t k = 0; k < (1U << bits); k++)
+        printf("%s%d,", k % 16 == 0 ? "\n   " : " ", slots[k]);
+      printf("\n};\n");
+      return EXIT_SUCCESS;
+    }
+  }
+  fprintf(stderr, "gen_builtin_hash: no perfect hash found\n");
+  return EXIT_FAILURE;
+}
@@ -0,0 +1,89 @@
+/*
+ * jshboard : reader of the job board of `JSH_BOARD=file`
+ *
+ *   jshboard [-w seconds] file
+ *
+ * Prints the jobs published by the shell in `file`, then the jobs ended
+ * recently. With `-w`, prints them again every `seconds`, the file being
+ * mapped once : each snapshot is read from memory, without system call.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "../head/jsh_board.h"
+
+static const char *states[] = {"Running", "Stopped", "Done", "Killed",
+                               "Detached"};
+
+/**
+ * Prints a snapshot of the board
+ */
+static void print_board(const jsh_board *board) {
+  printf("jsh %d, update %llu\n", board->pid,
+         (unsigned long long)board->seq / 2);
+  for (uint32_t i = 0; i < board->nb_jobs; i++) {
+    const jsh_board_job *job = &board->jobs[i];
+    if (i == board->nb_live)
+      printf("ended :\n");
+    printf("[%d] %d %-8s %7.2fs user %7.2fs sys %8lld kB  %s\n", job->id,
+           job->pgid,
+           job->state >= 0 && job->state < 5 ? states[job->state] : "?",
+           (double)job->utime_us / 1e6, (double)job->stime_us / 1e6,
+           (long long)job->maxrss_kb, job->command);
+  }
+}
+
+int main(int argc, char **argv) {
+  unsigned interval = 0;
+  int opt;
+  while ((opt = getopt(argc, argv, "w:")) != -1) {
+    if (opt != 'w' || (interval = (unsigned)atoi(optarg)) == 0) {
+      fprintf(stderr, "usage: jshboard [-w seconds] file\n");
+      return 2;
+    }
+  }
+  if (optind != argc - 1) {
+    fprintf(stderr, "usage: jshboard [-w seconds] file\n");
+    return 2;
+  }
+
+  int fd = open(argv[optind], O_RDONLY | O_CLOEXEC);
+  if (fd == -1) {
+    fprintf(stderr, "jshboard: %s: %s\n", argv[optind], strerror(errno));
+    return 1;
+  }
+  // shorter, the mapping could not be read
+  struct stat st;
+  if (fstat(fd, &st) == 0 && (size_t)st.st_size < sizeof(jsh_board)) {
+    fprintf(stderr, "jshboard: %s: not a job board\n", argv[optind]);
+    return 1;
+  }
+  const jsh_board *board =
+      mmap(NULL, sizeof(jsh_board), PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (board == MAP_FAILED) {
+    fprintf(stderr, "jshboard: %s: %s\n", argv[optind], strerror(errno));
+    return 1;
+  }
+
+  for (;;) {
+    jsh_board snapshot;
+    if (jsh_board_read(board, &snapshot)) {
+      fprintf(stderr, "jshboard: %s: not a job board of version %d\n",
+              argv[optind], JSH_BOARD_VERSION);
+      return 1;
+    }
+    print_board(&snapshot);
+    if (interval == 0)
+      return 0;
+    fflush(stdout);
+    sleep(interval);
+  }
+}
@@ -0,0 +1,194 @@
+/*
+ * jshc : client of `jsh --serve socket`
+ *
+ *   jshc [-s socket] [-v] [-e NAME=value] [-u NAME] [-c line | cmd args...]
+ *
+ * Runs `cmd args...`, or the command line `line`, in the server listening on
+ * `socket` (`$JSH_SOCKET` by default), with the current directory and the
+ * standard descriptors of the client. `-e` and `-u` export and unset
+ * variables for the request, `-v` prints its resource usage. The exit code
+ * is the one of the command.
+ */
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "../head/jsh_proto.h"
+
+/**
+ * Appends the string `s` and its `\0` to the payload
+ *
+ * @return `0` on success, `-1` if the payload is too long
+ */
+static int append(char *payload, size_t *length, const char *s) {
+  size_t size = strlen(s) + 1;
+  if (*length + size > JSH_PROTO_MAX_PAYLOAD)
+    return -1;
+  memcpy(payload + *length, s, size);
+  *length += size;
+  return 0;
+}
+
+/**
+ * Sends the request : its header with the standard descriptors, then the
+ * payload
+ *
+ * @return `0` on success, `-1` on error
+ */
+static int send_request(int sock, jsh_request *request, const char *payload) {
+  int fds[3] = {STDIN_FILENO, STDOUT_FILENO, STDERR_FILENO};
+  char control[CMSG_SPACE(sizeof(fds))];
+  memset(control, 0, sizeof(control));
+  struct iovec iov = {request, sizeof(*request)};
+  struct msghdr msg = {0};
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+  msg.msg_control = control;
+  msg.msg_controllen = sizeof(control);
+  struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+  cmsg->cmsg_level = SOL_SOCKET;
+  cmsg->cmsg_type = SCM_RIGHTS;
+  cmsg->cmsg_len = CMSG_LEN(sizeof(fds));
+  memcpy(CMSG_DATA(cmsg), fds, sizeof(fds));
+
+  ssize_t n;
+  while ((n = sendmsg(sock, &msg, MSG_NOSIGNAL)) == -1 && errno == EINTR)
+    ;
+  if (n != (ssize_t)sizeof(*request))
+    return -1;
+  for (size_t sent = 0; sent < request->length; sent += (size_t)n) {
+    n = send(sock, payload + sent, request->length - sent, MSG_NOSIGNAL);
+    if (n == -1 && errno == EINTR)
+      n = 0;
+    else if (n <= 0)
+      return -1;
+  }
+  return 0;
+}
+
+/**
+ * Reads a reply of the server
+ *
+ * @return `0` on success, `-1` if the connection ended before
+ */
+static int read_reply(int sock, jsh_reply *reply) {
+  size_t size = 0;
+  while (size < sizeof(*reply)) {
+    ssize_t n = read(sock, (char *)reply + size, sizeof(*reply) - size);
+    if (n == -1 && errno == EINTR)
+      continue;
+    if (n <= 0)
+      return -1;
+    size += (size_t)n;
+  }
+  return reply->magic == JSH_PROTO_MAGIC ? 0 : -1;
+}
+
+static void usage(void) {
+  fprintf(stderr, "usage: jshc [-s socket] [-v] [-e NAME=value] [-u NAME] "
+                  "[-c line | cmd args...]\n");
+  exit(2);
+}
+
+int main(int argc, char **argv) {
+  const char *path = getenv("JSH_SOCKET");
+  const char *line = NULL;
+  int verbose = 0;
+  char **env = calloc((size_t)argc, sizeof(char *));
+  char *payload = malloc(JSH_PROTO_MAX_PAYLOAD);
+  if (env == NULL || payload == NULL) {
+    perror("jshc: malloc error");
+    return 125;
+  }
+  uint32_t nb_env = 0;
+  int opt;
+  while ((opt = getopt(argc, argv, "+s:c:e:u:v")) != -1) {
+    switch (opt) {
+    case 's':
+      path = optarg;
+      break;
+    case 'c':
+      line = optarg;
+      break;
+    case 'e':
+      if (strchr(optarg, '=') == NULL)
+        usage();
+      env[nb_env++] = optarg;
+      break;
+    case 'u':
+      if (strchr(optarg, '=') != NULL)
+        usage();
+      env[nb_env++] = optarg;
+      break;
+    case 'v':
+      verbose = 1;
+      break;
+    default:
+      usage();
+    }
+  }
+  if (path == NULL || (line == NULL) == (optind == argc))
+    usage();
+
+  jsh_request request = {JSH_PROTO_MAGIC, JSH_PROTO_VERSION, 0, 3, 0, nb_env,
+                         0};
+  size_t length = 0;
+  char cwd[4096];
+  if (getcwd(cwd, sizeof(cwd)) == NULL)
+    cwd[0] = '\0';
+  int error = append(payload, &length, cwd);
+  if (line != NULL) {
+    request.flags = JSH_REQUEST_LINE;
+    request.nb_words = 1;
+    error |= append(payload, &length, line);
+  } else {
+    request.nb_words = (uint32_t)(argc - optind);
+    for (int i = optind; i < argc; i++)
+      error |= append(payload, &length, argv[i]);
+  }
+  for (uint32_t i = 0; i < nb_env; i++)
+    error |= append(payload, &length, env[i]);
+  if (error) {
+    fprintf(stderr, "jshc: request too long\n");
+    return 125;
+  }
+  request.length = (uint32_t)length;
+
+  struct sockaddr_un address = {0};
+  address.sun_family = AF_UNIX;
+  if (strlen(path) >= sizeof(address.sun_path)) {
+    fprintf(stderr, "jshc: %s: path too long\n", path);
+    return 125;
+  }
+  strcpy(address.sun_path, path);
+  int sock = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (sock == -1 ||
+      connect(sock, (struct sockaddr *)&address, sizeof(address)) == -1) {
+    fprintf(stderr, "jshc: %s: %s\n", path, strerror(errno));
+    return 125;
+  }
+  if (send_request(sock, &request, payload)) {
+    fprintf(stderr, "jshc: %s: cannot send the request\n", path);
+    return 125;
+  }
+
+  jsh_reply reply;
+  if (read_reply(sock, &reply) || reply.type != JSH_REPLY_STARTED ||
+      read_reply(sock, &reply) || reply.type != JSH_REPLY_DONE) {
+    fprintf(stderr, "jshc: %s: connection lost\n", path);
+    return 125;
+  }
+  if (verbose)
+    fprintf(stderr,
+            "jshc: pid %d status %d real %.3fs user %.3fs sys %.3fs "
+            "maxrss %lldkB\n",
+            reply.pid, reply.status, (double)reply.real_us / 1e6,
+            (double)reply.utime_us / 1e6, (double)reply.stime_us / 1e6,
+            (long long)reply.maxrss_kb);
+  return reply.status;
+}